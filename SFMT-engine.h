@@ -0,0 +1,201 @@
+#pragma once
+/**
+ * @file SFMT-engine.h
+ *
+ * @brief C++ random number engine adapter of SFMT, which meets the
+ * UniformRandomBitGenerator and RandomNumberEngine requirements, so the
+ * \<random\> distributions can run on SFMT by changing a typedef:
+ * @verbatim
+ typedef sfmt19937_64 rng_t;      // was std::mt19937_64
+ rng_t rng(seed);
+ std::uniform_int_distribution<uint64_t> dist;
+ uint64_t v = dist(rng);
+@endverbatim
+ * The internal state array is the block buffer: it's regenerated in bulk
+ * by sfmt_gen_rand_all() when used up, and each operator() is an index
+ * check and a load, inlined in the distribution loop.
+ *
+ * @note little endian only, same as the SSE2 version of SFMT.
+ */
+
+#ifndef SFMT_ENGINE_H
+#define SFMT_ENGINE_H
+
+#if !defined(__cplusplus)
+  #error "SFMT-engine.h is for C++ only"
+#endif
+
+#include <string.h>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include "SFMT.h"
+
+/**
+ * SFMT random number engine, UIntType is uint32_t or uint64_t
+ */
+template <class UIntType>
+class sfmt_engine {
+    static_assert(std::is_same<UIntType, uint32_t>::value
+                  || std::is_same<UIntType, uint64_t>::value,
+                  "sfmt_engine supports uint32_t and uint64_t only");
+
+    /** numbers per block */
+    static const int block_size = (int)(SFMT_N32 * sizeof(uint32_t) / sizeof(UIntType));
+
+public:
+    typedef UIntType result_type;
+    static const result_type default_seed = 5489u;
+
+    explicit sfmt_engine(result_type value = default_seed) {
+        seed(value);
+    }
+
+    template <class Sseq, class = typename std::enable_if<
+                  !std::is_convertible<Sseq, result_type>::value>::type>
+    explicit sfmt_engine(Sseq & q) {
+        seed(q);
+    }
+
+    /**
+     * seeds by sfmt_init_gen_rand(), or by sfmt_init_by_array() when the
+     * value doesn't fit in 32 bits.
+     */
+    void seed(result_type value = default_seed) {
+        uint64_t v = value;
+        if ((v >> 32) == 0) {
+            sfmt_init_gen_rand(&sfmt, (uint32_t)v);
+        } else {
+            uint32_t key[2] = {(uint32_t)v, (uint32_t)(v >> 32)};
+            sfmt_init_by_array(&sfmt, key, 2);
+        }
+    }
+
+    /**
+     * seeds by sfmt_init_by_array() with SFMT_N32 words of the seed sequence.
+     */
+    template <class Sseq>
+    typename std::enable_if<!std::is_convertible<Sseq, result_type>::value>::type
+    seed(Sseq & q) {
+        uint32_t key[SFMT_N32];
+        q.generate(key, key + SFMT_N32);
+        sfmt_init_by_array(&sfmt, key, SFMT_N32);
+    }
+
+    static constexpr result_type min() {
+        return 0;
+    }
+
+    static constexpr result_type max() {
+        return ~(result_type)0;
+    }
+
+    result_type operator()() {
+        const result_type * block = (const result_type *)&sfmt.state[0].u[0];
+        const int step = (int)(sizeof(result_type) / sizeof(uint32_t));
+
+        if (sfmt.idx >= SFMT_N32) {
+            sfmt_gen_rand_all(&sfmt);
+            sfmt.idx = 0;
+        }
+        result_type r = block[sfmt.idx / step];
+        sfmt.idx += step;
+        return r;
+    }
+
+    /**
+     * advances the engine by z numbers, whole blocks are skipped by
+     * sfmt_gen_rand_all() without reading them.
+     */
+    void discard(unsigned long long z) {
+        const int step = (int)(sizeof(result_type) / sizeof(uint32_t));
+        unsigned long long left = (unsigned long long)(SFMT_N32 - sfmt.idx) / step;
+
+        if (z <= left) {
+            sfmt.idx += (int)z * step;
+            return;
+        }
+        z -= left;
+        for (; z > (unsigned long long)block_size; z -= block_size) {
+            sfmt_gen_rand_all(&sfmt);
+        }
+        sfmt_gen_rand_all(&sfmt);
+        sfmt.idx = (int)z * step;
+    }
+
+    /** the underlying SFMT state, for the C API */
+    sfmt_t * state() {
+        return &sfmt;
+    }
+
+    friend bool operator==(const sfmt_engine & a, const sfmt_engine & b) {
+        return (a.sfmt.idx == b.sfmt.idx)
+            && (memcmp(a.sfmt.state, b.sfmt.state, sizeof(a.sfmt.state)) == 0);
+    }
+
+    friend bool operator!=(const sfmt_engine & a, const sfmt_engine & b) {
+        return !(a == b);
+    }
+
+    /** writes idx and the SFMT_N32 state words, space separated */
+    template <class CharT, class Traits>
+    friend std::basic_ostream<CharT, Traits> &
+    operator<<(std::basic_ostream<CharT, Traits> & os, const sfmt_engine & e) {
+        typename std::basic_ostream<CharT, Traits>::fmtflags flags = os.flags();
+        CharT fill = os.fill();
+        os.flags(std::ios_base::dec | std::ios_base::left);
+        os.fill(os.widen(' '));
+
+        os << e.sfmt.idx;
+        for (int i = 0; i < SFMT_N32; i++) {
+            os << os.widen(' ') << e.sfmt.state[i / 4].u[i % 4];
+        }
+
+        os.flags(flags);
+        os.fill(fill);
+        return os;
+    }
+
+    /**
+     * reads what operator<< writes, a stream which fails or an idx out of
+     * [0, SFMT_N32] (or odd for 64-bit) sets failbit and leaves e unchanged
+     */
+    template <class CharT, class Traits>
+    friend std::basic_istream<CharT, Traits> &
+    operator>>(std::basic_istream<CharT, Traits> & is, sfmt_engine & e) {
+        typename std::basic_istream<CharT, Traits>::fmtflags flags = is.flags();
+        sfmt_t tmp;
+        is.flags(std::ios_base::dec | std::ios_base::skipws);
+
+        is >> tmp.idx;
+        for (int i = 0; i < SFMT_N32; i++) {
+            is >> tmp.state[i / 4].u[i % 4];
+        }
+        // an idx out of the block, or between two words of a 64-bit number,
+        // is not a state this engine can be in
+        const int step = (int)(sizeof(result_type) / sizeof(uint32_t));
+        if (!is.fail() && ((tmp.idx < 0) || (tmp.idx > SFMT_N32) || (tmp.idx % step != 0))) {
+            is.setstate(std::ios_base::failbit);
+        }
+        if (!is.fail()) {
+            e.sfmt = tmp;
+        }
+
+        is.flags(flags);
+        return is;
+    }
+
+private:
+    sfmt_t sfmt;
+};
+
+template <class UIntType>
+const typename sfmt_engine<UIntType>::result_type sfmt_engine<UIntType>::default_seed;
+
+/** 32-bit SFMT engine */
+typedef sfmt_engine<uint32_t> sfmt19937;
+
+/** 64-bit SFMT engine, drop-in for std::mt19937_64 */
+typedef sfmt_engine<uint64_t> sfmt19937_64;
+
+#endif // SFMT_ENGINE_H
@@ -0,0 +1,399 @@
+/**
+ * @file  SFMT-jump.cpp
+ * @brief Jump ahead of SFMT by a run time minimal polynomial, and the
+ *        parallel block fill built on it.
+ *
+ * The state of N 128-bit words is handled as a ring, as the upstream
+ * SFMT-jump.c does: next_state() computes one 128-bit output in place
+ * and moves the ring position, add() adds two states aligned on their
+ * ring positions, and the jump polynomial is evaluated by Horner's
+ * method from the lowest coefficient. After the jump the state is
+ * stored from its ring position 0, so it's a normal SFMT state again.
+ *
+ * Polynomials over GF(2) are bit arrays, bit i of word i / 64 is the
+ * coefficient of x^i.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "os_wrapper.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "SFMT-common.h"
+#include "SFMT-jump.h"
+#include "randmix.h"
+
+/** dimension of the state, the upper bound of the minimal polynomial degree */
+#define JUMP_DIM        (SFMT_N * 128)
+/** output bits for Berlekamp-Massey */
+#define JUMP_SEQ        (2 * JUMP_DIM)
+/** words of a polynomial of degree < JUMP_DIM, and of its square */
+#define POLY_WORDS      (JUMP_DIM / 64 + 1)
+#define POLY2_WORDS     (2 * POLY_WORDS)
+/** 64-bit integers per sfmt_fill_array64() call, it takes an int size */
+#define JUMP_CHUNK64    (1 << 30)
+
+/**
+ * the minimal polynomial P, and P << s for s in [0, 64) for the reduction
+ */
+static uint64_t minpoly[POLY_WORDS];
+static uint64_t minpoly_shift[64][POLY_WORDS + 1];
+static int minpoly_deg = -1;
+static pthread_once_t minpoly_once = PTHREAD_ONCE_INIT;
+
+/**
+ * one parallel fill, shared by the workers
+ */
+typedef struct {
+    const sfmt_t * sfmt;        /**< state before the fill, read only */
+    uint64_t * array;
+    size_t total;               /**< 128-bit words to fill */
+    size_t segment;             /**< 128-bit words per worker */
+    int workers;
+    int failed;
+    sfmt_t last;                /**< state after the last segment */
+} jump_fill_job_t;
+
+/*----------------
+  STATIC FUNCTIONS
+  ----------------*/
+inline static int poly_bit(const uint64_t * p, size_t i) {
+    return (int)((p[i / 64] >> (i % 64)) & 1);
+}
+
+/**
+ * 64 bits of the bit array \b a from bit \b pos, zeros beyond its end.
+ */
+inline static uint64_t poly_word_at(const uint64_t * a, size_t nwords,
+                                    size_t pos)
+{
+    size_t w = pos / 64;
+    int s = (int)(pos % 64);
+    uint64_t lo = (w < nwords) ? a[w] : 0;
+    uint64_t hi = (w + 1 < nwords) ? a[w + 1] : 0;
+
+    return (s == 0) ? lo : ((lo >> s) | (hi << (64 - s)));
+}
+
+/**
+ * dst ^= src << shift, dst has \b dwords words.
+ */
+static void poly_xor_shifted(uint64_t * dst, size_t dwords,
+                             const uint64_t * src, size_t swords, size_t shift)
+{
+    size_t w = shift / 64;
+    int s = (int)(shift % 64);
+    size_t i;
+
+    for (i = 0; i < swords && i + w < dwords; i++) {
+        dst[i + w] ^= src[i] << s;
+        if (s != 0 && i + w + 1 < dwords) {
+            dst[i + w + 1] ^= src[i] >> (64 - s);
+        }
+    }
+}
+
+/**
+ * Berlekamp-Massey on bit 0 of successive 128-bit outputs, the connection
+ * polynomial C gives the minimal polynomial P(x) = x^L C(1/x) of the
+ * sequence.
+ */
+static void calc_minpoly(void)
+{
+    const size_t sw = JUMP_SEQ / 64 + 1;
+    uint64_t * rev = (uint64_t *)calloc(sw, sizeof(uint64_t));
+    uint64_t * c = (uint64_t *)calloc(sw, sizeof(uint64_t));
+    uint64_t * b = (uint64_t *)calloc(sw, sizeof(uint64_t));
+    uint64_t * t = (uint64_t *)calloc(sw, sizeof(uint64_t));
+    sfmt_t ref;
+    size_t i, w, len = 0, m = 1;
+
+    if (rev == NULL || c == NULL || b == NULL || t == NULL) {
+        free(rev); free(c); free(b); free(t);
+        return;
+    }
+
+    /*
+     * a generic state, not period certified, so the sequence has components
+     * in all the invariant subspaces and P annihilates any state, not only
+     * the ones on the orbit of the reference.
+     */
+    uint64_t x = 4357;
+    for (i = 0; i < SFMT_N * 2; i++) {
+        ref.state[i / 2].u64[i % 2] = randmix_splitmix64(&x);
+    }
+    ref.idx = SFMT_N32;
+
+    /* the sequence reversed, so the discrepancy is a word-wise dot product */
+    for (i = 0; i < JUMP_SEQ; i++) {
+        if (i % SFMT_N == 0) {
+            sfmt_gen_rand_all(&ref);
+        }
+        size_t p = JUMP_SEQ - 1 - i;
+        rev[p / 64] |= (uint64_t)(ref.state[i % SFMT_N].u[0] & 1) << (p % 64);
+    }
+
+    c[0] = b[0] = 1;
+    for (i = 0; i < JUMP_SEQ; i++) {
+        size_t p = JUMP_SEQ - 1 - i;
+        uint64_t acc = 0;
+
+        for (w = 0; w <= len / 64; w++) {
+            acc ^= c[w] & poly_word_at(rev, sw, p + 64 * w);
+        }
+        if ((__builtin_popcountll(acc) & 1) == 0) {
+            m++;
+            continue;
+        }
+        if (2 * len <= i) {
+            memcpy(t, c, sw * sizeof(uint64_t));
+            poly_xor_shifted(c, sw, b, sw - m / 64, m);
+            len = i + 1 - len;
+            memcpy(b, t, sw * sizeof(uint64_t));
+            m = 1;
+        } else {
+            poly_xor_shifted(c, sw, b, sw - m / 64, m);
+            m++;
+        }
+    }
+
+    /*
+     * degree JUMP_DIM means it's the characteristic polynomial of the
+     * recursion (Cayley-Hamilton), anything else is not safe to use.
+     */
+    if (len == JUMP_DIM) {
+        memset(minpoly, 0, sizeof(minpoly));
+        for (i = 0; i <= len; i++) {
+            if (poly_bit(c, len - i)) {
+                minpoly[i / 64] |= (uint64_t)1 << (i % 64);
+            }
+        }
+        for (int s = 0; s < 64; s++) {
+            memset(minpoly_shift[s], 0, sizeof(minpoly_shift[s]));
+            poly_xor_shifted(minpoly_shift[s], POLY_WORDS + 1,
+                             minpoly, POLY_WORDS, s);
+        }
+        minpoly_deg = (int)len;
+    }
+
+    free(rev); free(c); free(b); free(t);
+}
+
+/**
+ * a = a mod P, a has POLY2_WORDS words.
+ */
+static void poly_mod(uint64_t * a)
+{
+    const int deg = minpoly_deg;
+
+    for (int i = POLY2_WORDS * 64 - 1; i >= deg; i--) {
+        if (poly_bit(a, i)) {
+            size_t shift = (size_t)(i - deg);
+            const uint64_t * ps = minpoly_shift[shift % 64];
+            size_t w = shift / 64;
+            for (size_t k = 0; k < POLY_WORDS + 1 && k + w < POLY2_WORDS; k++) {
+                a[k + w] ^= ps[k];
+            }
+        }
+    }
+}
+
+/**
+ * spreads 32 bits to the even bits of 64 bits, the square over GF(2).
+ */
+inline static uint64_t spread32(uint64_t x)
+{
+    x &= 0xffffffffULL;
+    x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+    x = (x | (x << 8))  & 0x00ff00ff00ff00ffULL;
+    x = (x | (x << 4))  & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x << 2))  & 0x3333333333333333ULL;
+    x = (x | (x << 1))  & 0x5555555555555555ULL;
+    return x;
+}
+
+/**
+ * jp = x^k mod P, left to right square and multiply by x, k > 0.
+ */
+static void calc_jump_poly(uint64_t * jp, uint64_t k)
+{
+    uint64_t sq[POLY2_WORDS];
+    int i;
+
+    memset(jp, 0, POLY2_WORDS * sizeof(uint64_t));
+    jp[0] = 1;
+    for (i = 63 - __builtin_clzll(k); i >= 0; i--) {
+        memset(sq, 0, sizeof(sq));
+        for (int w = 0; w < POLY_WORDS; w++) {
+            sq[2 * w] = spread32(jp[w]);
+            sq[2 * w + 1] = spread32(jp[w] >> 32);
+        }
+        if ((k >> i) & 1) {
+            /* multiply by x */
+            for (int w = POLY2_WORDS - 1; w > 0; w--) {
+                sq[w] = (sq[w] << 1) | (sq[w - 1] >> 63);
+            }
+            sq[0] <<= 1;
+        }
+        poly_mod(sq);
+        memcpy(jp, sq, sizeof(sq));
+    }
+}
+
+/**
+ * one step of the recursion on the ring, as in the upstream SFMT-jump.c.
+ */
+inline static void next_state(sfmt_t * sfmt)
+{
+    int idx = (sfmt->idx / 4) % SFMT_N;
+    w128_t * pstate = sfmt->state;
+
+    do_recursion(&pstate[idx],
+                 &pstate[idx],
+                 &pstate[(idx + SFMT_POS1) % SFMT_N],
+                 &pstate[(idx + SFMT_N - 2) % SFMT_N],
+                 &pstate[(idx + SFMT_N - 1) % SFMT_N]);
+    sfmt->idx += 4;
+}
+
+/**
+ * dest += src, aligned on the ring positions.
+ */
+inline static void add(sfmt_t * dest, const sfmt_t * src)
+{
+    int dp = dest->idx / 4;
+    int sp = src->idx / 4;
+    int diff = (sp - dp + SFMT_N) % SFMT_N;
+    int i, p;
+
+    for (i = 0; i < SFMT_N; i++) {
+        p = (i + diff) % SFMT_N;
+#if defined(HAVE_SSE2)
+        dest->state[i].si = _mm_xor_si128(dest->state[i].si, src->state[p].si);
+#else
+        dest->state[i].u64[0] ^= src->state[p].u64[0];
+        dest->state[i].u64[1] ^= src->state[p].u64[1];
+#endif
+    }
+}
+
+static void jump_by_poly(sfmt_t * sfmt, const uint64_t * jp)
+{
+    sfmt_t work;
+    int index = sfmt->idx;
+    int i;
+
+    memset(&work, 0, sizeof(sfmt_t));
+    sfmt->idx = SFMT_N32;               /* ring position 0 */
+    for (i = 0; i < minpoly_deg; i++) {
+        if (poly_bit(jp, i)) {
+            add(&work, sfmt);
+        }
+        next_state(sfmt);
+    }
+    *sfmt = work;
+    sfmt->idx = index;
+}
+
+/**
+ * sfmt_fill_array64() of any size, in calls of at most JUMP_CHUNK64.
+ */
+static void fill_chunks(sfmt_t * sfmt, uint64_t * array, size_t size)
+{
+    while (size > 0) {
+        size_t n = size;
+        if (n > 2 * (size_t)JUMP_CHUNK64) {
+            n = JUMP_CHUNK64;
+        } else if (n > (size_t)JUMP_CHUNK64) {
+            n = (n / 2) & ~(size_t)1;   /* both halves >= SFMT_N64 */
+        }
+        sfmt_fill_array64(sfmt, array, (int)n);
+        array += n;
+        size -= n;
+    }
+}
+
+static void jump_fill_entry(int worker, void * arg)
+{
+    jump_fill_job_t * job = (jump_fill_job_t *)arg;
+    size_t begin = job->segment * (size_t)worker;
+    size_t end = (worker == job->workers - 1) ? job->total
+                                              : begin + job->segment;
+    sfmt_t local = *job->sfmt;
+
+    if (begin > 0 && sfmt_jump(&local, begin) != 0) {
+        __sync_fetch_and_add(&job->failed, 1);
+        return;
+    }
+    fill_chunks(&local, job->array + 2 * begin, 2 * (end - begin));
+    if (worker == job->workers - 1) {
+        job->last = local;
+    }
+}
+
+/*----------------
+  PUBLIC FUNCTIONS
+  ----------------*/
+int sfmt_jump(sfmt_t * sfmt, uint64_t steps)
+{
+    uint64_t * jp;
+
+    pthread_once(&minpoly_once, calc_minpoly);
+    if (minpoly_deg < 0) {
+        return -1;
+    }
+    if (steps == 0) {
+        return 0;
+    }
+    jp = (uint64_t *)malloc(POLY2_WORDS * sizeof(uint64_t));
+    if (jp == NULL) {
+        return -1;
+    }
+    calc_jump_poly(jp, steps);
+    jump_by_poly(sfmt, jp);
+    free(jp);
+    return 0;
+}
+
+int sfmt_fill_array64_parallel(sfmt_t * sfmt, uint64_t * array, size_t size,
+                               int workers)
+{
+    jump_fill_job_t job;
+    size_t total = size / 2;
+    size_t most = total / (SFMT_PARALLEL_MIN64 / 2);
+
+    assert(sfmt->idx == SFMT_N32);
+    assert(size % 2 == 0);
+    assert(size >= SFMT_N64);
+
+    if ((size_t)workers > most) {
+        workers = (int)most;
+    }
+    pthread_once(&minpoly_once, calc_minpoly);
+    if (workers <= 1 || minpoly_deg < 0) {
+        fill_chunks(sfmt, array, size);
+        return 0;
+    }
+
+    job.sfmt = sfmt;
+    job.array = array;
+    job.total = total;
+    job.segment = total / workers;
+    job.workers = workers;
+    job.failed = 0;
+    thread_parallel(workers, jump_fill_entry, &job);
+    if (job.failed != 0) {
+        return -1;
+    }
+    *sfmt = job.last;
+    return 0;
+}
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+/**
+ * @file SFMT-jump.h
+ *
+ * @brief Jump ahead of SFMT, and the parallel block fill built on it.
+ *
+ * The jump of k steps (one step is one 128-bit output) is the polynomial
+ * x^k mod P(x) evaluated at the state transition. Instead of the
+ * precomputed jump strings of the upstream calc-jump tool (it needs NTL),
+ * P is found at run time, once per process, by Berlekamp-Massey on 2 *
+ * 19968 output bits of a generic (not period certified) state. Its degree
+ * is checked to be 19968, the whole state, so P is the characteristic
+ * polynomial and works for any state. x^k mod P is computed by square and
+ * multiply, so any k can be used.
+ *
+ * @note the first call takes about 50ms for P. A jump is 19968 steps of
+ * the recursion plus the polynomial power, some milliseconds, so it's for
+ * jumping far, not near.
+ */
+
+#ifndef SFMT_JUMP_H
+#define SFMT_JUMP_H
+
+#include <stddef.h>
+#include "SFMT.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * smallest number of 64-bit integers per worker of the parallel fill,
+ * below it a worker costs more to jump than to generate.
+ */
+#define SFMT_PARALLEL_MIN64     (1 << 22)
+
+/**
+ * This function jumps the state ahead by \b steps 128-bit outputs, the
+ * next numbers are the ones after 2 * steps 64-bit numbers (4 * steps
+ * 32-bit numbers) of the original sequence. sfmt->idx is kept.
+ * @param sfmt SFMT internal state
+ * @param steps number of 128-bit outputs to skip
+ * @return 0 if successful, -1 if the minimal polynomial is not available
+ */
+int sfmt_jump(sfmt_t * sfmt, uint64_t steps);
+
+/**
+ * This function fills the array by \b workers threads with exactly the
+ * same numbers as sfmt_fill_array64(sfmt, array, size), and leaves the
+ * same state in \b sfmt. Worker i jumps a copy of the state to the
+ * beginning of its segment, so the output doesn't depend on the number
+ * of workers. The conditions on array and size are the same as
+ * sfmt_fill_array64(), but size can be bigger than an int.
+ * @param sfmt SFMT internal state
+ * @param array an array where pseudorandom 64-bit integers are filled
+ * @param size the number of 64-bit pseudorandom integers to be generated
+ * @param workers number of worker threads
+ * @return 0 if successful, others if failed
+ */
+int sfmt_fill_array64_parallel(sfmt_t * sfmt, uint64_t * array, size_t size,
+                               int workers);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // SFMT_JUMP_H
@@ -0,0 +1,112 @@
+#pragma once
+/**
+ * @file SFMT-range.h
+ *
+ * @brief C++ ranges over the SFMT internal state array, to consume the
+ * block output in a plain loop which the compiler can unroll and vectorize:
+ * @verbatim
+ for (uint64_t v : sfmt_block64(&sfmt)) {
+     ...
+ }
+@endverbatim
+ * One call advances the state in bulk by sfmt_gen_rand_all() and returns
+ * the numbers not consumed yet, so the output sequence is exactly the same
+ * as calling sfmt_genrand_uint64() (or sfmt_genrand_uint32()) one by one,
+ * and both styles can be mixed.
+ *
+ * @note little endian only, same as the SSE2 version of SFMT.
+ */
+
+#ifndef SFMT_RANGE_H
+#define SFMT_RANGE_H
+
+#if !defined(__cplusplus)
+  #error "SFMT-range.h is for C++ only"
+#endif
+
+#include "SFMT.h"
+
+/**
+ * range of 64-bit pseudorandom numbers in the SFMT internal state
+ */
+struct sfmt_range64_t {
+    const uint64_t * first;
+    const uint64_t * last;
+
+    const uint64_t * begin() const { return first; }
+    const uint64_t * end() const { return last; }
+    int size() const { return (int)(last - first); }
+};
+
+/**
+ * range of 32-bit pseudorandom numbers in the SFMT internal state
+ */
+struct sfmt_range32_t {
+    const uint32_t * first;
+    const uint32_t * last;
+
+    const uint32_t * begin() const { return first; }
+    const uint32_t * end() const { return last; }
+    int size() const { return (int)(last - first); }
+};
+
+/**
+ * This function returns the next 64-bit pseudorandom numbers, at most
+ * \b max of them, and at most the rest of the internal state array.
+ * The internal state array is regenerated in bulk when it's used up.
+ * init_gen_rand or init_by_array must be called before this function.
+ * @param sfmt SFMT internal state
+ * @param max maximum numbers in the range
+ * @return range of 64-bit pseudorandom numbers, valid until the next
+ * call on \b sfmt
+ */
+inline static sfmt_range64_t sfmt_block64(sfmt_t * sfmt, int max = SFMT_N64)
+{
+    int n;
+    const uint64_t * first;
+
+    assert(sfmt->idx % 2 == 0);
+    if (sfmt->idx >= SFMT_N32) {
+        sfmt_gen_rand_all(sfmt);
+        sfmt->idx = 0;
+    }
+    first = &sfmt->state[0].u64[0] + sfmt->idx / 2;
+    n = (SFMT_N32 - sfmt->idx) / 2;
+    if (n > max) {
+        n = max;
+    }
+    sfmt->idx += n * 2;
+
+    sfmt_range64_t range = { first, first + n };
+    return range;
+}
+
+/**
+ * This function returns the next 32-bit pseudorandom numbers, at most
+ * \b max of them, and at most the rest of the internal state array.
+ * @param sfmt SFMT internal state
+ * @param max maximum numbers in the range
+ * @return range of 32-bit pseudorandom numbers, valid until the next
+ * call on \b sfmt
+ */
+inline static sfmt_range32_t sfmt_block32(sfmt_t * sfmt, int max = SFMT_N32)
+{
+    int n;
+    const uint32_t * first;
+
+    if (sfmt->idx >= SFMT_N32) {
+        sfmt_gen_rand_all(sfmt);
+        sfmt->idx = 0;
+    }
+    first = &sfmt->state[0].u[0] + sfmt->idx;
+    n = SFMT_N32 - sfmt->idx;
+    if (n > max) {
+        n = max;
+    }
+    sfmt->idx += n;
+
+    sfmt_range32_t range = { first, first + n };
+    return range;
+}
+
+#endif // SFMT_RANGE_H
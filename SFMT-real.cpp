@@ -0,0 +1,253 @@
+/**
+ * @file  SFMT-real.cpp
+ * @brief Bulk floating point fill of SFMT output
+ *
+ * The double conversions are exact bit tricks:
+ * - 32-bit v, (v << 20) in the mantissa of 1.0 is 1 + v / 2^32 exactly,
+ *   so subtracting 1.0 gives sfmt_to_real2(v) with no rounding, and
+ *   setting the next mantissa bit too gives sfmt_to_real3(v).
+ *   sfmt_to_real1(v) is v * (1/(2^32-1)), v is recovered exactly from
+ *   real2 by multiplying 2^32, then the same multiply as the scalar one.
+ * - 64-bit v, x = v >> 11 has 53 bits, the low 52 bits in the mantissa
+ *   of 1.0 minus 1.0 is (x mod 2^52) / 2^52 exactly, then adding the top
+ *   bit and halving is x / 2^53 exactly, that's sfmt_to_res53(v).
+ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "SFMT-real.h"
+
+/*----------------
+  STATIC FUNCTIONS
+  ----------------*/
+inline static float to_float_real1(uint32_t v) {
+    return (float)(v >> 8) * (1.0f / 16777215.0f);
+}
+
+inline static float to_float_real2(uint32_t v) {
+    return (float)(v >> 8) * (1.0f / 16777216.0f);
+}
+
+inline static float to_float_real3(uint32_t v) {
+    return ((float)(v >> 9) + 0.5f) * (1.0f / 8388608.0f);
+}
+
+#if defined(HAVE_SSE2)
+/**
+ * converts two 32-bit integers in the low 64 bits of x to doubles.
+ */
+inline static __m128d mm_to_real(__m128i x, __m128i mantissa, sfmt_real_t type)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    __m128i y;
+    __m128d r;
+
+    y = _mm_unpacklo_epi32(x, _mm_setzero_si128());
+    y = _mm_slli_epi64(y, 20);
+    y = _mm_or_si128(y, mantissa);
+    r = _mm_sub_pd(_mm_castsi128_pd(y), one);
+    if (type == SFMT_REAL1) {
+        r = _mm_mul_pd(r, _mm_set1_pd(4294967296.0));
+        r = _mm_mul_pd(r, _mm_set1_pd(1.0/4294967295.0));
+    }
+    return r;
+}
+
+/**
+ * converts 32-bit integers to doubles on [0,1], [0,1) or (0,1).
+ */
+static void convert_real(const uint32_t * src, double * dst, int n,
+                         sfmt_real_t type)
+{
+    const __m128i mantissa = (type == SFMT_REAL3)
+        ? _mm_set1_epi64x(0x3ff0000000080000LL)     /* 1.0 and 0.5 / 2^32 */
+        : _mm_set1_epi64x(0x3ff0000000000000LL);    /* 1.0 */
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_pd(dst + i, mm_to_real(x, mantissa, type));
+        _mm_storeu_pd(dst + i + 2, mm_to_real(_mm_srli_si128(x, 8), mantissa, type));
+    }
+    for (; i < n; i++) {
+        if (type == SFMT_REAL1) {
+            dst[i] = sfmt_to_real1(src[i]);
+        } else if (type == SFMT_REAL2) {
+            dst[i] = sfmt_to_real2(src[i]);
+        } else {
+            dst[i] = sfmt_to_real3(src[i]);
+        }
+    }
+}
+
+/**
+ * converts 64-bit integers to doubles on [0,1) with 53-bit resolution.
+ */
+static void convert_res53(const uint64_t * src, double * dst, int n)
+{
+    const __m128i low52 = _mm_set1_epi64x(0x000fffffffffffffLL);
+    const __m128i expo = _mm_set1_epi64x(0x3ff0000000000000LL);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d half = _mm_set1_pd(0.5);
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i x = _mm_srli_epi64(v, 11);
+        __m128i top = _mm_shuffle_epi32(_mm_srai_epi32(v, 31),
+                                        _MM_SHUFFLE(3, 3, 1, 1));
+        __m128d lo = _mm_sub_pd(_mm_castsi128_pd(
+                         _mm_or_si128(_mm_and_si128(x, low52), expo)), one);
+        __m128d hi = _mm_castsi128_pd(_mm_and_si128(top, expo));
+        _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_add_pd(lo, hi), half));
+    }
+    for (; i < n; i++) {
+        dst[i] = sfmt_to_res53(src[i]);
+    }
+}
+
+/**
+ * converts 32-bit integers to floats.
+ */
+static void convert_float(const uint32_t * src, float * dst, int n,
+                          sfmt_real_t type)
+{
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128 r;
+        if (type == SFMT_REAL1) {
+            r = _mm_cvtepi32_ps(_mm_srli_epi32(x, 8));
+            r = _mm_mul_ps(r, _mm_set1_ps(1.0f / 16777215.0f));
+        } else if (type == SFMT_REAL3) {
+            r = _mm_cvtepi32_ps(_mm_srli_epi32(x, 9));
+            r = _mm_add_ps(r, _mm_set1_ps(0.5f));
+            r = _mm_mul_ps(r, _mm_set1_ps(1.0f / 8388608.0f));
+        } else {
+            r = _mm_cvtepi32_ps(_mm_srli_epi32(x, 8));
+            r = _mm_mul_ps(r, _mm_set1_ps(1.0f / 16777216.0f));
+        }
+        _mm_storeu_ps(dst + i, r);
+    }
+    for (; i < n; i++) {
+        if (type == SFMT_REAL1) {
+            dst[i] = to_float_real1(src[i]);
+        } else if (type == SFMT_REAL3) {
+            dst[i] = to_float_real3(src[i]);
+        } else {
+            dst[i] = to_float_real2(src[i]);
+        }
+    }
+}
+#else
+static void convert_real(const uint32_t * src, double * dst, int n,
+                         sfmt_real_t type)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (type == SFMT_REAL1) {
+            dst[i] = sfmt_to_real1(src[i]);
+        } else if (type == SFMT_REAL2) {
+            dst[i] = sfmt_to_real2(src[i]);
+        } else {
+            dst[i] = sfmt_to_real3(src[i]);
+        }
+    }
+}
+
+static void convert_res53(const uint64_t * src, double * dst, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        dst[i] = sfmt_to_res53(src[i]);
+    }
+}
+
+static void convert_float(const uint32_t * src, float * dst, int n,
+                          sfmt_real_t type)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (type == SFMT_REAL1) {
+            dst[i] = to_float_real1(src[i]);
+        } else if (type == SFMT_REAL3) {
+            dst[i] = to_float_real3(src[i]);
+        } else {
+            dst[i] = to_float_real2(src[i]);
+        }
+    }
+}
+#endif
+
+/**
+ * This function regenerates the internal state array if it's used up,
+ * and returns the number of 32-bit integers left in it, at most size.
+ */
+inline static int next_block32(sfmt_t * sfmt, size_t size)
+{
+    int n;
+
+    if (sfmt->idx >= SFMT_N32) {
+        sfmt_gen_rand_all(sfmt);
+        sfmt->idx = 0;
+    }
+    n = SFMT_N32 - sfmt->idx;
+    if ((size_t)n > size) {
+        n = (int)size;
+    }
+    return n;
+}
+
+/*----------------
+  PUBLIC FUNCTIONS
+  ----------------*/
+void sfmt_fill_array_double(sfmt_t * sfmt, double * array, size_t size,
+                            sfmt_real_t type)
+{
+    const uint32_t * psfmt32 = &sfmt->state[0].u[0];
+    const uint64_t * psfmt64 = &sfmt->state[0].u64[0];
+    size_t i = 0;
+    int n;
+
+    if (type == SFMT_RES53) {
+        assert(sfmt->idx % 2 == 0);
+        while (i < size) {
+            n = next_block32(sfmt, (size - i) * 2) / 2;
+            convert_res53(psfmt64 + sfmt->idx / 2, array + i, n);
+            sfmt->idx += n * 2;
+            i += n;
+        }
+    } else {
+        while (i < size) {
+            n = next_block32(sfmt, size - i);
+            convert_real(psfmt32 + sfmt->idx, array + i, n, type);
+            sfmt->idx += n;
+            i += n;
+        }
+    }
+}
+
+void sfmt_fill_array_float(sfmt_t * sfmt, float * array, size_t size,
+                           sfmt_real_t type)
+{
+    const uint32_t * psfmt32 = &sfmt->state[0].u[0];
+    size_t i = 0;
+    int n;
+
+    while (i < size) {
+        n = next_block32(sfmt, size - i);
+        convert_float(psfmt32 + sfmt->idx, array + i, n, type);
+        sfmt->idx += n;
+        i += n;
+    }
+}
+
+#if defined(__cplusplus)
+}
+#endif
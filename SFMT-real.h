@@ -0,0 +1,75 @@
+#pragma once
+/**
+ * @file SFMT-real.h
+ *
+ * @brief Bulk floating point fill of SFMT output, for the interval
+ * conventions of SFMT.h (real1, real2, real3 and res53).
+ *
+ * The numbers are converted by SIMD directly from the internal state
+ * array, right after it's regenerated by sfmt_gen_rand_all(), so the
+ * integer block is never written out. The conversion puts the random
+ * bits into the mantissa where the precision allows, and gives
+ * bit-identical doubles to the scalar converters, so
+ * sfmt_fill_array_double(sfmt, a, n, SFMT_REAL2) fills the same values
+ * as n calls of sfmt_genrand_real2(sfmt).
+ *
+ * The float versions use the upper 24 bits (23 bits for real3) of each
+ * 32-bit number, which is the full float precision:
+ * - SFMT_REAL1 : (v >> 8) / (2^24 - 1)         on [0,1]
+ * - SFMT_REAL2 : (v >> 8) / 2^24               on [0,1)
+ * - SFMT_REAL3 : ((v >> 9) + 0.5) / 2^23       on (0,1)
+ * - SFMT_RES53 : same as SFMT_REAL2
+ *
+ * @note little endian only, same as the SSE2 version of SFMT.
+ */
+
+#ifndef SFMT_REAL_H
+#define SFMT_REAL_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "SFMT.h"
+
+/**
+ * interval conventions of the floating point numbers
+ */
+typedef enum {
+    SFMT_REAL1,         /**< [0,1] from 32-bit, see sfmt_to_real1() */
+    SFMT_REAL2,         /**< [0,1) from 32-bit, see sfmt_to_real2() */
+    SFMT_REAL3,         /**< (0,1) from 32-bit, see sfmt_to_real3() */
+    SFMT_RES53,         /**< [0,1) from 64-bit, see sfmt_to_res53() */
+} sfmt_real_t;
+
+/**
+ * This function fills the array with pseudorandom doubles.
+ * SFMT_RES53 consumes 64-bit numbers, as sfmt_genrand_res53(), and the
+ * others consume 32-bit numbers, as sfmt_genrand_real1() and so on.
+ * The numbers left in the internal state array are kept for the next
+ * call, so any size is allowed and the array pointer is arbitrary.
+ * @param sfmt SFMT internal state
+ * @param array an array where pseudorandom doubles are filled
+ * @param size the number of doubles to be generated
+ * @param type interval convention
+ */
+void sfmt_fill_array_double(sfmt_t * sfmt, double * array, size_t size,
+                            sfmt_real_t type);
+
+/**
+ * This function fills the array with pseudorandom floats, one 32-bit
+ * number for each float.
+ * @param sfmt SFMT internal state
+ * @param array an array where pseudorandom floats are filled
+ * @param size the number of floats to be generated
+ * @param type interval convention
+ */
+void sfmt_fill_array_float(sfmt_t * sfmt, float * array, size_t size,
+                           sfmt_real_t type);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // SFMT_REAL_H
@@ -0,0 +1,269 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <string.h>
+
+#if defined(HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AESCTR_AESNI    1
+#endif
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "randmix.h"
+#include "aesctr.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def AESCTR_AESNI_WAYS
+ *    Blocks per loop of the AES-NI path. aesenc has a latency of several
+ *    cycles but a throughput of one or two per cycle, so 8 independent
+ *    blocks keep the unit busy.
+ */
+#define AESCTR_AESNI_WAYS   8
+
+typedef void (*aesctr_fill_t)(aesctr_t *a, uint64_t *array, size_t blocks);
+
+static const uint8_t AESCTR_SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static const uint8_t AESCTR_RCON[AESCTR_ROUNDS] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static inline uint8_t aesctr_xtime(uint8_t b)
+{
+    return (uint8_t)((b << 1) ^ ((b & 0x80) ? 0x1b : 0));
+}
+
+static inline void aesctr_store64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint64_t aesctr_load64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+static inline uint32_t aesctr_rotl(uint32_t x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+static bool aesctr_make_te(uint32_t te[256])
+{
+    for (int x = 0; x < 256; x++) {
+        uint32_t sb = AESCTR_SBOX[x], sb2 = aesctr_xtime((uint8_t)sb);
+        te[x] = sb2 | (sb << 8) | (sb << 16) | ((sb2 ^ sb) << 24);
+    }
+    return true;
+}
+
+/*!
+ * \brief SubBytes and MixColumns of one byte of a column, as the column
+ *        word it adds (2s, s, s, 3s), rotated for the other rows. Made
+ *        once from the S-box.
+ */
+static const uint32_t *aesctr_te(void)
+{
+    static uint32_t te[256];
+    static const bool made = aesctr_make_te(te);
+
+    (void)made;
+    return te;
+}
+
+static inline uint32_t aesctr_load32(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*!
+ * \brief the whole blocks, portable code
+ */
+static void aesctr_fill_scalar(aesctr_t *a, uint64_t *array, size_t blocks)
+{
+    uint8_t ctr[16], out[16];
+
+    aesctr_store64(ctr + 8, a->stream);
+    for (size_t i = 0; i < blocks; i++) {
+        aesctr_store64(ctr, a->counter);
+        aesctr_encrypt(a, ctr, out);
+        array[2 * i]     = aesctr_load64(out);
+        array[2 * i + 1] = aesctr_load64(out + 8);
+        a->counter++;
+    }
+}
+
+#if defined(AESCTR_AESNI)
+/*!
+ * \brief AESCTR_AESNI_WAYS blocks per loop, each round issued for all of
+ *        them before the next round
+ */
+__attribute__((target("aes,sse2")))
+static void aesctr_fill_aesni(aesctr_t *a, uint64_t *array, size_t blocks)
+{
+    __m128i rk[AESCTR_ROUNDS + 1];
+    size_t  i;
+
+    for (int r = 0; r <= AESCTR_ROUNDS; r++)
+        rk[r] = _mm_load_si128((const __m128i *)a->rk[r]);
+
+    for (i = 0; i + AESCTR_AESNI_WAYS <= blocks; i += AESCTR_AESNI_WAYS) {
+        __m128i b[AESCTR_AESNI_WAYS];
+
+        for (int w = 0; w < AESCTR_AESNI_WAYS; w++)
+            b[w] = _mm_xor_si128(_mm_set_epi64x((long long)a->stream, (long long)(a->counter + w)), rk[0]);
+        for (int r = 1; r < AESCTR_ROUNDS; r++)
+            for (int w = 0; w < AESCTR_AESNI_WAYS; w++)
+                b[w] = _mm_aesenc_si128(b[w], rk[r]);
+        for (int w = 0; w < AESCTR_AESNI_WAYS; w++)
+            _mm_storeu_si128((__m128i *)(array + 2 * (i + w)), _mm_aesenclast_si128(b[w], rk[AESCTR_ROUNDS]));
+        a->counter += AESCTR_AESNI_WAYS;
+    }
+    aesctr_fill_scalar(a, array + 2 * i, blocks - i);
+}
+#endif
+
+static aesctr_fill_t aesctr_fill = NULL;
+static const char   *aesctr_isa_name = "scalar";
+
+static aesctr_fill_t aesctr_select(void)
+{
+    aesctr_fill_t fill = aesctr_fill_scalar;
+    const char   *isa = "scalar";
+
+#if defined(AESCTR_AESNI)
+    if (__builtin_cpu_supports("aes")) {
+        fill = aesctr_fill_aesni;
+        isa = "AES-NI";
+    }
+#endif
+    aesctr_isa_name = isa;
+    __atomic_store_n(&aesctr_fill, fill, __ATOMIC_RELEASE);
+    return fill;
+}
+
+static void aesctr_fill_array64(aesctr_t *a, uint64_t *array, size_t size, aesctr_fill_t fill)
+{
+    fill(a, array, size / 2);
+    if (size & 1) {
+        uint64_t last[2];
+        aesctr_fill_scalar(a, last, 1);
+        array[size - 1] = last[0];
+    }
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+void aesctr_set_key(aesctr_t *a, const uint8_t key[16])
+{
+    memcpy(a->rk[0], key, 16);
+    for (int r = 1; r <= AESCTR_ROUNDS; r++) {
+        const uint8_t *prev = a->rk[r - 1];
+        uint8_t       *rk = a->rk[r];
+        uint8_t        t[4];
+
+        // RotWord, SubWord and Rcon of the last word of the previous key
+        t[0] = AESCTR_SBOX[prev[13]] ^ AESCTR_RCON[r - 1];
+        t[1] = AESCTR_SBOX[prev[14]];
+        t[2] = AESCTR_SBOX[prev[15]];
+        t[3] = AESCTR_SBOX[prev[12]];
+        for (int i = 0; i < 16; i++) {
+            rk[i] = prev[i] ^ t[i & 3];
+            t[i & 3] = rk[i];
+        }
+    }
+}
+
+void aesctr_init(aesctr_t *a, uint64_t seed, uint64_t stream)
+{
+    uint8_t key[16];
+
+    aesctr_store64(key, randmix_splitmix64(&seed));
+    aesctr_store64(key + 8, randmix_splitmix64(&seed));
+    aesctr_set_key(a, key);
+    a->stream = stream;
+    a->counter = 0;
+}
+
+void aesctr_encrypt(const aesctr_t *a, const uint8_t in[16], uint8_t out[16])
+{
+    const uint32_t *te = aesctr_te();
+    uint32_t w[4], t[4];
+
+    // the state as 4 little endian column words, a round is 16 table lookups
+    for (int c = 0; c < 4; c++)
+        w[c] = aesctr_load32(in + 4 * c) ^ aesctr_load32(a->rk[0] + 4 * c);
+    for (int r = 1; r < AESCTR_ROUNDS; r++) {
+        for (int c = 0; c < 4; c++)
+            t[c] = te[w[c] & 0xff]
+                 ^ aesctr_rotl(te[(w[(c + 1) & 3] >> 8) & 0xff], 8)
+                 ^ aesctr_rotl(te[(w[(c + 2) & 3] >> 16) & 0xff], 16)
+                 ^ aesctr_rotl(te[w[(c + 3) & 3] >> 24], 24)
+                 ^ aesctr_load32(a->rk[r] + 4 * c);
+        memcpy(w, t, sizeof(t));
+    }
+    for (int c = 0; c < 4; c++) {
+        const uint8_t *rk = a->rk[AESCTR_ROUNDS] + 4 * c;
+        out[4 * c + 0] = AESCTR_SBOX[w[c] & 0xff] ^ rk[0];
+        out[4 * c + 1] = AESCTR_SBOX[(w[(c + 1) & 3] >> 8) & 0xff] ^ rk[1];
+        out[4 * c + 2] = AESCTR_SBOX[(w[(c + 2) & 3] >> 16) & 0xff] ^ rk[2];
+        out[4 * c + 3] = AESCTR_SBOX[w[(c + 3) & 3] >> 24] ^ rk[3];
+    }
+}
+
+void aesctr_fill_array64(aesctr_t *a, uint64_t *array, size_t size)
+{
+    aesctr_fill_t fill = __atomic_load_n(&aesctr_fill, __ATOMIC_ACQUIRE);
+    if (fill == NULL)
+        fill = aesctr_select();
+    aesctr_fill_array64(a, array, size, fill);
+}
+
+void aesctr_fill_array64_scalar(aesctr_t *a, uint64_t *array, size_t size)
+{
+    aesctr_fill_array64(a, array, size, aesctr_fill_scalar);
+}
+
+const char *aesctr_isa(void)
+{
+    if (__atomic_load_n(&aesctr_fill, __ATOMIC_ACQUIRE) == NULL)
+        aesctr_select();
+    return aesctr_isa_name;
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _AESCTR_H_
+#define _AESCTR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def AESCTR_ROUNDS
+ *    AES-128, 10 rounds and 11 round keys.
+ */
+#define AESCTR_ROUNDS       10
+
+/*!
+ *  \brief AES-128 in counter mode as a generator: block n of a stream is
+ *         the encryption of the 16 bytes {n, stream} (two little endian
+ *         64-bit words) under the key, so like Philox any block is
+ *         computed directly and every stream of a key is a substream.
+ *         The round keys are kept expanded, 176 bytes.
+ */
+typedef struct
+{
+    alignas(16) uint8_t rk[AESCTR_ROUNDS + 1][16];  //!< FIPS-197 byte order
+    uint64_t    stream;         //!< counter bytes 8..15
+    uint64_t    counter;        //!< counter bytes 0..7, the next block
+} aesctr_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Expand the 128-bit \a key, the stream and the next block are
+ *       not changed.
+ */
+void aesctr_set_key(aesctr_t *a, const uint8_t key[16]);
+
+/*!
+ * \brief Key from splitmix64 of \a seed, the stream to \a stream, and
+ *       the next block to 0.
+ */
+void aesctr_init(aesctr_t *a, uint64_t seed, uint64_t stream);
+
+/*!
+ * \brief One AES-128 encryption of \a in, by the portable table code, for
+ *       random access and the known answer tests.
+ */
+void aesctr_encrypt(const aesctr_t *a, const uint8_t in[16], uint8_t out[16]);
+
+/*!
+ * \brief Fill \a array with the 64-bit numbers of the next blocks, two per
+ *       block (bytes 0..7 and 8..15, little endian). With AES-NI the
+ *       blocks are encrypted 8 at a time, otherwise by the portable code.
+ *       An odd \a size drops the second half of the last block.
+ */
+void aesctr_fill_array64(aesctr_t *a, uint64_t *array, size_t size);
+
+/*!
+ * \brief Same numbers as aesctr_fill_array64, by the portable code, the
+ *       reference of the AES-NI path.
+ */
+void aesctr_fill_array64_scalar(aesctr_t *a, uint64_t *array, size_t size);
+
+/*!
+ * \brief Name of the instruction set aesctr_fill_array64 uses.
+ */
+const char *aesctr_isa(void);
+
+#endif//_AESCTR_H_
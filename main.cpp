@@ -18,9 +18,27 @@
 
 #include <set>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <signal.h>
 #include <random>                       //  50M/s, Too Slow
 #include "SFMT.h"                       // 756M/s, Super Fast
+#include "SFMT-range.h"
+#include "SFMT-engine.h"
 #include "os_wrapper.h"
+#include "randfile.h"
+#include "randpool.h"
+#include "randbuf.h"
+#include "randdist.h"
+#include "randbench.h"
+#include "randckpt.h"
+#include "randlog.h"
+#include "randstat.h"
+#include "aesctr.h"
+#include "randnodes.h"
+#include "randsched.h"
+#include "randsim.h"
+#include "randproc.h"
 
 typedef enum
 {
@@ -31,21 +49,6 @@ typedef enum
     INS_RAND_MAX
 } instruction_opcode_t;
 
-typedef enum
-{
-    ALGO_SFMT_SSE2_SEQUE           = 0,     // SFMT Sequence Algorithm by SSE2 Implementation
-    ALGO_SFMT_SSE2_BLOCK              ,     // SFMT Block Algorithm by SSE2 Implementation
-    ALGO_SYSTEM_RANDOM                ,     // System Random Algorithm std::mt19937
-
-    ALGO_MAX
-} rand_algo_type;
-
-const char *rand_algo_str[ALGO_MAX] = {
-        "SFMT Sequence Algorithm by SSE2"           ,
-        "SFMT Block Algorithm by SSE2"              ,
-        "System Random Algorithm by std::mt19937"   ,
-};
-
 static instruction_opcode_t instructionShared = INS_rand_wait;
 static bool          bRandGenerating = false;
 static std::mutex    minerMutex;
@@ -56,25 +59,310 @@ static uint64_t randomGenerated = 0;
 static const int networknodes = ALLNODES;
 static int   activethreads = 3;
 
+#define          TOTAL_WORK_THREAD  8
+
+static bool          bLibraryRun = false;      // the block generators run on the pool of librandsim
+
+#define          RAND_STREAMS   64             // logical streams of the deterministic mode
+
+/*!
+ *  \brief One logical stream of the deterministic mode. A tick of a stream
+ *         is the scan of loop2 numbers, the streams are dealt to the workers
+ *         round robin, so what a stream draws doesn't depend on the workers.
+ */
+typedef struct {
+    sfmt_t      sfmt;
+    alignas(64) uint64_t ticks;             //!< ticks done, published to the manager
+} rand_stream_t;
+
+static bool          bDeterministic = false;
+static uint32_t      masterSeed = 0;           // substreams of the jumpable engines
+static rand_stream_t randStreams[RAND_STREAMS];
+static int           workerJoined = 0;
+
+#define          RAND_CKPT_AHEAD 2             // checkpoint tick ahead of the fastest stream
+
+static uint64_t      ckptTick = (uint64_t)-1;  // stream tick of the requested checkpoint
+static sfmt_t        ckptStreams[RAND_STREAMS];// stream states at the start of ckptTick
+static uint64_t      ckptTaken[RAND_STREAMS];  // tick of each saved state
+
+static randlog_t    *eventLog = NULL;           // binary log of the found numbers, '-l'
+static randnodes_t   randNodes;                 // the network nodes of RANDSIM_ALGO_NODES_SOA
+
+#define          RAND_NODE_FINDS 64            // finds taken from one randnodes_tick
+static thread_local uint32_t workerIndex = 0;
+static thread_local uint64_t workerTick = 0;    // ticks of the worker, not deterministic mode
+
+static randsched_profile_t schedProfile;        // '-R', off if not given
+static randsched_jitter_t  blockJitter[THREAD_ID_MAX]; // block times of each worker
+
 typedef enum{
     zero32bit_heading,
     one32bit_heading,
 } heading_type;
 
-static inline void report_news(uint64_t nTime, uint64_t magicNumber, heading_type headingtype)
+static inline void report_news(uint64_t nTime, uint64_t magicNumber, heading_type headingtype,
+        uint64_t stamp = 0, uint32_t source = 0)
 {
     msg_t goodnews;
     if (headingtype==zero32bit_heading){
-        msgS_allocate(goodnews, MSG_found_odd0, nTime, magicNumber);
+        msgS_allocate_stamped(goodnews, MSG_found_odd0, nTime, magicNumber, stamp, source);
     }
     else{           //one32bit_heading
-        msgS_allocate(goodnews, MSG_found_odd1, nTime, magicNumber);
+        msgS_allocate_stamped(goodnews, MSG_found_odd1, nTime, magicNumber, stamp, source);
     }
     minerMutex.lock();
     msgQ_send(QUEUE_ID_manager, goodnews);
     minerMutex.unlock();
+
+    if (eventLog != NULL){
+        randlog_append(eventLog, magicNumber, nTime, bDeterministic ? stamp : workerTick, workerIndex, source,
+                (headingtype==zero32bit_heading) ? RANDLOG_HEADING_0 : RANDLOG_HEADING_1);
+    }
+}
+
+
+/*!
+ * \brief scan loop2 numbers of \<random\> distribution on any engine
+ */
+template <class Engine>
+static inline void rand_distribution_scan(Engine &engine, int loop2,
+        uint64_t nTime0, uint64_t nTime1, bool &found0, bool &found1)
+{
+    std::uniform_int_distribution<uint64_t> uint64_dist; // by default range [0, MAX]
+    uint64_t    magicNumber;
+    uint32_t   *pMagicNumberH = (uint32_t *)&magicNumber;
+    pMagicNumberH++;
+
+    for (int i=0; i<loop2; i++){
+        magicNumber = uint64_dist(engine);
+        if (*pMagicNumberH == 0){
+            report_news( nTime0, magicNumber, zero32bit_heading);
+            found0 = true;
+        }
+        else if (*pMagicNumberH == (uint32_t)-1){
+            report_news( nTime1, magicNumber, one32bit_heading);
+            found1 = true;
+        }
+    }
+}
+
+/*!
+ * \brief scan loop2 numbers consumed from the SFMT blocks in place
+ */
+static inline void rand_range_scan(sfmt_t *sfmt, int loop2,
+        uint64_t nTime0, uint64_t nTime1, bool &found0, bool &found1,
+        uint64_t stamp = 0, uint32_t source = 0)
+{
+    for (int i=0; i<loop2; ){
+        sfmt_range64_t range = sfmt_block64(sfmt, loop2 - i);
+        for (uint64_t v : range){
+            if ((uint32_t)((v >> 32) + 1) <= 1){    // 32bits leading 0 or 1
+                if ((v >> 32) == 0){
+                    report_news( nTime0, v, zero32bit_heading, stamp, source);
+                    found0 = true;
+                }
+                else{
+                    report_news( nTime1, v, one32bit_heading, stamp, source);
+                    found1 = true;
+                }
+            }
+        }
+        i += range.size();
+    }
+}
+
+/*!
+ * \brief one number of each node of a chunk of loop2 nodes, by the node's
+ *        own generator and hash power
+ */
+static inline void rand_nodes_tick(uint32_t chunk, int loop2,
+        uint64_t nTime0, uint64_t nTime1, bool &found0, bool &found1)
+{
+    randnodes_find_t finds[RAND_NODE_FINDS];
+    uint32_t next = chunk * (uint32_t)loop2;
+    uint32_t end = next + (uint32_t)loop2;
+    uint32_t found;
+
+    while (next < end){
+        next = randnodes_tick(&randNodes, next, end, finds, RAND_NODE_FINDS, &found);
+        for (uint32_t k=0; k<found; k++){
+            if (finds[k].heading == 0){
+                report_news( nTime0, finds[k].number, zero32bit_heading);
+                found0 = true;
+            }
+            else{
+                report_news( nTime1, finds[k].number, one32bit_heading);
+                found1 = true;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief draw the found numbers of loop2 numbers without scanning them
+ */
+static inline void rand_binomial_tick(sfmt_t *sfmt, int loop2,
+        uint64_t nTime0, uint64_t nTime1, bool &found0, bool &found1,
+        uint64_t stamp = 0, uint32_t source = 0)
+{
+    // each number is 32bits leading 0 with p = 2^-32, leading 1 with the same p,
+    // so the counts of one tick are k0 ~ B(loop2, p), k1 ~ B(loop2-k0, p/(1-p))
+    const double p = 1.0 / 4294967296.0;
+    uint64_t k0 = randdist_binomial(sfmt, loop2, p);
+    uint64_t k1 = randdist_binomial(sfmt, loop2 - k0, p / (1.0 - p));
+    for (uint64_t k=0; k<k0; k++){
+        report_news( nTime0, sfmt_genrand_uint64(sfmt) & 0xffffffffULL, zero32bit_heading, stamp, source);
+        found0 = true;
+    }
+    for (uint64_t k=0; k<k1; k++){
+        report_news( nTime1, sfmt_genrand_uint64(sfmt) | 0xffffffff00000000ULL, one32bit_heading, stamp, source);
+        found1 = true;
+    }
+}
+
+/*!
+ * \brief deterministic mode worker: tick the streams s = worker (mod activethreads)
+ *        in turn. An event carries its logical time, stream tick * RAND_STREAMS
+ *        + stream, as nTime and as the stamp the manager merges on.
+ */
+static void rand_stream_run(randsim_algo_t rand_algo, int worker, int loop2)
+{
+    bool found0, found1;
+
+    if ((rand_algo != RANDSIM_ALGO_SFMT_RANGE) && (rand_algo != RANDSIM_ALGO_BINOMIAL_TICK)
+            && (rand_algo != RANDSIM_ALGO_SFMT_SEQUE) && (rand_algo != RANDSIM_ALGO_SFMT_BLOCK)){
+        if (worker == 0)
+            syslog(LM_RAND, LOG_WARNING, "warning: [%s] is not reproducible, deterministic mode uses [%s].\n",
+                    randsim_algo_name(rand_algo), randsim_algo_name(RANDSIM_ALGO_SFMT_RANGE));
+        rand_algo = RANDSIM_ALGO_SFMT_RANGE;
+    }
+
+    while (instructionShared==INS_rand_start){
+        for (uint32_t s=worker; s<RAND_STREAMS; s+=activethreads){
+            rand_stream_t *st = &randStreams[s];
+            uint64_t tick = st->ticks;
+            uint64_t nTime = tick * RAND_STREAMS + s;
+
+            // the ticks store and this load pair with the manager's request, see rand_checkpoint_request()
+            if (tick == __atomic_load_n(&ckptTick, __ATOMIC_SEQ_CST)){
+                ckptStreams[s] = st->sfmt;
+                ckptTaken[s] = tick;
+            }
+
+            // SEQUE and BLOCK draw the same numbers as RANGE, only slower
+            if (rand_algo == RANDSIM_ALGO_BINOMIAL_TICK)
+                rand_binomial_tick(&st->sfmt, loop2, nTime, nTime, found0, found1, tick, s);
+            else
+                rand_range_scan(&st->sfmt, loop2, nTime, nTime, found0, found1, tick, s);
+
+            __atomic_store_n(&st->ticks, tick + 1, __ATOMIC_SEQ_CST);
+
+            minerMutex.lock();
+            randomGenerated += loop2;
+            minerMutex.unlock();
+        }
+    }
 }
 
+/*!
+ *  \brief A worker of the library pool as the manager sees it: the tick of
+ *         its last find of each heading, and the nTime of that tick.
+ */
+typedef struct {
+    alignas(64) uint64_t lastTick[2];      //!< (uint64_t)-1 before the first find
+    uint64_t    nTime[2];
+} rand_library_worker_t;
+
+typedef struct {
+    uint64_t                loop2;
+    rand_library_worker_t   worker[TOTAL_WORK_THREAD];
+} rand_library_t;
+
+/*!
+ * \brief an event of a library worker, on its thread. Its tick is the number's
+ *        position / loop2, the finds of one tick share the nTime of the tick
+ *        as the scan loops give them.
+ */
+static void rand_library_event(const randsim_event_t *ev, void *ctx)
+{
+    rand_library_t *lib = (rand_library_t *)ctx;
+    rand_library_worker_t *wk = &lib->worker[ev->worker];
+    uint64_t tick = (ev->at - 1) / lib->loop2;
+    int h = ev->pred;
+
+    if (wk->lastTick[h] != tick){
+        wk->nTime[h] = tick - ((wk->lastTick[h] == (uint64_t)-1) ? 0 : wk->lastTick[h] + 1);
+        wk->lastTick[h] = tick;
+    }
+    workerIndex = (uint32_t)ev->worker;
+    workerTick = tick;
+    report_news( wk->nTime[h], ev->number, (h == 0) ? zero32bit_heading : one32bit_heading);
+}
+
+/*!
+ * \brief a library worker thread starts, it takes the schedule profile of
+ *        its worker index as the threads of randworker_init()
+ */
+static void rand_library_start(int worker, void *ctx)
+{
+    (void)ctx;
+    if (schedProfile.enabled){
+        thread_sched_t sched;
+        randsched_worker(&schedProfile, worker, &sched);
+        thread_self_sched("worker", &sched);
+    }
+}
+
+/*!
+ * \brief the block generators run on the worker pool of librandsim, this
+ *        thread being its worker 0: a randsim_run() is one tick of loop2
+ *        numbers of every worker, worker w draws stream w of the master seed.
+ */
+static void rand_library_run(randsim_algo_t rand_algo, int loop2)
+{
+    static rand_library_t library;
+    rand_library_t *lib = &library;
+    randsim_config_t cfg;
+
+    lib->loop2 = (uint64_t)loop2;
+    for (int w=0; w<TOTAL_WORK_THREAD; w++){
+        lib->worker[w].lastTick[0] = lib->worker[w].lastTick[1] = (uint64_t)-1;
+        lib->worker[w].nTime[0] = lib->worker[w].nTime[1] = 0;
+    }
+
+    randsim_config_init(&cfg);
+    cfg.algo = rand_algo;
+    cfg.threads = activethreads;
+    cfg.seed = masterSeed;
+    cfg.event = rand_library_event;
+    cfg.start = rand_library_start;
+    cfg.ctx = lib;
+    randsim_t *rs = randsim_create(&cfg);
+    if (rs == NULL){
+        syslog(LM_RAND, LOG_ERROR, "\nworker pool of [%s] creation failed.\n", randsim_algo_name(rand_algo));
+        return;
+    }
+    // the predicate ids are the headings
+    randsim_add_predicate(rs, "32bits leading 0", randsim_pred_leading0, (void *)32);
+    randsim_add_predicate(rs, "32bits leading 1", randsim_pred_leading1, (void *)32);
+
+    randsched_jitter_t *jitter = &blockJitter[0];
+    uint64_t blockBegin = randsched_now_ns();
+    while (instructionShared==INS_rand_start){
+        randsim_run(rs, (uint64_t)loop2 * activethreads);
+
+        minerMutex.lock();
+        randomGenerated += (uint64_t)loop2 * activethreads;
+        minerMutex.unlock();
+
+        uint64_t blockEnd = randsched_now_ns();
+        randsched_jitter_add(jitter, blockEnd - blockBegin);
+        blockBegin = blockEnd;
+    }
+
+    randsim_destroy(rs);
+}
 
 static void rand_thread_entry(void)
 {
@@ -83,10 +371,6 @@ static void rand_thread_entry(void)
     int         i;
     int loop2 = (networknodes>>5);            // must be 4*x
 
-    w128_t     *array1 = new w128_t[(ALLNODES>>5) / 2];
-    uint64_t   *array64 = (uint64_t *)array1;
-    uint32_t   *array64h= (uint32_t *)array1;
-
     std::random_device rd;
     std::mt19937 rng(rd());
     std::uniform_int_distribution<uint64_t> uint64_dist; // by default range [0, MAX]
@@ -97,10 +381,10 @@ static void rand_thread_entry(void)
     // random seed
     rand_seed = (uint32_t)uint64_dist(rng);
     sfmt_init_gen_rand(&sfmt, rand_seed);
+    sfmt19937_64 sfmtEngine(uint64_dist(rng));
 
     if (sfmt_get_min_array_size64(&sfmt) > loop2) {
         syslog(LM_RAND, LOG_ERROR, "array size too small!\n");
-        if (array1) free(array1);
         return;
     }
 
@@ -112,17 +396,31 @@ static void rand_thread_entry(void)
 
         else if (msg_opcode(msg) == MSG_worker_start)
         {
-            rand_algo_type rand_algo = (rand_algo_type)msgS_data(msg);
-            if (rand_algo < ALGO_MAX)
-                syslog(LM_RAND, LOG_VERBOSE, "This thread's using algo: [%s]\n", rand_algo_str[rand_algo]);
+            randsim_algo_t rand_algo = (randsim_algo_t)msgS_data(msg);
+            if (rand_algo < RANDSIM_ALGO_MAX)
+                syslog(LM_RAND, LOG_VERBOSE, "This thread's using algo: [%s]\n", randsim_algo_name(rand_algo));
             uint32_t *pMagicNumberH = (uint32_t *)&magicNumber;
             pMagicNumberH++;
 
+            workerIndex = (uint32_t)__atomic_fetch_add(&workerJoined, 1, __ATOMIC_RELAXED);
+
+            if (bLibraryRun){
+                rand_library_run(rand_algo, loop2);
+                continue;
+            }
+            if (bDeterministic){
+                rand_stream_run(rand_algo, (int)workerIndex, loop2);
+                continue;
+            }
+
             uint64_t nTime0=0, nTime1=0;
+            uint32_t nodeChunk = workerIndex;   // the chunks of nodes are dealt round robin
             bool     found0=false, found1=false;
+            randsched_jitter_t *jitter = &blockJitter[workerIndex % THREAD_ID_MAX];
+            uint64_t blockBegin = randsched_now_ns();
             while (instructionShared==INS_rand_start){
 
-                if (rand_algo == ALGO_SFMT_SSE2_SEQUE){
+                if (rand_algo == RANDSIM_ALGO_SFMT_SEQUE){
                     for (i=0; i<loop2; i++){
                         magicNumber = sfmt_genrand_uint64(&sfmt);
                         if (*pMagicNumberH == 0){
@@ -135,38 +433,43 @@ static void rand_thread_entry(void)
                         }
                     }
                 }
-                else if (rand_algo == ALGO_SFMT_SSE2_BLOCK){
-                    sfmt_fill_array64(&sfmt, array64, loop2);
-
-                    array64h= (uint32_t *)array1;
-                    for (i=0,array64h++; i<loop2; i++, array64h+=2){
-                        if (*array64h == 0){
-                            report_news( nTime0, array64[i], zero32bit_heading);
-                            found0 = true;
-                        }
-                        else if (*array64h == -1){
-                            report_news( nTime1, array64[i], one32bit_heading);
-                            found1 = true;
-                        }
-                    }
-                }
-                else if (rand_algo == ALGO_SYSTEM_RANDOM){
+                else if (rand_algo == RANDSIM_ALGO_SFMT_BUFFERED){
+                    randbuf_t *rb = randbuf_get();
                     for (i=0; i<loop2; i++){
-                        magicNumber = uint64_dist(rng);
+                        magicNumber = randbuf_uint64(rb);
                         if (*pMagicNumberH == 0){
                             report_news( nTime0, magicNumber, zero32bit_heading);
                             found0 = true;
                         }
-                        else if (*pMagicNumberH == -1){
+                        else if (*pMagicNumberH == (uint32_t)-1){
                             report_news( nTime1, magicNumber, one32bit_heading);
                             found1 = true;
                         }
                     }
                 }
+                else if (rand_algo == RANDSIM_ALGO_SFMT_RANGE){
+                    rand_range_scan(&sfmt, loop2, nTime0, nTime1, found0, found1);
+                }
+                else if (rand_algo == RANDSIM_ALGO_SYSTEM_RANDOM){
+                    rand_distribution_scan(rng, loop2, nTime0, nTime1, found0, found1);
+                }
+                else if (rand_algo == RANDSIM_ALGO_SFMT_ENGINE){
+                    rand_distribution_scan(sfmtEngine, loop2, nTime0, nTime1, found0, found1);
+                }
+                else if (rand_algo == RANDSIM_ALGO_BINOMIAL_TICK){
+                    rand_binomial_tick(&sfmt, loop2, nTime0, nTime1, found0, found1);
+                }
+                else if (rand_algo == RANDSIM_ALGO_NODES_SOA){
+                    rand_nodes_tick(nodeChunk, loop2, nTime0, nTime1, found0, found1);
+                    nodeChunk += activethreads;
+                    if (nodeChunk >= (uint32_t)(networknodes / loop2))
+                        nodeChunk = workerIndex;
+                }
 
                 minerMutex.lock();
                 randomGenerated += loop2;
                 minerMutex.unlock();
+                workerTick ++;
                 nTime0 ++;
                 nTime1 ++;
                 if (found0){
@@ -178,34 +481,45 @@ static void rand_thread_entry(void)
                     nTime1 = 0;
                 }
 
+                uint64_t blockEnd = randsched_now_ns();
+                randsched_jitter_add(jitter, blockEnd - blockBegin);
+                blockBegin = blockEnd;
             }   // end of while loop of checking instructionShared
         }
     }
 
-    if (array1) free(array1);
     return;
 }
 
-#define TOTAL_WORK_THREAD  8
+/*!
+ * \brief threads of randworker_init(): one per worker, or the one which is
+ *        worker 0 of the library pool.
+ */
+static int rand_worker_threads(void)
+{
+    return bLibraryRun ? 1 : activethreads;
+}
 
 static int randworker_init(void)
 {
+    int threads = rand_worker_threads();
+
     oswrapper_init();
     msgQ_create(QUEUE_ID_minermgr);
     msgQ_create(QUEUE_ID_miner);
     if ( 0 != thread_create( THREAD_ID_worker1, rand_thread_entry ) ){
-            printf("\nimpossible error! thread creation failure.");
+            syslog(LM_RAND, LOG_ERROR, "\nimpossible error! thread creation failure.");
         return -1;
     }
-    if (activethreads>=2) thread_create( THREAD_ID_worker2, rand_thread_entry );
-    if (activethreads>=3) thread_create( THREAD_ID_worker3, rand_thread_entry );
-    if (activethreads>=4) thread_create( THREAD_ID_worker4, rand_thread_entry );
-    if (activethreads>=5) thread_create( THREAD_ID_worker5, rand_thread_entry );
-    if (activethreads>=6) thread_create( THREAD_ID_worker6, rand_thread_entry );
-    if (activethreads>=7) thread_create( THREAD_ID_worker7, rand_thread_entry );
-    if (activethreads>=8) thread_create( THREAD_ID_worker8, rand_thread_entry );
+    if (threads>=2) thread_create( THREAD_ID_worker2, rand_thread_entry );
+    if (threads>=3) thread_create( THREAD_ID_worker3, rand_thread_entry );
+    if (threads>=4) thread_create( THREAD_ID_worker4, rand_thread_entry );
+    if (threads>=5) thread_create( THREAD_ID_worker5, rand_thread_entry );
+    if (threads>=6) thread_create( THREAD_ID_worker6, rand_thread_entry );
+    if (threads>=7) thread_create( THREAD_ID_worker7, rand_thread_entry );
+    if (threads>=8) thread_create( THREAD_ID_worker8, rand_thread_entry );
 
-    printf("\n --- random number generation worker threads start. active thread numbers: %d---\n", activethreads);
+    syslog(LM_RAND, LOG_VERBOSE, "\n --- random number generation worker threads start. active thread numbers: %d---\n", activethreads);
 
     return 0;
 }
@@ -214,7 +528,275 @@ static int randworker_term(void)
 {
     oswrapper_term();
     bRandGenerating = false;
-    printf("\n --- random number generation worker threads stop. ---\n");
+    syslog(LM_RAND, LOG_VERBOSE, "\n --- random number generation worker threads stop. ---\n");
+    return 0;
+}
+
+/*!
+ * \brief deterministic mode: events wait here until every stream has passed
+ *        their tick, then they're taken in (tick, stream) order. The events
+ *        of one stream arrive in order, the multimap keeps the arrival order
+ *        of equal keys.
+ */
+static std::multimap<std::pair<uint64_t, uint32_t>, msg_t> pendingEvents;
+static uint64_t eventWatermark = 0;     // every stream has done this many ticks
+
+/*!
+ * \brief next event of the manager queue, in logical order in the
+ *        deterministic mode.
+ *
+ * \return int
+ *          - 0     : got one
+ *          - 1     : none for now
+ *          - others: queue failure
+ */
+static int rand_event_next(msg_t &msg)
+{
+    if (!bDeterministic)
+        return msgQ_recv_nowait(QUEUE_ID_manager, msg);
+
+    // the watermark first, so every event below it is already in the queue
+    uint64_t watermark = (uint64_t)-1;
+    for (int s=0; s<RAND_STREAMS; s++){
+        uint64_t ticks = __atomic_load_n(&randStreams[s].ticks, __ATOMIC_ACQUIRE);
+        if (ticks < watermark)
+            watermark = ticks;
+    }
+    eventWatermark = watermark;
+
+    // the events from a requested checkpoint on wait until it's taken
+    if (watermark > ckptTick)
+        watermark = ckptTick;
+
+    msg_t m;
+    int   status;
+    while ((status = msgQ_recv_nowait(QUEUE_ID_manager, m)) == 0){
+        pendingEvents.insert(std::make_pair(std::make_pair(msgS_stamp(m), msgS_source(m)), m));
+    }
+    if (status < 0)
+        return status;
+
+    if (pendingEvents.empty() || (pendingEvents.begin()->first.first >= watermark))
+        return 1;
+    msg = pendingEvents.begin()->second;
+    pendingEvents.erase(pendingEvents.begin());
+    return 0;
+}
+
+/*!
+ * \brief ask the workers to save their streams at the start of a common tick.
+ *        It's taken only if no stream can have started that tick before the
+ *        request is seen: the request store and the ticks loads here, the
+ *        ticks store and the request load in the workers are all seq_cst, so
+ *        a stream seen below the tick will see the request.
+ *
+ * \return true if requested, false to try again later
+ */
+static bool rand_checkpoint_request(void)
+{
+    uint64_t fastest = 0;
+    for (int s=0; s<RAND_STREAMS; s++){
+        uint64_t ticks = __atomic_load_n(&randStreams[s].ticks, __ATOMIC_SEQ_CST);
+        if (ticks > fastest)
+            fastest = ticks;
+    }
+
+    uint64_t tick = fastest + RAND_CKPT_AHEAD;
+    __atomic_store_n(&ckptTick, tick, __ATOMIC_SEQ_CST);
+    for (int s=0; s<RAND_STREAMS; s++){
+        if (__atomic_load_n(&randStreams[s].ticks, __ATOMIC_SEQ_CST) >= tick){
+            __atomic_store_n(&ckptTick, (uint64_t)-1, __ATOMIC_SEQ_CST);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief the requested checkpoint is complete when every stream has saved its
+ *        state and the manager has taken every event before the tick, but none
+ *        after it.
+ */
+static bool rand_checkpoint_ready(void)
+{
+    if (ckptTick == (uint64_t)-1)
+        return false;
+    if (eventWatermark <= ckptTick)
+        return false;
+    if (!pendingEvents.empty() && (pendingEvents.begin()->first.first < ckptTick))
+        return false;
+    for (int s=0; s<RAND_STREAMS; s++){
+        if (ckptTaken[s] != ckptTick){
+            syslog(LM_RAND, LOG_ERROR, "\ncheckpoint: stream %d missed tick %" PRIu64 "\n", s, ckptTick);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void rand_stat_report(const char *name, const randstat_t *st)
+{
+    randstat_result_t r;
+    randstat_result(st, &r);
+    if (r.n == 0)
+        return;
+    syslog(LM_RAND, LOG_VERBOSE, "\n%s interval: n=%" PRIu64 ", mean=%.1f +- %.1f (95%%), stddev=%.1f; model mean=%.1f, stddev=%.1f\n",
+            name, r.n, r.mean, r.ciHalf, sqrt(r.variance), r.modelMean, sqrt(r.modelVariance));
+    syslog(LM_RAND, LOG_VERBOSE, "%s interval: chi-square=%.2f (df=%d, p=%.4f), KS D=%.5f (p=%.4f)\n",
+            name, r.chi2, r.chi2df, r.chi2p, r.ks, r.ksp);
+}
+
+static volatile bool bPoolServing = false;
+
+static void randpool_signal(int sig)
+{
+    (void)sig;
+    bPoolServing = false;
+}
+
+static int randpool_daemon(const char *name, uint32_t blocks, int threads, uint32_t seed)
+{
+    randpool_t *pool = randpool_create(name, blocks, 0);
+    if (pool == NULL){
+        syslog(LM_RAND, LOG_ERROR, "\nrandom pool creation failed.\n");
+        return -1;
+    }
+
+    signal(SIGINT, randpool_signal);
+    signal(SIGTERM, randpool_signal);
+    bPoolServing = true;
+    std::thread server(randpool_serve, pool, threads, seed, &bPoolServing);
+
+    syslog(LM_RAND, LOG_VERBOSE, "\nrandom pool %s is serving, threads=%d. press 'q' and 'Enter' to quit.\n", name, threads);
+
+    randpool_stat_t stat, last;
+    memset(&last, 0, sizeof(last));
+    uint64_t blockbytes = (uint64_t)randpool_block_size(pool) * sizeof(w128_t);
+    int ticks = 0;
+    while (bPoolServing){
+        struct pollfd attention = { 0, POLLIN } ;
+        int   x,y = 0;
+        x = poll(&attention, 1, 100);           // 100ms
+        if (x){
+            y = getc(stdin);
+        }
+        if (x && ((y=='q') || (y=='Q'))){
+            syslog(LM_RAND, LOG_VERBOSE, "Quit by Request.\n");
+            break;
+        }
+        if (++ticks % 50 == 0){                 // every 5 seconds
+            randpool_get_stat(pool, &stat);
+            syslog(LM_RAND, LOG_VERBOSE, "random pool: produced=%.3f (GB/s), consumed=%.3f (GB/s), stalls=%" PRIu64 "\n",
+                    (double)(stat.produced - last.produced) * blockbytes / 5e9,
+                    (double)(stat.consumed - last.consumed) * blockbytes / 5e9,
+                    stat.stalls - last.stalls);
+            last = stat;
+        }
+    }
+    bPoolServing = false;
+    server.join();
+
+    randpool_get_stat(pool, &stat);
+    syslog(LM_RAND, LOG_VERBOSE, "\nrandom pool: total produced %" PRIu64 " blocks, consumed %" PRIu64 " blocks, stalls %" PRIu64 ", reclaimed %" PRIu64 "\n",
+            stat.produced, stat.consumed, stat.stalls, stat.reclaimed);
+    randpool_destroy(pool);
+    return 0;
+}
+
+/*!
+ *  \brief The finds of a multi process run, taken by the coordinator.
+ */
+typedef struct
+{
+    int         loopcount;
+    double      precision;
+    randstat_t  stat0;
+    randstat_t  stat1;
+} rand_process_t;
+
+static int rand_process_event(const randproc_event_t *ev, void *ctx)
+{
+    rand_process_t *rp = (rand_process_t *)ctx;
+
+    if (ev == NULL){
+        // use poll to get quit command from console
+        struct pollfd attention = { 0, POLLIN } ;
+        int   x,y = 0;
+        x = poll(&attention, 1, 0);
+        if (x){
+            y = getc(stdin);
+        }
+        if (x && ((y=='q') || (y=='Q'))){
+            syslog(LM_RAND, LOG_VERBOSE, "Quit by Request.\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    if (ev->heading == 0){
+        randstat_add(&rp->stat0, ev->nTime);
+        syslog(LM_RAND, LOG_VERBOSE, "magicNumber=%016" PRIx64 " loopleft=%-6d nTime=0x%08" PRIx64 ", process=%u tick=%" PRIu64 "\n",
+                ev->number, rp->loopcount, ev->nTime, ev->proc, ev->tick);
+        rp->loopcount--;
+        if ((rp->precision > 0) && (rp->loopcount > 0) && randstat_settled(&rp->stat0, rp->precision)){
+            syslog(LM_RAND, LOG_VERBOSE, "\nsettled: the mean interval is known within %.2f%%, %d finds left undone.\n", rp->precision * 100, rp->loopcount);
+            rp->loopcount = 0;
+        }
+    }
+    else{
+        randstat_add(&rp->stat1, ev->nTime);
+        syslog(LM_RAND, LOG_VERBOSE, "magicNumber=%016" PRIx64 " loopleft=%-6d nTime=0x%08" PRIx64 ", process=%u tick=%" PRIu64 "\n",
+                ev->number, rp->loopcount, ev->nTime, ev->proc, ev->tick);
+    }
+    return (rp->loopcount <= 0) ? 1 : 0;
+}
+
+/*!
+ * \brief The simulation on \a procs worker processes instead of threads,
+ *       one substream and one NUMA node each, see randproc.h.
+ */
+static int rand_process_run(int loopcount, int procs, randsim_algo_t rand_algo, uint32_t seed, double precision)
+{
+    randproc_config_t cfg;
+    randproc_result_t result;
+    rand_process_t rp;
+    double tickq = randstat_tick_probability(1.0 / 4294967296.0, (uint64_t)(networknodes>>5));
+
+    rp.loopcount = loopcount;
+    rp.precision = precision;
+    randstat_init(&rp.stat0, tickq, 0);
+    randstat_init(&rp.stat1, tickq, 0);
+
+    cfg.procs = procs;
+    cfg.algo = (int)rand_algo;
+    cfg.seed = seed;
+    cfg.numbers = (uint32_t)(networknodes>>5);
+    cfg.numa = true;
+    if (0 != randproc_run(&cfg, rand_process_event, &rp, &result)){
+        syslog(LM_RAND, LOG_ERROR, "\nmulti process run failed.\n");
+        return -1;
+    }
+
+    uint64_t usedMs = (uint64_t)(result.seconds * 1000);
+    if (usedMs == 0)
+        usedMs = 1;             // to avoid dividing by zero
+    syslog(LM_RAND, LOG_VERBOSE, "\nsimulation: random generated speed = %d (M/s), total used time = %d(s)\n",
+            (int)((result.ticks * cfg.numbers / usedMs) >> 10), (int)(usedMs / 1000));
+    syslog(LM_RAND, LOG_VERBOSE, "\nsimulation: found total 32bit0 leading: %" PRIu64 ", total 32bit1 leading: %" PRIu64 ", events dropped: %" PRIu64 ", processes restarted: %u\n",
+            result.found[0], result.found[1], result.dropped, result.restarts);
+    rand_stat_report("32bit0 leading", &rp.stat0);
+    rand_stat_report("32bit1 leading", &rp.stat1);
+
+    syslog(LM_RAND, LOG_VERBOSE, "\nInterval  0-Occur\n");
+    for (uint32_t s=0; s<RANDPROC_GRIDS; s++){
+        if (result.occurrence[0][s])
+            syslog(LM_RAND, LOG_VERBOSE, "%4d   %4d\n", s, (int)result.occurrence[0][s]);
+    }
+    syslog(LM_RAND, LOG_VERBOSE, "\nInterval  1-Occur\n");
+    for (uint32_t s=0; s<RANDPROC_GRIDS; s++){
+        if (result.occurrence[1][s])
+            syslog(LM_RAND, LOG_VERBOSE, "%4d   %4d\n", s, (int)result.occurrence[1][s]);
+    }
     return 0;
 }
 
@@ -223,42 +805,252 @@ int main(int argc, char* argv[])
     int totalfound0= 0;
     int totalfound1= 0;
     int loopcount = 10;       // On my mac, 1k need about 53 minutes, 15k need 11 hours
-    rand_algo_type rand_algo = ALGO_SFMT_SSE2_BLOCK;
+    randsim_algo_t rand_algo = RANDSIM_ALGO_SFMT_BLOCK;
+
+    const char *fillpath = NULL;
+    const char *poolname = NULL;
+    uint32_t    poolblocks = 0;
+    uint64_t    fillsize = 0;
+    int         fillthreads = 0;
+    bool        seeded = false;
+    bool        bench = false;
+    bool        processes = false;      // '-P', the threads are worker processes
+    uint32_t    seed = 0;
+    const char *ckptpath = NULL;
+    const char *resumepath = NULL;
+    const char *logpath = NULL;
+    int         ckptinterval = 60;      // seconds
+    double      precision = 0;          // early stop, relative half width of the mean's CI
+    double      spread = 0;             // log-normal sigma of the node hash powers
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "f:s:t:S:d:n:bDPc:i:r:l:e:p:L:R:")) != -1){
+        switch (opt){
+            case 'f': fillpath = optarg; break;
+            case 's': fillsize = randfile_parse_size(optarg); break;
+            case 't': fillthreads = atoi(optarg); break;
+            case 'd': poolname = optarg; break;
+            case 'n': poolblocks = (uint32_t)atoi(optarg); break;
+            case 'b': bench = true; break;
+            case 'D': bDeterministic = true; break;
+            case 'P': processes = true; break;
+            case 'c': ckptpath = optarg; break;
+            case 'i': ckptinterval = atoi(optarg); break;
+            case 'r': resumepath = optarg; break;
+            case 'l': logpath = optarg; break;
+            case 'e': precision = atof(optarg); break;
+            case 'p': spread = atof(optarg); break;
+            case 'R':
+                if (0 != randsched_parse(&schedProfile, optarg))
+                    argc = 0;       // force to print usage
+                break;
+            case 'L':
+                if (0 != syslog_set_levels(optarg))
+                    argc = 0;       // force to print usage
+                break;
+            case 'S': seed = (uint32_t)strtoul(optarg, NULL, 0); seeded = true; break;
+            default : argc = 0; break;     // force to print usage
+        }
+    }
 
-    if (argc > 4){
+    if ((argc == 0) || (argc - optind > 3) || ((resumepath != NULL) && (argc - optind > 1))){
         syslog(LM_RAND, LOG_WARNING, "usage: randsim numbers-of-precious-32bits-leading0 threads algorithm\n\
                 threads number: [1..8]\n\
-                algorithm: [0: SFMT-SEQUENCE; 1: SFMT-BLOCK; 2: SYSTEM RANDOM]\n\
-                Tips: if need quit during the generation, press 'q' and 'Enter'\n");
+                algorithm: [0: SFMT-SEQUENCE; 1: SFMT-BLOCK; 2: SYSTEM RANDOM; 3: SFMT-BUFFERED; 4: SFMT-RANGE; 5: SFMT ENGINE RANDOM; 6: SFMT BINOMIAL TICK; 7: PHILOX4x32-10; 8: XOSHIRO256++; 9: PCG64-DXSM; 10: AES-CTR; 11: MT19937-64; 12: PER NODE SOA]\n\
+                Tips: if need quit during the generation, press 'q' and 'Enter'\n\
+       or: randsim -D [-S seed] numbers threads algorithm\n\
+                deterministic run, the same seed gives the same histograms for any threads\n\
+       or: randsim -c file [-i seconds] [-S seed] numbers threads algorithm\n\
+                deterministic run, checkpoint to 'file' every 'seconds' (60) and at 'q'\n\
+       or: randsim -r file [-c file] [-i seconds] [threads]\n\
+                resume a checkpoint, on any number of threads\n\
+       or: randsim -P [-S seed] numbers processes algorithm\n\
+                forked worker processes [1..256] instead of threads, one per NUMA node in turn, a crashed one is restarted\n\
+                any simulation can also take '-l file' to log the found numbers for randsim-analyze\n\
+                and '-e precision' to stop once the mean interval is known to that relative precision\n\
+                algorithm 12 takes '-p sigma' for log-normal hash powers of the nodes\n\
+                '-R worker=fifo:80,manager=other:0:-10,cpus=isolated|2-5:7,mlock' sets a schedule profile\n\
+                '-L level' or '-L module=level,...' (oswrap, rand, debug) filters the log, 0 all .. 99 none\n\
+       or: randsim -f file -s size[K|M|G|T] [-t threads] [-S seed]\n\
+                fill the file with random data in place, by 'threads' workers\n\
+       or: randsim -d name [-n blocks] [-t threads] [-S seed]\n\
+                serve random blocks to local processes in shared memory 'name'\n\
+       or: randsim -b [name-filter]\n\
+                run the bulk API micro benchmarks\n");
 
         return 0;
     }
 
-    if (argc>=2){
-        loopcount = atoi(argv[1]);
+    // the log is written by its own thread from here, and flushed at exit
+    syslog_start();
+
+    if (!seeded){
+        std::random_device rd;
+        seed = rd();
+    }
+
+    if (bench){
+        return randbench_run(1.0, (argc - optind >= 1) ? argv[optind] : NULL);
+    }
+
+    if (poolname != NULL){
+        if ((fillthreads < 0) || (fillthreads > 256))
+            syslog(LM_RAND, LOG_WARNING, "warning: threads must be [1..256], already draw back to %d as default.\n", activethreads);
+        if ((fillthreads <= 0) || (fillthreads > 256))
+            fillthreads = activethreads;
+        return randpool_daemon(poolname, poolblocks, fillthreads, seed);
+    }
+
+    if (fillpath != NULL){
+        randfile_stat_t stat;
+        if (fillsize == 0){
+            syslog(LM_RAND, LOG_WARNING, "warning: file size missing or invalid, use -s size[K|M|G|T].\n");
+            return 0;
+        }
+        if ((fillthreads <= 0) || (fillthreads > 256)){
+            int given = fillthreads;
+            fillthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (fillthreads <= 0)
+                fillthreads = activethreads;
+            if (given != 0)
+                syslog(LM_RAND, LOG_WARNING, "warning: threads must be [1..256], already draw back to %d (online CPUs) as default.\n", fillthreads);
+        }
+        syslog(LM_RAND, LOG_VERBOSE, "\nrandom file fill: file=%s, size=%" PRIu64 " bytes, threads=%d, seed=0x%08x\n", fillpath, fillsize, fillthreads, seed);
+        if (0 != randfile_fill(fillpath, fillsize, fillthreads, seed, &stat)){
+            syslog(LM_RAND, LOG_ERROR, "\nrandom file fill failed.\n");
+            return -1;
+        }
+        syslog(LM_RAND, LOG_VERBOSE, "\nrandom file fill: speed = %.3f (GB/s), total used time = %.3f(s)\n",
+                (double)stat.bytes / stat.usedMs / 1e6, stat.usedMs / 1000.0);
+        return 0;
+    }
+
+    // a resume takes the numbers and the algorithm from the checkpoint, its
+    // only argument is the threads
+    int threadsArg = (resumepath != NULL) ? optind : optind + 1;
+
+    if ((argc - optind >= 1) && (resumepath == NULL)){
+        loopcount = atoi(argv[optind]);
         if ((loopcount <= 0) || (loopcount > 500000)){
             syslog(LM_RAND, LOG_WARNING, "warning: random precious too big, already draw back to 10 as default.\n");
             loopcount = 10;
         }
     }
 
-    if (argc>=3){
-        activethreads = atoi(argv[2]);
+    if ((argc > threadsArg) && processes){
+        activethreads = atoi(argv[threadsArg]);
+        if ((activethreads <= 0) || (activethreads > RANDPROC_MAX)){
+            syslog(LM_RAND, LOG_WARNING, "warning: processes must be [1..%d], already draw back to 3 as default.\n", RANDPROC_MAX);
+            activethreads = 3;
+        }
+    }
+    else if (argc > threadsArg){
+        activethreads = atoi(argv[threadsArg]);
         if ((activethreads <= 0) || (activethreads > 8)){
             syslog(LM_RAND, LOG_WARNING, "warning: active threads must be [1..8], already draw back to 3 as default.\n");
             activethreads = 3;
         }
     }
 
-    if (argc>=4){
-        rand_algo = (rand_algo_type)atoi(argv[3]);
-        if ((rand_algo < 0) || (rand_algo > ALGO_MAX)){
-            syslog(LM_RAND, LOG_WARNING, "warning: random generation algorithm parameter must be [0..2], already draw back to SFMT-BLOCK as default.\n");
-            rand_algo = ALGO_SFMT_SSE2_BLOCK;
+    if ((argc - optind >= 3) && (resumepath == NULL)){
+        rand_algo = (randsim_algo_t)atoi(argv[optind + 2]);
+        if ((rand_algo < 0) || (rand_algo >= RANDSIM_ALGO_MAX)){
+            syslog(LM_RAND, LOG_WARNING, "warning: random generation algorithm parameter must be [0..%d], already draw back to SFMT-BLOCK as default.\n", RANDSIM_ALGO_MAX-1);
+            rand_algo = RANDSIM_ALGO_SFMT_BLOCK;
         }
     }
 
-    syslog(LM_RAND, LOG_VERBOSE, "\nrandom simulation settings summary: precious-rand-numbers=%d, threads=%d, algorithm=[%s]\n", loopcount, activethreads, rand_algo_str[rand_algo]);
+    // a checkpoint is a stream tick, only the deterministic mode has one
+    randckpt_head_t ckpt;
+    bool resumed = false;
+    if ((ckptpath != NULL) || (resumepath != NULL))
+        bDeterministic = true;
+    if (ckptinterval <= 0)
+        ckptinterval = 60;
+
+    if (resumepath != NULL){
+        if ((0 != randckpt_load(resumepath, &ckpt, ckptStreams, RAND_STREAMS)) || (ckpt.streams != RAND_STREAMS)
+                || (ckpt.algo >= RANDSIM_ALGO_MAX) || (ckpt.loopcount <= 0)){
+            syslog(LM_RAND, LOG_ERROR, "\nno checkpoint to resume in %s.\n", resumepath);
+            return -1;
+        }
+        resumed = true;
+        seed = ckpt.seed;
+        loopcount = ckpt.loopcount;
+        rand_algo = (randsim_algo_t)ckpt.algo;
+        if (ckptpath == NULL)
+            ckptpath = resumepath;
+        syslog(LM_RAND, LOG_VERBOSE, "\nresume %s: tick=%" PRIu64 ", found %u/%u, the numbers and algorithm of the checkpoint are used.\n",
+                resumepath, ckpt.tick, ckpt.totalfound0, ckpt.totalfound1);
+    }
+
+    syslog(LM_RAND, LOG_VERBOSE, "\nrandom simulation settings summary: precious-rand-numbers=%d, threads=%d, algorithm=[%s]\n", loopcount, activethreads, randsim_algo_name(rand_algo));
+    if ((rand_algo == RANDSIM_ALGO_AESCTR) && (strcmp(aesctr_isa(), "AES-NI") != 0))
+        syslog(LM_RAND, LOG_WARNING, "warning: no AES-NI on this CPU, [%s] runs the portable AES code.\n", randsim_algo_name(rand_algo));
+
+    if (processes){
+        if (bDeterministic || resumed || (logpath != NULL))
+            syslog(LM_RAND, LOG_WARNING, "warning: -D, -c, -r and -l are for the threads, the multi process run ignores them.\n");
+        if ((rand_algo == RANDSIM_ALGO_BINOMIAL_TICK) || (rand_algo == RANDSIM_ALGO_NODES_SOA)){
+            syslog(LM_RAND, LOG_WARNING, "warning: [%s] is no generator, the processes run [%s].\n",
+                    randsim_algo_name(rand_algo), randsim_algo_name(RANDSIM_ALGO_SFMT_BLOCK));
+            rand_algo = RANDSIM_ALGO_SFMT_BLOCK;
+        }
+        return rand_process_run(loopcount, activethreads, rand_algo, seed, precision);
+    }
+
+    masterSeed = seed;
+    bLibraryRun = !bDeterministic && ((rand_algo == RANDSIM_ALGO_SFMT_BLOCK) || (rand_algo == RANDSIM_ALGO_PHILOX)
+            || (rand_algo == RANDSIM_ALGO_XOSHIRO) || (rand_algo == RANDSIM_ALGO_PCG64)
+            || (rand_algo == RANDSIM_ALGO_AESCTR) || (rand_algo == RANDSIM_ALGO_MT64));
+    if (bDeterministic){
+        syslog(LM_RAND, LOG_VERBOSE, "deterministic run: seed=0x%08x, logical streams=%d\n", seed, RAND_STREAMS);
+        for (uint32_t s=0; s<RAND_STREAMS; s++){
+            if (resumed){
+                randStreams[s].sfmt = ckptStreams[s];
+                randStreams[s].ticks = ckpt.tick;
+            }
+            else{
+                uint32_t key[2] = { seed, s };
+                sfmt_init_by_array(&randStreams[s].sfmt, key, 2);
+                randStreams[s].ticks = 0;
+            }
+        }
+    }
+    else if (rand_algo == RANDSIM_ALGO_SFMT_BUFFERED){
+        randbuf_start(activethreads, seed);     // one producer per worker
+    }
+    else if (rand_algo == RANDSIM_ALGO_NODES_SOA){
+        if (0 != randnodes_create(&randNodes, (uint32_t)networknodes, seed)){
+            syslog(LM_RAND, LOG_ERROR, "\nper node generators creation failed.\n");
+            return -1;
+        }
+        if (spread > 0){
+            sfmt_t sfmt;
+            sfmt_init_gen_rand(&sfmt, seed);
+            randnodes_set_power(&randNodes, &sfmt, spread);
+        }
+        syslog(LM_RAND, LOG_VERBOSE, "per node generators: nodes=%d, %d bytes per node, hash power spread=%.2f, %s\n",
+                networknodes, (int)(2 * sizeof(uint64_t) + sizeof(uint32_t)), spread, randnodes_isa());
+    }
+
+    if (logpath != NULL){
+        randlog_head_t loghead;
+        memset(&loghead, 0, sizeof(loghead));
+        loghead.seed = seed;
+        loghead.algo = (uint32_t)rand_algo;
+        loghead.deterministic = bDeterministic ? 1 : 0;
+        loghead.numbers = (uint32_t)(networknodes>>5);
+        loghead.streams = bDeterministic ? RAND_STREAMS : 0;
+        eventLog = randlog_open(logpath, &loghead);
+        if (eventLog == NULL){
+            syslog(LM_RAND, LOG_ERROR, "\nevent log creation failed.\n");
+            return -1;
+        }
+    }
+
+    if (schedProfile.enabled)
+        randsched_apply(&schedProfile, activethreads);
 
     bRandGenerating = true;
     randworker_init();
@@ -268,11 +1060,40 @@ int main(int argc, char* argv[])
     std::set<uint32_t> intervalsets1;
     std::map<uint32_t, uint32_t /*occurrence numbers*/> intervaloccurence1;
     uint32_t interval;
+    uint64_t randomResumed = 0;
+
+    // intervals against the model: each number is a find with p = 2^-32, a tick is loop2 numbers.
+    // A worker's nTime counts its ticks without a find from 0, the network time of the
+    // deterministic mode counts from the tick of the last find, so it's 1 at least.
+    randstat_t stat0, stat1;
+    double tickq = randstat_tick_probability(1.0 / 4294967296.0, (uint64_t)(networknodes>>5));
+    randstat_init(&stat0, tickq, bDeterministic ? 1 : 0);
+    randstat_init(&stat1, tickq, bDeterministic ? 1 : 0);
+
+    if (resumed){
+        totalfound0 = (int)ckpt.totalfound0;
+        totalfound1 = (int)ckpt.totalfound1;
+        for (uint32_t g=0; g<RANDCKPT_GRIDS; g++){
+            if (ckpt.occurrence0[g]){
+                intervalsets0.insert(g);
+                intervaloccurence0[g] = ckpt.occurrence0[g];
+            }
+            if (ckpt.occurrence1[g]){
+                intervalsets1.insert(g);
+                intervaloccurence1[g] = ckpt.occurrence1[g];
+            }
+        }
+        randomGenerated = randomResumed = ckpt.randomGenerated;
+        stat0 = ckpt.stat0;
+        stat1 = ckpt.stat1;
+    }
 
     struct timeval tp;
-    long int beginMs,currMs;
+    long int beginMs,currMs,ckptMs;
     gettimeofday(&tp, NULL);
     beginMs = tp.tv_sec * 1000 + tp.tv_usec / 1000;
+    ckptMs = beginMs;
+    bool bQuitAfterCkpt = false;
 
     //--- Command the Miners to Start the Random Number Generation Tasks
     int i;
@@ -283,7 +1104,7 @@ int main(int argc, char* argv[])
 
         msg_t taskmsg;
         msgS_allocate(taskmsg, MSG_worker_start, (uint64_t)rand_algo, (uint64_t)0);
-        for (i=0; i<activethreads; i++){
+        for (i=0; i<rand_worker_threads(); i++){
             if ( msgQ_send(QUEUE_ID_worker, taskmsg) !=0 ){
                 syslog(LM_RAND, LOG_ERROR, "\nFatal exception! msgQ_send failed.\n");
                 loopcount = 0;  // force to skip the following while loop
@@ -296,6 +1117,11 @@ int main(int argc, char* argv[])
     //--- Tips for Above Code: if Miners already in START state, just update nTime, which can trigger miner to update to new block header also.
 
     uint64_t nTime0, nTime1;
+    uint64_t lastTime0 = 0, lastTime1 = 0;      // logical time of the last finds, deterministic mode
+    if (resumed){
+        lastTime0 = ckpt.lastTime0;
+        lastTime1 = ckpt.lastTime1;
+    }
     bool     found0=false, found1=false;
     uint64_t magicNumber;
 
@@ -311,25 +1137,71 @@ int main(int argc, char* argv[])
             }
             if (x && ((y=='q') || (y=='Q'))){
                 syslog(LM_RAND, LOG_VERBOSE, "Quit by Request.\n");
-                break;
+                if (ckptpath == NULL)
+                    break;
+                bQuitAfterCkpt = true;              // quit at the next checkpoint
+            }
+        }
+
+        // Checkpoint, the save is in the background
+        if (ckptpath != NULL){
+            gettimeofday(&tp, NULL);
+            currMs = tp.tv_sec * 1000 + tp.tv_usec / 1000;
+            if ((ckptTick == (uint64_t)-1) && (bQuitAfterCkpt || (currMs - ckptMs >= ckptinterval * 1000L))){
+                rand_checkpoint_request();
+            }
+            else if (rand_checkpoint_ready()){
+                memset(&ckpt, 0, sizeof(ckpt));
+                ckpt.seed = seed;
+                ckpt.algo = (uint32_t)rand_algo;
+                ckpt.streams = RAND_STREAMS;
+                ckpt.loopcount = loopcount;
+                ckpt.tick = ckptTick;
+                ckpt.randomGenerated = ckptTick * RAND_STREAMS * (networknodes>>5);
+                ckpt.lastTime0 = lastTime0;
+                ckpt.lastTime1 = lastTime1;
+                ckpt.totalfound0 = (uint32_t)totalfound0;
+                ckpt.totalfound1 = (uint32_t)totalfound1;
+                for (const uint32_t& g : intervalsets0)
+                    ckpt.occurrence0[g] = intervaloccurence0[g];
+                for (const uint32_t& g : intervalsets1)
+                    ckpt.occurrence1[g] = intervaloccurence1[g];
+                ckpt.stat0 = stat0;
+                ckpt.stat1 = stat1;
+
+                randckpt_save_async(ckptpath, &ckpt, ckptStreams);
+                syslog(LM_RAND, LOG_VERBOSE, "checkpoint: tick=%" PRIu64 " loopleft=%d saved to %s\n", ckptTick, loopcount, ckptpath);
+                __atomic_store_n(&ckptTick, (uint64_t)-1, __ATOMIC_SEQ_CST);
+                ckptMs = currMs;
+                if (bQuitAfterCkpt)
+                    break;
             }
         }
 
         // Check if there's any good news
         msg_t       msg;
-        int status = msgQ_recv_nowait(QUEUE_ID_manager, msg);
+        int status = rand_event_next(msg);
         if (status == 0){
             if (msg_opcode(msg) == MSG_found_odd0)
             {
                 nTime0 = msgS_data(msg);
                 magicNumber = msgS_payload(msg);
                 found0 = true;
+                if (bDeterministic){
+                    // interval of the whole network, in stream ticks since the last find
+                    nTime0 -= lastTime0;
+                    lastTime0 += nTime0;
+                }
             }
             else if (msg_opcode(msg) == MSG_found_odd1)
             {
                 nTime1 = msgS_data(msg);
                 magicNumber = msgS_payload(msg);
                 found1 = true;
+                if (bDeterministic){
+                    nTime1 -= lastTime1;
+                    lastTime1 += nTime1;
+                }
             }
 
         }
@@ -344,6 +1216,7 @@ int main(int argc, char* argv[])
         if (found0){
             found0 = false;
             totalfound0++;
+            randstat_add(&stat0, nTime0);
 
             if ((nTime0 >> 32) > 0)
                 interval = (uint32_t)0xffffffff;
@@ -364,11 +1237,16 @@ int main(int argc, char* argv[])
             }
             syslog(LM_RAND, LOG_VERBOSE, "magicNumber=%016x loopleft=%-6d nTime=0x%08x, randomGenerated=0x%016lx\n", (magicNumber), loopcount, nTime0, randomGenerated);
             loopcount--;
+            if ((precision > 0) && (loopcount > 0) && randstat_settled(&stat0, precision)){
+                syslog(LM_RAND, LOG_VERBOSE, "\nsettled: the mean interval is known within %.2f%%, %d finds left undone.\n", precision * 100, loopcount);
+                loopcount = 0;
+            }
         }
 
         if (found1){
             found1 = false;
             totalfound1++;
+            randstat_add(&stat1, nTime1);
 
             if ((nTime1 >> 32) > 0)
                 interval = (uint32_t)0xffffffff;
@@ -396,8 +1274,10 @@ int main(int argc, char* argv[])
     if (currMs == beginMs){
         currMs = beginMs + 1;   // to avoid dividing by zero
     }
-    syslog(LM_RAND, LOG_VERBOSE, "\nsimulation: random generated speed = %d (M/s), total used time = %d(s)\n", (randomGenerated/(currMs-beginMs))>>10, (currMs-beginMs)/1000);
+    syslog(LM_RAND, LOG_VERBOSE, "\nsimulation: random generated speed = %d (M/s), total used time = %d(s)\n", ((randomGenerated-randomResumed)/(currMs-beginMs))>>10, (currMs-beginMs)/1000);
     syslog(LM_RAND, LOG_VERBOSE, "\nsimulation: found total 32bit0 leading: %d, total 32bit1 leading: %d\n", totalfound0, totalfound1);
+    rand_stat_report("32bit0 leading", &stat0);
+    rand_stat_report("32bit1 leading", &stat1);
 
     // miner threads safety close
     {
@@ -405,7 +1285,7 @@ int main(int argc, char* argv[])
         instructionShared = INS_rand_stop;
         msg_t quitcommand;
         msgS_allocate(quitcommand, MSG_worker_quit, 0, 0);
-        for (int i=0; i<activethreads; i++)
+        for (int i=0; i<rand_worker_threads(); i++)
         {
             if ( msgQ_send(QUEUE_ID_worker, quitcommand) !=0 )
                 break;
@@ -414,6 +1294,27 @@ int main(int argc, char* argv[])
 
         randworker_term();
     }
+    randsched_jitter_report(schedProfile.enabled ? "block time (schedule profile on)" : "block time (schedule profile off)",
+            blockJitter, THREAD_ID_MAX);
+
+    if (eventLog != NULL){
+        randlog_close(eventLog);
+        eventLog = NULL;
+    }
+
+    if ((ckptpath != NULL) && (0 != randckpt_wait())){
+        syslog(LM_RAND, LOG_ERROR, "\ncheckpoint: the last save to %s failed.\n", ckptpath);
+    }
+
+    if ((rand_algo == RANDSIM_ALGO_SFMT_BUFFERED) && !bDeterministic){
+        uint64_t refills, stalls;
+        randbuf_get_stat(&refills, &stalls);
+        randbuf_stop();
+        syslog(LM_RAND, LOG_VERBOSE, "\nbuffered generator: pre-filled buffers used = %" PRIu64 ", filled inline = %" PRIu64 "\n", refills, stalls);
+    }
+    if ((rand_algo == RANDSIM_ALGO_NODES_SOA) && !bDeterministic){
+        randnodes_destroy(&randNodes);
+    }
 
     syslog(LM_RAND, LOG_VERBOSE, "\nInterval  0-Occur\n");
     for (const uint32_t& s : intervalsets0){
@@ -0,0 +1,277 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <string.h>
+
+#if defined(HAVE_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MT64_AVX2       1
+#endif
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "mt64.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+#define MT64_MATRIX_A       0xB5026F5AA96619E9ULL
+#define MT64_UPPER_MASK     0xFFFFFFFF80000000ULL
+#define MT64_LOWER_MASK     0x000000007FFFFFFFULL
+
+/*!
+ *  \brief one instruction set: regenerate the state, and temper n words
+ */
+typedef struct
+{
+    void      (*twist)(uint64_t *mt);
+    void      (*temper)(const uint64_t *mt, uint64_t *out, size_t n);
+    const char *isa;
+} mt64_impl_t;
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static inline uint64_t mt64_twist_word(uint64_t x, uint64_t y, uint64_t m)
+{
+    uint64_t z = (x & MT64_UPPER_MASK) | (y & MT64_LOWER_MASK);
+    return m ^ (z >> 1) ^ ((y & 1) ? MT64_MATRIX_A : 0);
+}
+
+static inline uint64_t mt64_temper_word(uint64_t y)
+{
+    y ^= (y >> 29) & 0x5555555555555555ULL;
+    y ^= (y << 17) & 0x71D67FFFEDA60000ULL;
+    y ^= (y << 37) & 0xFFF7EEE000000000ULL;
+    y ^= (y >> 43);
+    return y;
+}
+
+/*!
+ * \brief the words from \a i to \a end of the twist, scalar, for the
+ *        ones left by the vector loops. Word i takes word i+M mod N.
+ */
+static inline void mt64_twist_range(uint64_t *mt, int i, int end)
+{
+    for (; i < end; i++)
+        mt[i] = mt64_twist_word(mt[i], mt[(i + 1) % MT64_N], mt[(i + MT64_M) % MT64_N]);
+}
+
+static void mt64_twist_scalar(uint64_t *mt)
+{
+    int i;
+
+    for (i = 0; i < MT64_N - MT64_M; i++)
+        mt[i] = mt64_twist_word(mt[i], mt[i + 1], mt[i + MT64_M]);
+    for (; i < MT64_N - 1; i++)
+        mt[i] = mt64_twist_word(mt[i], mt[i + 1], mt[i + MT64_M - MT64_N]);
+    mt64_twist_range(mt, i, MT64_N);
+}
+
+static void mt64_temper_scalar(const uint64_t *mt, uint64_t *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = mt64_temper_word(mt[i]);
+}
+
+static const mt64_impl_t mt64_impl_scalar = { mt64_twist_scalar, mt64_temper_scalar, "scalar" };
+
+#if defined(HAVE_SSE2)
+/*!
+ * \brief 2 words per instruction. Word i reads the old words i+1 and
+ *        i+M, or the new word i+M-N; none of them is in the same vector
+ *        as a word being written, so a vector loop gives the same state.
+ */
+static void mt64_twist_sse2(uint64_t *mt)
+{
+    const __m128i upper = _mm_set1_epi64x((long long)MT64_UPPER_MASK);
+    const __m128i lower = _mm_set1_epi64x((long long)MT64_LOWER_MASK);
+    const __m128i one = _mm_set1_epi64x(1);
+    const __m128i matrix = _mm_set1_epi64x((long long)MT64_MATRIX_A);
+    int i;
+
+#define MT64_TWIST_SSE2(i, j)                                                       \
+    {                                                                               \
+        __m128i x = _mm_load_si128((const __m128i *)&mt[i]);                        \
+        __m128i y = _mm_loadu_si128((const __m128i *)&mt[(i) + 1]);                 \
+        __m128i m = _mm_loadu_si128((const __m128i *)&mt[j]);                       \
+        __m128i z = _mm_or_si128(_mm_and_si128(x, upper), _mm_and_si128(y, lower)); \
+        __m128i a = _mm_and_si128(_mm_sub_epi64(_mm_setzero_si128(), _mm_and_si128(y, one)), matrix); \
+        _mm_store_si128((__m128i *)&mt[i], _mm_xor_si128(_mm_xor_si128(m, _mm_srli_epi64(z, 1)), a)); \
+    }
+    for (i = 0; i + 2 <= MT64_N - MT64_M; i += 2)
+        MT64_TWIST_SSE2(i, i + MT64_M);
+    for (; i + 2 <= MT64_N - 1; i += 2)
+        MT64_TWIST_SSE2(i, i + MT64_M - MT64_N);
+#undef MT64_TWIST_SSE2
+    mt64_twist_range(mt, i, MT64_N);
+}
+
+static void mt64_temper_sse2(const uint64_t *mt, uint64_t *out, size_t n)
+{
+    const __m128i t1 = _mm_set1_epi64x(0x5555555555555555LL);
+    const __m128i t2 = _mm_set1_epi64x(0x71D67FFFEDA60000LL);
+    const __m128i t3 = _mm_set1_epi64x((long long)0xFFF7EEE000000000ULL);
+    size_t i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        __m128i y = _mm_loadu_si128((const __m128i *)&mt[i]);
+        y = _mm_xor_si128(y, _mm_and_si128(_mm_srli_epi64(y, 29), t1));
+        y = _mm_xor_si128(y, _mm_and_si128(_mm_slli_epi64(y, 17), t2));
+        y = _mm_xor_si128(y, _mm_and_si128(_mm_slli_epi64(y, 37), t3));
+        y = _mm_xor_si128(y, _mm_srli_epi64(y, 43));
+        _mm_storeu_si128((__m128i *)&out[i], y);
+    }
+    mt64_temper_scalar(mt + i, out + i, n - i);
+}
+
+static const mt64_impl_t mt64_impl_sse2 = { mt64_twist_sse2, mt64_temper_sse2, "SSE2" };
+#endif
+
+#if defined(MT64_AVX2)
+/*!
+ * \brief 4 words per instruction, the same loop as the SSE2 one. The
+ *        first half is 156 words, the second 155, so 3 words and the
+ *        last one are left to the scalar code.
+ */
+__attribute__((target("avx2")))
+static void mt64_twist_avx2(uint64_t *mt)
+{
+    const __m256i upper = _mm256_set1_epi64x((long long)MT64_UPPER_MASK);
+    const __m256i lower = _mm256_set1_epi64x((long long)MT64_LOWER_MASK);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i matrix = _mm256_set1_epi64x((long long)MT64_MATRIX_A);
+    int i;
+
+#define MT64_TWIST_AVX2(i, j)                                                               \
+    {                                                                                       \
+        __m256i x = _mm256_load_si256((const __m256i *)&mt[i]);                             \
+        __m256i y = _mm256_loadu_si256((const __m256i *)&mt[(i) + 1]);                      \
+        __m256i m = _mm256_loadu_si256((const __m256i *)&mt[j]);                            \
+        __m256i z = _mm256_or_si256(_mm256_and_si256(x, upper), _mm256_and_si256(y, lower)); \
+        __m256i a = _mm256_and_si256(_mm256_sub_epi64(_mm256_setzero_si256(), _mm256_and_si256(y, one)), matrix); \
+        _mm256_store_si256((__m256i *)&mt[i], _mm256_xor_si256(_mm256_xor_si256(m, _mm256_srli_epi64(z, 1)), a)); \
+    }
+    for (i = 0; i + 4 <= MT64_N - MT64_M; i += 4)
+        MT64_TWIST_AVX2(i, i + MT64_M);
+    for (; i + 4 <= MT64_N - 1; i += 4)
+        MT64_TWIST_AVX2(i, i + MT64_M - MT64_N);
+#undef MT64_TWIST_AVX2
+    mt64_twist_range(mt, i, MT64_N);
+}
+
+__attribute__((target("avx2")))
+static void mt64_temper_avx2(const uint64_t *mt, uint64_t *out, size_t n)
+{
+    const __m256i t1 = _mm256_set1_epi64x(0x5555555555555555LL);
+    const __m256i t2 = _mm256_set1_epi64x(0x71D67FFFEDA60000LL);
+    const __m256i t3 = _mm256_set1_epi64x((long long)0xFFF7EEE000000000ULL);
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m256i y = _mm256_loadu_si256((const __m256i *)&mt[i]);
+        y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_srli_epi64(y, 29), t1));
+        y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_slli_epi64(y, 17), t2));
+        y = _mm256_xor_si256(y, _mm256_and_si256(_mm256_slli_epi64(y, 37), t3));
+        y = _mm256_xor_si256(y, _mm256_srli_epi64(y, 43));
+        _mm256_storeu_si256((__m256i *)&out[i], y);
+    }
+    mt64_temper_scalar(mt + i, out + i, n - i);
+}
+
+static const mt64_impl_t mt64_impl_avx2 = { mt64_twist_avx2, mt64_temper_avx2, "AVX2" };
+#endif
+
+static const mt64_impl_t *mt64_impl = NULL;
+
+static const mt64_impl_t *mt64_select(void)
+{
+    const mt64_impl_t *impl = &mt64_impl_scalar;
+
+#if defined(HAVE_SSE2)
+    impl = &mt64_impl_sse2;
+#endif
+#if defined(MT64_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        impl = &mt64_impl_avx2;
+#endif
+    __atomic_store_n(&mt64_impl, impl, __ATOMIC_RELEASE);
+    return impl;
+}
+
+static const mt64_impl_t *mt64_get_impl(void)
+{
+    const mt64_impl_t *impl = __atomic_load_n(&mt64_impl, __ATOMIC_ACQUIRE);
+    if (impl == NULL)
+        impl = mt64_select();
+    return impl;
+}
+
+/*!
+ * \brief the rest of the state first, then whole states tempered straight
+ *        into the array
+ */
+static void mt64_fill_array64_impl(mt64_t *m, uint64_t *array, size_t size, const mt64_impl_t *impl)
+{
+    while (size > 0) {
+        if (m->idx >= MT64_N) {
+            impl->twist(m->mt);
+            m->idx = 0;
+        }
+        size_t n = (size_t)(MT64_N - m->idx);
+        if (n > size)
+            n = size;
+        impl->temper(m->mt + m->idx, array, n);
+        m->idx += (int)n;
+        array += n;
+        size -= n;
+    }
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+void mt64_init(mt64_t *m, uint64_t seed)
+{
+    m->mt[0] = seed;
+    for (int i = 1; i < MT64_N; i++)
+        m->mt[i] = 6364136223846793005ULL * (m->mt[i - 1] ^ (m->mt[i - 1] >> 62)) + (uint64_t)i;
+    m->idx = MT64_N;
+}
+
+uint64_t mt64_genrand(mt64_t *m)
+{
+    if (m->idx >= MT64_N) {
+        mt64_get_impl()->twist(m->mt);
+        m->idx = 0;
+    }
+    return mt64_temper_word(m->mt[m->idx++]);
+}
+
+void mt64_fill_array64(mt64_t *m, uint64_t *array, size_t size)
+{
+    mt64_fill_array64_impl(m, array, size, mt64_get_impl());
+}
+
+void mt64_fill_array64_scalar(mt64_t *m, uint64_t *array, size_t size)
+{
+    mt64_fill_array64_impl(m, array, size, &mt64_impl_scalar);
+}
+
+const char *mt64_isa(void)
+{
+    return mt64_get_impl()->isa;
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _MT64_H_
+#define _MT64_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def MT64_N
+ *    State words of MT19937-64, 2.5 KB like SFMT19937.
+ */
+#define MT64_N              312
+#define MT64_M              156
+
+/*!
+ *  \brief MT19937-64 (Nishimura and Matsumoto, 2000), the engine of
+ *         std::mt19937_64, with the whole state regenerated at once like
+ *         the reference code, so the twist and the tempering can be done
+ *         several words per instruction.
+ */
+typedef struct
+{
+    alignas(32) uint64_t mt[MT64_N];
+    int         idx;            //!< next word of mt to output, MT64_N if used up
+} mt64_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Seed as std::mt19937_64(seed), the default of it is 5489.
+ */
+void mt64_init(mt64_t *m, uint64_t seed);
+
+/*!
+ * \brief The next number, the same as operator() of std::mt19937_64.
+ */
+uint64_t mt64_genrand(mt64_t *m);
+
+/*!
+ * \brief Fill \a array with the next \a size numbers, the same sequence as
+ *       mt64_genrand and std::mt19937_64, so the two can be mixed. The
+ *       twist and the tempering run 4 words per AVX2 instruction or 2 per
+ *       SSE2 instruction, the best the CPU has.
+ */
+void mt64_fill_array64(mt64_t *m, uint64_t *array, size_t size);
+
+/*!
+ * \brief Same numbers as mt64_fill_array64, one word at a time, the
+ *       reference of the SIMD paths.
+ */
+void mt64_fill_array64_scalar(mt64_t *m, uint64_t *array, size_t size);
+
+/*!
+ * \brief Name of the instruction set mt64_fill_array64 uses.
+ */
+const char *mt64_isa(void);
+
+#endif//_MT64_H_
@@ -20,6 +20,14 @@
 #   include <string.h>
 #   include <stdarg.h>
 #	include <errno.h>
+#   include <limits.h>
+#   include <sched.h>
+#   include <sys/resource.h>
+
+#if defined(__linux__)
+#   include <linux/futex.h>
+#   include <sys/syscall.h>
+#endif
 
 /*------------------------------------------------------------------
  * Module includes
@@ -42,7 +50,7 @@
  */
 typedef struct {
 	const char *name;   //!< thread name
-	int priority;       //!< thread priority : 99 <-> highest, 1 <-> lowest in Linux
+	thread_sched_t sched; //!< policy, priority, nice and cpu, applied when it starts
 
 	OSTYPE_THREAD id;   //!< thread id
 	thread_entry_t *entryPoint; //!< thread entry point function
@@ -50,17 +58,17 @@ typedef struct {
 } map_thread_t;
 
 /*! 
- * \brief A global variable to save the list of all threads name and priority
+ * \brief A global variable to save the list of all threads name and scheduling
  */
 static map_thread_t thread_array[THREAD_ID_MAX] = {
-        {"worker1",  0, UNDEF, NULL},
-        {"worker2",  0, UNDEF, NULL},
-        {"worker3",  0, UNDEF, NULL},
-        {"worker4",  0, UNDEF, NULL},
-        {"worker5",  0, UNDEF, NULL},
-        {"worker6",  0, UNDEF, NULL},
-        {"worker7",  0, UNDEF, NULL},
-        {"worker8",  0, UNDEF, NULL}
+        {"worker1",  THREAD_SCHED_DEFAULT, UNDEF, NULL},
+        {"worker2",  THREAD_SCHED_DEFAULT, UNDEF, NULL},
+        {"worker3",  THREAD_SCHED_DEFAULT, UNDEF, NULL},
+        {"worker4",  THREAD_SCHED_DEFAULT, UNDEF, NULL},
+        {"worker5",  THREAD_SCHED_DEFAULT, UNDEF, NULL},
+        {"worker6",  THREAD_SCHED_DEFAULT, UNDEF, NULL},
+        {"worker7",  THREAD_SCHED_DEFAULT, UNDEF, NULL},
+        {"worker8",  THREAD_SCHED_DEFAULT, UNDEF, NULL}
 };
 
 /*------------------------------------------------------------------
@@ -95,55 +103,207 @@ static map_queue_t msgQ_array[QUEUE_ID_MAX] = {
         {"manager", QUEUE_ID_manager}   ,
 };
 
+/*!
+ * \def MSGQ_RING_SLOTS
+ *    Messages of one in-process queue, power of 2. The kernel queue
+ *    holds about 400 of them with the default msgmnb.
+ */
+#define MSGQ_RING_SLOTS     4096
+
+/*!
+ *  \brief One message of a ring and the turn it's for: slot i is free
+ *         for the send number i when seq == i, and holds its message for
+ *         the receive number i when seq == i+1.
+ */
+typedef struct {
+	uint64_t seq;
+	msg_t msg;
+} msgQ_cell_t;
+
+/*!
+ *  \brief In-process multi producer multi consumer queue (D. Vyukov's
+ *         bounded queue). A receiver with nothing to take sleeps on the
+ *         futex word \a signal, bumped by a send which sees waiters.
+ */
+typedef struct {
+	alignas(64) uint64_t enqueuePos;
+	alignas(64) uint64_t dequeuePos;
+	alignas(64) uint32_t signal;
+	uint32_t waiters;
+	msgQ_cell_t cells[MSGQ_RING_SLOTS];
+} msgQ_ring_t;
+
+#if defined(MSGQ_SYSV)
+static msgQ_backend_t msgQ_backend = MSGQ_BACKEND_SYSV;
+#else
+static msgQ_backend_t msgQ_backend = MSGQ_BACKEND_FUTEX;
+#endif
+
+static msgQ_ring_t msgQ_ring[QUEUE_ID_MAX];
+static bool msgQ_opened = false;
+
 /*------------------------------------------------------------------
  * Module Internal functions Definitions
  *------------------------------------------------------------------*/
 
 /*! 
- * \brief Set Thread Priority
+ * \brief Apply a scheduling profile to the calling thread: the policy
+ *        and its priority, the nice level (per thread on Linux) and the
+ *        cpu. Each failure is logged, the others are still applied.
  * 
  * \param filename  : source file name in which this function is called
  * \param linenum   : source file line number in which this function is called
- * \param pattr     : thread attribute
- * \param priority  : thread priority : 99 <-> highest, 1 <-> lowest in Linux
+ * \param name      : thread name for the log
+ * \param sched     : scheduling profile
  * 
  * \return int
- *          - positive  : successful
- *          - others    : failure
+ *          - 0       : successful
+ *          - others  : number of the settings which failed
  */
-static int set_thread_priority(const char *filename, int linenum,
-		pthread_attr_t *pattr, int priority) {
-	struct sched_param sched;
-	int rs;
-	int newpriority = 0;
-	//int oldpriority;
+static int set_thread_sched(const char *filename, int linenum,
+		const char *name, const thread_sched_t *sched) {
+	struct sched_param param;
+	int rs, failed = 0;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = sched->priority;
+	if ((sched->policy != SCHED_OTHER) || (sched->priority != 0)) {
+		rs = pthread_setschedparam(pthread_self(), sched->policy, &param);
+		if (rs != 0) {
+			__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
+					"thread %s: policy %d priority %d failed. %s\n",
+					name, sched->policy, sched->priority, strerror(rs));
+			failed++;
+		}
+	}
 
-	rs = pthread_attr_getschedparam(pattr, &sched);
-	if (rs != 0) {
+#if defined(__linux__)
+	if ((sched->nice != 0)
+			&& (0 != setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), sched->nice))) {
 		__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
-				"pthread_attr_getschedparam failed");
-		return -1;
+				"thread %s: nice %d failed. %s\n", name, sched->nice, strerror(errno));
+		failed++;
 	}
 
-	//oldpriority = sched.__sched_priority;
-	sched.sched_priority = priority;
+	if (sched->cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(sched->cpu, &cpus);
+		rs = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (rs != 0) {
+			__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
+					"thread %s: cpu %d failed. %s\n", name, sched->cpu, strerror(rs));
+			failed++;
+		}
+	}
+#endif
 
-	rs = pthread_attr_setschedparam(pattr, &sched);
-	if (rs != 0) {
-		__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
-				"pthread_attr_setschedparam failedv");
-		return -2;
+	return failed;
+}
+
+/*!
+ * \brief Start routine of the named threads, the profile is applied by
+ *        the thread itself so a refused one doesn't stop its creation.
+ */
+static void *thread_entry(void *p) {
+	map_thread_t *thread = (map_thread_t *) p;
+
+	set_thread_sched(__FILE__, __LINE__, thread->name, &thread->sched);
+	thread->entryPoint();
+	return NULL;
+}
+
+static void msgQ_ring_reset(msgQ_ring_t *ring) {
+	for (uint64_t i = 0; i < MSGQ_RING_SLOTS; i++)
+		ring->cells[i].seq = i;
+	ring->enqueuePos = 0;
+	ring->dequeuePos = 0;
+	ring->signal = 0;
+	ring->waiters = 0;
+}
+
+/*!
+ * \brief claim the enqueue position of a free slot, fill it and hand it
+ *        to the receivers, then wake one if any is sleeping.
+ *
+ * \return int
+ *          - 0       : Success
+ *          - others  : the queue is full
+ */
+static int msgQ_ring_send(msgQ_ring_t *ring, const msg_t *msg) {
+	uint64_t pos = __atomic_load_n(&ring->enqueuePos, __ATOMIC_RELAXED);
+	msgQ_cell_t *cell;
+
+	for (;;) {
+		cell = &ring->cells[pos & (MSGQ_RING_SLOTS - 1)];
+		int64_t diff = (int64_t) __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (int64_t) pos;
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ring->enqueuePos, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return -1;
+		} else {
+			pos = __atomic_load_n(&ring->enqueuePos, __ATOMIC_RELAXED);
+		}
+	}
+	cell->msg = *msg;
+	__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+	// pairs with the fence of a receiver going to sleep: either it sees
+	// this message, or this sees it waiting
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->waiters, __ATOMIC_RELAXED) != 0) {
+		__atomic_add_fetch(&ring->signal, 1, __ATOMIC_RELEASE);
+		futex_wake(&ring->signal, 1, false);
 	}
+	return 0;
+}
 
-	rs = pthread_attr_getschedparam(pattr, &sched);
-	if (rs != 0) {
-		__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
-				"pthread_attr_getschedparam failed");
-		return -3;
+/*!
+ * \return int
+ *          - 0       : got a message
+ *          - others  : the queue is empty
+ */
+static int msgQ_ring_take(msgQ_ring_t *ring, msg_t *msg) {
+	uint64_t pos = __atomic_load_n(&ring->dequeuePos, __ATOMIC_RELAXED);
+	msgQ_cell_t *cell;
+
+	for (;;) {
+		cell = &ring->cells[pos & (MSGQ_RING_SLOTS - 1)];
+		int64_t diff = (int64_t) __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (int64_t) (pos + 1);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ring->dequeuePos, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return 1;
+		} else {
+			pos = __atomic_load_n(&ring->dequeuePos, __ATOMIC_RELAXED);
+		}
 	}
-	newpriority = sched.sched_priority;
+	*msg = cell->msg;
+	__atomic_store_n(&cell->seq, pos + MSGQ_RING_SLOTS, __ATOMIC_RELEASE);
+	return 0;
+}
 
-	return newpriority;
+static int msgQ_ring_recv(msgQ_ring_t *ring, msg_t *msg, bool nowait) {
+	if (0 == msgQ_ring_take(ring, msg))
+		return 0;
+	if (nowait)
+		return 1;
+
+	for (;;) {
+		__atomic_add_fetch(&ring->waiters, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		uint32_t signal = __atomic_load_n(&ring->signal, __ATOMIC_ACQUIRE);
+		int empty = msgQ_ring_take(ring, msg);
+		if (empty)
+			futex_wait(&ring->signal, signal, false, 0);
+		__atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_RELAXED);
+		if (!empty || (0 == msgQ_ring_take(ring, msg)))
+			return 0;
+	}
 }
 
 /*------------------------------------------------------------------
@@ -152,7 +312,8 @@ static int set_thread_priority(const char *filename, int linenum,
 
 /*! 
  * \brief OS Wrapper Layer Initialzation
- * Create one general system message queue and enable thread cancelable
+ * Create one general system message queue, or empty the in-process ones,
+ * and enable thread cancelable
  * 
  * \return int
  *          - 0     : successful
@@ -161,16 +322,22 @@ static int set_thread_priority(const char *filename, int linenum,
 int oswrapper_init(void) {
 	/* message queue creation */
 
-	int msgQid;
+	if (MSGQ_BACKEND_SYSV == msgQ_backend) {
+		int msgQid;
 
-	msgQid = msgget(IPC_PRIVATE, (IPC_CREAT | IPC_EXCL | 0666));
-	if (msgQid < 0) {
-		syslog(LM_OSWRAP, LOG_FATAL, "Message Queue creation failed\n");
-		return -1;
-	}
+		msgQid = msgget(IPC_PRIVATE, (IPC_CREAT | IPC_EXCL | 0666));
+		if (msgQid < 0) {
+			syslog(LM_OSWRAP, LOG_FATAL, "Message Queue creation failed\n");
+			return -1;
+		}
 
-	/* Save it into global variable */
-	msgQ_id = msgQid;
+		/* Save it into global variable */
+		msgQ_id = msgQid;
+	} else {
+		for (int q = 0; q < QUEUE_ID_MAX; q++)
+			msgQ_ring_reset(&msgQ_ring[q]);
+	}
+	msgQ_opened = true;
 
 	/* thread attribute */
 
@@ -196,6 +363,7 @@ void oswrapper_term(void) {
 		}
 		msgQ_id = UNDEF;
 	}
+	msgQ_opened = false;
 
 	return;
 }
@@ -225,18 +393,13 @@ int _thread_create(const char *filename, int linenum, thread_id_t id,
 		return -1;
 	}
 
-	if (thread_array[id].priority > 0) {
-		set_thread_priority(filename, linenum, &attr,
-				thread_array[id].priority);
-	}
-
+	thread_array[id].entryPoint = entry;
 	r = pthread_create((pthread_t *) &thread_array[id].id, &attr,
-			(void *(*)(void *))entry, NULL);
+			thread_entry, &thread_array[id]);
 	if (r != 0) {
 		__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
 				"thread creation failed");
-	} else {
-		thread_array[id].entryPoint = entry;
+		thread_array[id].entryPoint = NULL;
 	}
 
 	rs = pthread_attr_destroy(&attr);
@@ -280,6 +443,22 @@ int _thread_delete(const char *filename, int linenum, thread_id_t id) {
 	return ret;
 }
 
+int _thread_set_sched(const char *filename, int linenum, thread_id_t id,
+		const thread_sched_t *sched) {
+	if ((id < 0) || (id >= THREAD_ID_MAX)) {
+		__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
+				"thread ID out of range\n");
+		return -1;
+	}
+	thread_array[id].sched = *sched;
+	return 0;
+}
+
+int _thread_self_sched(const char *filename, int linenum, const char *name,
+		const thread_sched_t *sched) {
+	return set_thread_sched(filename, linenum, name, sched);
+}
+
 const char* get_thread_name(thread_id_t id) {
     static const char unknown_thread[] = "unkown";
     if ((id >=0 ) && (id<THREAD_ID_MAX)){
@@ -290,6 +469,74 @@ const char* get_thread_name(thread_id_t id) {
     }
 }
 
+/*!
+ *  \brief Argument of one parallel job thread.
+ */
+typedef struct {
+	int worker;         //!< job index
+	thread_job_t *job;  //!< job function
+	void *arg;          //!< job argument
+} parallel_job_t;
+
+static void *parallel_job_entry(void *p) {
+	parallel_job_t *pjob = (parallel_job_t *) p;
+	pjob->job(pjob->worker, pjob->arg);
+	return NULL;
+}
+
+/*! 
+ * \brief run one job on several anonymous threads and wait for them
+ * 
+ * \param filename  : source file name in which this function is called
+ * \param linenum   : source file line number in which this function is called
+ * \param workers   : number of threads, each one runs job(worker, arg)
+ * \param job       : Job Function
+ * \param arg       : Job Argument, shared by all the threads
+ * 
+ * \return int
+ *          - 0     : successful
+ *          - others: failure, the jobs failed to start are run in caller thread
+ */
+int _thread_parallel(const char *filename, int linenum, int workers,
+		thread_job_t job, void *arg) {
+	int i, ret = 0;
+
+	if (workers <= 0) {
+		__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
+				"parallel workers out of range\n");
+		return -1;
+	}
+
+	pthread_t *tids = new pthread_t[workers];
+	bool *started = new bool[workers];
+	parallel_job_t *jobs = new parallel_job_t[workers];
+
+	for (i = 0; i < workers; i++) {
+		jobs[i].worker = i;
+		jobs[i].job = job;
+		jobs[i].arg = arg;
+		started[i] = (0 == pthread_create(&tids[i], NULL,
+				parallel_job_entry, &jobs[i]));
+		if (!started[i]) {
+			__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
+					"parallel thread creation failed\n");
+			ret = -2;
+		}
+	}
+
+	for (i = 0; i < workers; i++) {
+		if (started[i])
+			pthread_join(tids[i], NULL);
+		else
+			parallel_job_entry(&jobs[i]);
+	}
+
+	delete[] jobs;
+	delete[] started;
+	delete[] tids;
+	return ret;
+}
+
 /*! 
  * \brief send message to message queue
  * 
@@ -315,6 +562,15 @@ int _msgQ_send(const char *filename, int linenum, msgQ_id_t id, msg_t msg) {
 				"Queue ID out of range");
 		return -1;
 	}
+	if (MSGQ_BACKEND_FUTEX == msgQ_backend) {
+		if (0 != msgQ_ring_send(&msgQ_ring[id], &msg)) {
+			__syslog(filename, linenum, LM_OSWRAP, LOG_ERROR,
+					"Message send failure. queue %s is full\n", msgQ_array[id].name);
+			return -2;
+		}
+		return 0;
+	}
+
 	msqid = msgQ_array[id].id;
 
 	themsg.mtype = msqid;
@@ -359,6 +615,9 @@ int _msgQ_recv(const char *filename, int linenum, msgQ_id_t id, msg_t *ptr_msg,
 		return -1;
 	}
 
+	if (MSGQ_BACKEND_FUTEX == msgQ_backend)
+		return msgQ_ring_recv(&msgQ_ring[id], ptr_msg, nowait);
+
 	if (nowait) {
 		msgflg = IPC_NOWAIT;
 	} else {
@@ -387,23 +646,49 @@ int _msgQ_recv(const char *filename, int linenum, msgQ_id_t id, msg_t *ptr_msg,
 	}
 }
 
-void __syslog(const char* full_name, int line_num, unsigned int flux,
-		unsigned int grav, const char *format, ...) {
-	va_list args;
-
-	/*--- please use any available syslog module to replace this printf logs ---*/
-
-	//--- the simple printf logs ---
+int msgQ_set_backend(msgQ_backend_t backend) {
+	if (msgQ_opened || (backend < MSGQ_BACKEND_SYSV) || (backend > MSGQ_BACKEND_FUTEX)) {
+		syslog(LM_OSWRAP, LOG_ERROR, "message queue backend can't be changed now\n");
+		return -1;
+	}
+	msgQ_backend = backend;
+	return 0;
+}
 
-//	if ((full_name != NULL) && (line_num != 0))
-//		printf("%-12s:%4d ", full_name, line_num);
-//	else if (full_name != NULL)
-//		printf("%-12s ", full_name);
+msgQ_backend_t msgQ_get_backend(void) {
+	return msgQ_backend;
+}
 
-	va_start(args, format);
-	vprintf(format, args);
-	va_end(args);
+int futex_wait(uint32_t *addr, uint32_t val, bool shared, int timeoutMs) {
+	struct timespec ts;
+
+	ts.tv_sec = timeoutMs / 1000;
+	ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+
+#if defined(__linux__)
+	return (int) syscall(SYS_futex, addr,
+			shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, val,
+			(timeoutMs > 0) ? &ts : NULL, NULL, 0);
+#else
+	if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != val)
+		return 0;
+	if ((timeoutMs == 0) || (timeoutMs > 1)) {
+		ts.tv_sec = 0;
+		ts.tv_nsec = 1000000L;  // poll every 1ms
+	}
+	nanosleep(&ts, NULL);
+	return 0;
+#endif
+}
 
-	return;
+void futex_wake(uint32_t *addr, int count, bool shared) {
+#if defined(__linux__)
+	syscall(SYS_futex, addr, shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,
+			(count > 0) ? count : INT_MAX, NULL, NULL, 0);
+#else
+	(void) addr;
+	(void) count;
+	(void) shared;
+#endif
 }
 
@@ -6,6 +6,8 @@
 #ifndef _OS_WRAPPER_H_
 #define _OS_WRAPPER_H_
 
+#include <stdint.h>
+
 #ifndef FALSE
 #define FALSE   false
 #endif
@@ -52,6 +54,8 @@ typedef struct
     msg_opcode_t primitiveCode;     //!< Message Opcode
     uint64_t     shortmsg;  	 	    //!< Short message
     uint64_t     payload;           //!< Short message payload
+    uint64_t     stamp;             //!< Logical time of the message, 0 if not used
+    uint32_t     source;            //!< Logical source of the message, 0 if not used
     
 } S_PRIMITIVE;
 
@@ -75,11 +79,30 @@ typedef enum {
     THREAD_ID_MAX		 //!< Thread Number
 } thread_id_t;
 
+/*!
+ *  \brief Scheduling profile of a thread, applied by the thread when it
+ *         starts.
+ */
+typedef struct {
+    int policy;         //!< SCHED_OTHER, SCHED_BATCH, SCHED_FIFO or SCHED_RR
+    int priority;       //!< 1 (lowest) .. 99 (highest) for SCHED_FIFO and SCHED_RR, else 0
+    int nice;           //!< -20 .. 19, for SCHED_OTHER and SCHED_BATCH
+    int cpu;            //!< the only cpu it runs on, -1 to let the OS place it
+} thread_sched_t;
+
+#define THREAD_SCHED_DEFAULT    {0 /*SCHED_OTHER*/, 0, 0, -1}
+
 /*!
  * Creates a type name for thread entry point function type
  */
 typedef void thread_entry_t(void);
 
+/*!
+ * Creates a type name for parallel job function type,
+ * \a worker is the job index in [0..workers-1]
+ */
+typedef void thread_job_t(int worker, void *arg);
+
 /*------------------------------------------------------------------
   Queues
   ------------------------------------------------------------------*/
@@ -95,6 +118,16 @@ typedef enum {
     QUEUE_ID_MAX
 } msgQ_id_t;
 
+/*!
+ * \enum msgQ_backend_t
+ * Where the messages go, chosen at build time by 'make msgq=sysv' or
+ * 'make msgq=futex' (default)
+ */
+typedef enum {
+    MSGQ_BACKEND_SYSV,  /*!< one kernel SysV queue, the queue id as mtype */
+    MSGQ_BACKEND_FUTEX, /*!< in-process lock free rings, futex to block */
+} msgQ_backend_t;
+
 /*! Creates a type msg_t name for S_PRIMITIVE */ 
 typedef S_PRIMITIVE msg_t;
 
@@ -129,6 +162,32 @@ void    oswrapper_term  (void);
 
  const char* get_thread_name(thread_id_t id);
 
+/*!
+ * \def thread_set_sched(id,sched)
+ *  Scheduling profile of thread \a id, for the next thread_create of it.
+ * \def thread_self_sched(name,sched)
+ *  Apply a scheduling profile to the calling thread now.
+ *  A setting the OS refuses (no CAP_SYS_NICE for SCHED_FIFO for example)
+ *  is logged, and the thread runs without it.
+ */
+#define thread_set_sched(id,sched)      _thread_set_sched(__FILE__, __LINE__, id, sched)
+#define thread_self_sched(name,sched)   _thread_self_sched(__FILE__, __LINE__, name, sched)
+
+ int _thread_set_sched(const char *filename, int linenum,
+         thread_id_t id, const thread_sched_t *sched);
+
+ int _thread_self_sched(const char *filename, int linenum,
+         const char *name, const thread_sched_t *sched);
+
+/*!
+ * \def thread_parallel(workers,job,arg)
+ *  Run \a job on \a workers anonymous threads and wait for all of them.
+ */
+#define thread_parallel(workers,job,arg) _thread_parallel(__FILE__, __LINE__, workers, job, arg)
+
+ int _thread_parallel(const char *filename, int linenum,
+         int workers, thread_job_t job, void *arg);
+
 /*------------------------------------------------------------------
  * Message Queue
  *------------------------------------------------------------------*/
@@ -157,6 +216,38 @@ void    oswrapper_term  (void);
    bool		            nowait
 );
 
+/*!
+ * \brief Use the other backend, only while no queue is open (before
+ *       oswrapper_init or after oswrapper_term), for the benchmark.
+ * \return int - 0 : successful
+ */
+ int    msgQ_set_backend(msgQ_backend_t backend);
+ msgQ_backend_t msgQ_get_backend(void);
+
+
+/*------------------------------------------------------------------
+ * Futex
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Wait while *addr == val, until woken up or timeout.
+ *        Falls back to a short sleep on the OS without futex.
+ *
+ * \param addr      : the 32-bit futex word
+ * \param val       : the value expected in futex word
+ * \param shared    : true if futex word is in memory shared by processes
+ * \param timeoutMs : timeout in milliseconds, 0 for waiting forever
+ *
+ * \return int
+ *          - 0     : woken up, or *addr != val already
+ *          - others: timeout or interrupted
+ */
+ int    futex_wait(uint32_t *addr, uint32_t val, bool shared, int timeoutMs);
+
+/*!
+ * \brief Wake up at most \a count waiters of futex word \a addr.
+ */
+ void   futex_wake(uint32_t *addr, int count, bool shared);
 
 /*------------------------------------------------------------------
  * Syslog 
@@ -193,7 +284,11 @@ typedef enum {
 /*! 
  * \brief syslog wrapper function.
  *       outputs the specified string to the specified destination flow.
- *       - if enabled, a timestamp is added
+ *       - records under the level of the module are dropped first
+ *       - once syslog_start() is called, the format and the arguments are
+ *         copied into a lock free ring of the calling thread, and formatted
+ *         and written by the flusher thread in the order of the calls;
+ *         before it, or if the record can't be queued, it's written inline
  *       - the output buffer length is limited to SYSLOG_OUTPUT_BUFFER_LEN
  * 
  * \param full_name : source file name in which this function is called
@@ -206,6 +301,40 @@ typedef enum {
  void __syslog(const char* full_name, int line_num,
              unsigned int flux, unsigned int grav, const char *format, ...);
 
+/*!
+ * \brief Start the flusher thread of the asynchronous syslog. The records
+ *       left are written by syslog_stop(), which is also called at exit.
+ * \return int - 0 : successful
+ */
+ int    syslog_start(void);
+ void   syslog_stop(void);
+
+/*!
+ * \brief Write every record queued so far, on the calling thread.
+ */
+ void   syslog_flush(void);
+
+/*!
+ * \brief Drop the records of module \a flux under level \a grav.
+ *       syslog_set_levels() takes "level" for all modules, or a list of
+ *       "module=level" (oswrap, rand, debug) split by ','.
+ * \return int - 0 : successful
+ */
+ void   syslog_set_level(unsigned int flux, unsigned int grav);
+ int    syslog_set_levels(const char *spec);
+
+/*!
+ * \brief Overflow policy of a full ring: records of level \a grav and
+ *       above are written inline (the caller waits), lower ones are
+ *       dropped and counted. LOG_ERROR by default.
+ */
+ void   syslog_set_overflow(unsigned int grav);
+
+/*!
+ * \brief Records written by the flusher, and the dropped ones.
+ */
+ void   syslog_get_stat(uint64_t *records, uint64_t *dropped);
+
 #define SRCFILE (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
 #define syslog(...)  	__syslog(SRCFILE, __LINE__, ##__VA_ARGS__)
 
@@ -220,11 +349,23 @@ typedef enum {
 #define msgS_data(m)    		((m).shortmsg)
 #define msgS_payload(m)      ((m).payload)
 
+#define msgS_stamp(m)        ((m).stamp)
+#define msgS_source(m)       ((m).source)
+
 #define msgS_allocate(msg, opcode, short_msg, short_payload)	\
 {										\
 	msg.primitiveCode = opcode;			\
 	msg.shortmsg = short_msg;           \
     msg.payload = short_payload;        \
+    msg.stamp = 0;                      \
+    msg.source = 0;                     \
+}
+
+#define msgS_allocate_stamped(msg, opcode, short_msg, short_payload, short_stamp, short_source)	\
+{										\
+	msgS_allocate(msg, opcode, short_msg, short_payload);  \
+    msg.stamp = short_stamp;            \
+    msg.source = short_source;          \
 }
 
 #define msgQ_create(queue_id)
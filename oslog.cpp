@@ -0,0 +1,613 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "os_wrapper.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def SYSLOG_RECORD_BYTES
+ *    One ring slot. A record is the format pointer and the arguments
+ *    copied in binary, or the formatted text when the format has a
+ *    conversion the record can't carry.
+ */
+#define SYSLOG_RECORD_BYTES     256
+#define SYSLOG_RING_SLOTS       1024    // per thread, power of 2, 256 KB
+#define SYSLOG_RINGS            64      // threads with a ring, the others write inline
+#define SYSLOG_FLUSH_MS         10      // the flusher's poll when nobody wakes it
+#define SYSLOG_OUTPUT_BUFFER_LEN 1024   // one formatted record, longer ones are cut
+#define SYSLOG_SPEC_LEN         32
+
+typedef struct {
+    uint64_t    seq;            //!< global order of the records
+    const char *format;         //!< NULL for a text record
+    uint16_t    flux;
+    uint16_t    grav;
+    uint16_t    size;           //!< bytes of data used
+    uint16_t    reserved;
+    uint8_t     data[SYSLOG_RECORD_BYTES - 24];
+} syslog_record_t;
+
+/*!
+ *  \brief Single producer (the owner thread) single consumer (whoever
+ *         holds the drain lock) ring.
+ */
+typedef struct {
+    alignas(64) uint64_t head;      //!< written by the owner, release
+    alignas(64) uint64_t tail;      //!< written by the consumer, release
+    uint64_t    dropped;            //!< by the owner, relaxed
+    uint64_t    reported;           //!< drops already reported, consumer only
+    bool        inUse;              //!< owned by a live thread
+    syslog_record_t slots[SYSLOG_RING_SLOTS];
+} syslog_ring_t;
+
+/*!
+ *  \brief argument classes of a printf conversion
+ */
+typedef enum {
+    SPEC_PERCENT,
+    SPEC_INT,
+    SPEC_LONG,
+    SPEC_LLONG,
+    SPEC_SIZE,
+    SPEC_INTMAX,
+    SPEC_PTRDIFF,
+    SPEC_DOUBLE,
+    SPEC_STRING,
+    SPEC_POINTER,
+    SPEC_BAD,
+} syslog_spec_t;
+
+/*------------------------------------------------------------------
+ * Module Variables Definitions
+ *------------------------------------------------------------------*/
+
+static uint8_t          logLevel[LM_SIZE] = { LOG_DEBUG, LOG_DEBUG, LOG_DEBUG };
+static unsigned int     logOverflowInline = LOG_ERROR;  //!< these levels are written inline if the ring is full
+
+static syslog_ring_t   *logRings[SYSLOG_RINGS];
+static uint32_t         logRingCount = 0;               //!< published with release
+static std::mutex       logRingMutex;                   //!< registration only
+static thread_local syslog_ring_t *logRing = NULL;
+static thread_local bool logNoRing = false;
+
+/*!
+ *  \brief gives the ring of a thread back at the thread exit, the next
+ *         thread takes it once the flusher has emptied it
+ */
+struct syslog_ring_owner_t {
+    ~syslog_ring_owner_t() {
+        if (logRing != NULL)
+            __atomic_store_n(&logRing->inUse, false, __ATOMIC_RELEASE);
+    }
+};
+static thread_local syslog_ring_owner_t logRingOwner;
+
+static uint64_t         logSeq = 0;
+static uint64_t         logNext = 0;                    //!< seq of the next record to write, consumer only
+static uint64_t         logRecords = 0;                 //!< formatted by the consumer
+static bool             logRunning = false;
+static uint32_t         logWake = 0;                    //!< futex of the flusher
+static std::thread     *logFlusher = NULL;
+static std::mutex       logDrainMutex;                  //!< the consumer of all the rings, and stdout
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief one conversion at \a p (after the '%'), copied into \a spec
+ * \return the class of its argument, \a len the characters after '%'
+ */
+static syslog_spec_t syslog_spec(const char *p, char *spec, size_t *len)
+{
+    const char *q = p;
+    int         length = 0;     // 1 h, 2 hh, 3 l, 4 ll, 5 z, 6 j, 7 t
+    syslog_spec_t cls;
+
+    if (*q == '%') {
+        *len = 1;
+        return SPEC_PERCENT;
+    }
+    while ((*q != '\0') && (strchr("-+ #0'", *q) != NULL))
+        q++;
+    while ((*q >= '0') && (*q <= '9'))
+        q++;
+    if (*q == '.') {
+        q++;
+        while ((*q >= '0') && (*q <= '9'))
+            q++;
+    }
+    if (*q == 'h')       { length = 1; q++; if (*q == 'h') { length = 2; q++; } }
+    else if (*q == 'l')  { length = 3; q++; if (*q == 'l') { length = 4; q++; } }
+    else if (*q == 'q')  { length = 4; q++; }
+    else if (*q == 'z')  { length = 5; q++; }
+    else if (*q == 'j')  { length = 6; q++; }
+    else if (*q == 't')  { length = 7; q++; }
+
+    switch (*q) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            cls = (length == 3) ? SPEC_LONG : (length == 4) ? SPEC_LLONG : (length == 5) ? SPEC_SIZE :
+                  (length == 6) ? SPEC_INTMAX : (length == 7) ? SPEC_PTRDIFF : SPEC_INT;
+            break;
+        case 'c':
+            cls = (length == 0) ? SPEC_INT : SPEC_BAD;
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            cls = (length == 0) || (length == 3) ? SPEC_DOUBLE : SPEC_BAD;
+            break;
+        case 's':
+            cls = (length == 0) ? SPEC_STRING : SPEC_BAD;
+            break;
+        case 'p':
+            cls = SPEC_POINTER;
+            break;
+        default:                // '*' width, long double, %n, ...
+            return SPEC_BAD;
+    }
+    *len = (size_t)(q - p) + 1;
+    if (*len + 2 > SYSLOG_SPEC_LEN)
+        return SPEC_BAD;
+    spec[0] = '%';
+    memcpy(spec + 1, p, *len);
+    spec[*len + 1] = '\0';
+    return cls;
+}
+
+/*!
+ * \brief the arguments into the record, 8 bytes each, a string as its
+ *        length and its characters
+ * \return int - 0 : successful, others: the record can't carry them
+ */
+static int syslog_encode(syslog_record_t *rec, const char *format, va_list args)
+{
+    char        spec[SYSLOG_SPEC_LEN];
+    size_t      len, used = 0;
+    const char *p = format;
+
+    while ((p = strchr(p, '%')) != NULL) {
+        syslog_spec_t cls = syslog_spec(++p, spec, &len);
+        int64_t v = 0;
+        double  d;
+
+        p += (cls == SPEC_BAD) ? 0 : len;
+        switch (cls) {
+            case SPEC_PERCENT:  continue;
+            case SPEC_BAD:      return -1;
+            case SPEC_INT:      v = va_arg(args, int); break;
+            case SPEC_LONG:     v = va_arg(args, long); break;
+            case SPEC_LLONG:    v = va_arg(args, long long); break;
+            case SPEC_SIZE:     v = (int64_t)va_arg(args, size_t); break;
+            case SPEC_INTMAX:   v = (int64_t)va_arg(args, intmax_t); break;
+            case SPEC_PTRDIFF:  v = va_arg(args, ptrdiff_t); break;
+            case SPEC_POINTER:  v = (int64_t)(intptr_t)va_arg(args, void *); break;
+            case SPEC_DOUBLE:
+                d = va_arg(args, double);
+                memcpy(&v, &d, sizeof(v));
+                break;
+            case SPEC_STRING: {
+                const char *s = va_arg(args, const char *);
+                uint64_t    n;
+                if (s == NULL)
+                    s = "(null)";
+                n = strlen(s);
+                if (used + 8 + ((n + 8) & ~7ULL) > sizeof(rec->data))
+                    return -1;
+                memcpy(rec->data + used, &n, 8);
+                memcpy(rec->data + used + 8, s, n + 1);
+                used += 8 + ((n + 8) & ~7ULL);
+                continue;
+            }
+        }
+        if (used + 8 > sizeof(rec->data))
+            return -1;
+        memcpy(rec->data + used, &v, 8);
+        used += 8;
+    }
+    rec->format = format;
+    rec->size = (uint16_t)used;
+    return 0;
+}
+
+/*!
+ * \brief the record as text into \a out
+ * \return the characters written
+ */
+static size_t syslog_format(const syslog_record_t *rec, char *out, size_t room)
+{
+    char        spec[SYSLOG_SPEC_LEN];
+    size_t      len, pos = 0, used = 0;
+    const char *p, *q;
+
+    if (rec->format == NULL) {
+        len = strnlen((const char *)rec->data, rec->size);
+        if (len >= room)
+            len = room - 1;
+        memcpy(out, rec->data, len);
+        out[len] = '\0';
+        return len;
+    }
+
+    for (p = rec->format; (*p != '\0') && (pos + 1 < room); p = q) {
+        if (*p != '%') {
+            q = strchr(p, '%');
+            if (q == NULL)
+                q = p + strlen(p);
+            len = std::min((size_t)(q - p), room - 1 - pos);
+            memcpy(out + pos, p, len);
+            pos += len;
+            continue;
+        }
+
+        syslog_spec_t cls = syslog_spec(p + 1, spec, &len);
+        int64_t v = 0;
+        double  d;
+        int     n = 0;
+
+        q = p + 1 + len;
+        if (cls == SPEC_PERCENT) {
+            out[pos++] = '%';
+            continue;
+        }
+        if (cls == SPEC_STRING) {
+            n = snprintf(out + pos, room - pos, spec, (const char *)(rec->data + used + 8));
+            memcpy(&v, rec->data + used, 8);
+            used += 8 + (((size_t)v + 8) & ~7ULL);
+        }
+        else {
+            memcpy(&v, rec->data + used, 8);
+            used += 8;
+            switch (cls) {
+                case SPEC_INT:      n = snprintf(out + pos, room - pos, spec, (int)v); break;
+                case SPEC_LONG:     n = snprintf(out + pos, room - pos, spec, (long)v); break;
+                case SPEC_LLONG:    n = snprintf(out + pos, room - pos, spec, (long long)v); break;
+                case SPEC_SIZE:     n = snprintf(out + pos, room - pos, spec, (size_t)v); break;
+                case SPEC_INTMAX:   n = snprintf(out + pos, room - pos, spec, (intmax_t)v); break;
+                case SPEC_PTRDIFF:  n = snprintf(out + pos, room - pos, spec, (ptrdiff_t)v); break;
+                case SPEC_POINTER:  n = snprintf(out + pos, room - pos, spec, (void *)(intptr_t)v); break;
+                case SPEC_DOUBLE:
+                    memcpy(&d, &v, sizeof(d));
+                    n = snprintf(out + pos, room - pos, spec, d);
+                    break;
+                default: break;
+            }
+        }
+        if (n > 0)
+            pos = std::min(pos + (size_t)n, room - 1);
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+/*!
+ * \brief take the published records of every ring, format and write them
+ *        in the global order. Every seq is one record of a ring, so the
+ *        records after a seq not published yet, taken by a thread which
+ *        hasn't moved its head, are held back for the next drain. The
+ *        caller holds logDrainMutex.
+ */
+static void syslog_drain(void)
+{
+    typedef struct {
+        const syslog_record_t  *rec;
+        uint32_t                ring;
+    } syslog_batch_t;
+    static syslog_batch_t batch[SYSLOG_RINGS * SYSLOG_RING_SLOTS];
+    static uint64_t taken[SYSLOG_RINGS];
+    static char     out[SYSLOG_OUTPUT_BUFFER_LEN];
+    uint32_t rings = __atomic_load_n(&logRingCount, __ATOMIC_ACQUIRE);
+    size_t   n = 0;
+
+    for (uint32_t r = 0; r < rings; r++) {
+        syslog_ring_t *ring = logRings[r];
+        uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        taken[r] = 0;
+        for (uint64_t i = ring->tail; i < head; i++) {
+            batch[n].rec = &ring->slots[i & (SYSLOG_RING_SLOTS - 1)];
+            batch[n++].ring = r;
+        }
+        if (dropped != ring->reported) {
+            fprintf(stdout, "syslog: %" PRIu64 " records dropped, the log ring of a thread was full\n",
+                    dropped - ring->reported);
+            ring->reported = dropped;
+        }
+    }
+    if (n == 0)
+        return;
+
+    std::sort(batch, batch + n, [](const syslog_batch_t &a, const syslog_batch_t &b) {
+        return a.rec->seq < b.rec->seq;
+    });
+    // the seqs of a ring increase, so what is written is a prefix of each ring
+    size_t i;
+    for (i = 0; (i < n) && (batch[i].rec->seq == logNext); i++, logNext++) {
+        size_t len = syslog_format(batch[i].rec, out, sizeof(out));
+        fwrite(out, 1, len, stdout);
+        taken[batch[i].ring]++;
+    }
+    if (i == 0)
+        return;
+    fflush(stdout);
+    logRecords += i;
+
+    for (uint32_t r = 0; r < rings; r++)
+        __atomic_store_n(&logRings[r]->tail, logRings[r]->tail + taken[r], __ATOMIC_RELEASE);
+}
+
+static void syslog_flusher(void)
+{
+    while (__atomic_load_n(&logRunning, __ATOMIC_ACQUIRE)) {
+        uint32_t wake = __atomic_load_n(&logWake, __ATOMIC_ACQUIRE);
+        {
+            std::lock_guard<std::mutex> lock(logDrainMutex);
+            syslog_drain();
+        }
+        futex_wait(&logWake, wake, false, SYSLOG_FLUSH_MS);
+    }
+}
+
+/*!
+ * \brief the ring of this thread, registered at its first record
+ */
+static syslog_ring_t *syslog_ring(void)
+{
+    if ((logRing != NULL) || logNoRing)
+        return logRing;
+
+    std::lock_guard<std::mutex> lock(logRingMutex);
+    void *p = NULL;
+
+    (void)&logRingOwner;        // constructed on this thread, so destroyed at its exit
+    for (uint32_t r = 0; r < logRingCount; r++) {
+        syslog_ring_t *ring = logRings[r];
+        if (!__atomic_load_n(&ring->inUse, __ATOMIC_ACQUIRE)
+                && (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->head)) {
+            ring->inUse = true;
+            logRing = ring;
+            return logRing;
+        }
+    }
+    if ((logRingCount >= SYSLOG_RINGS) || (0 != posix_memalign(&p, 64, sizeof(syslog_ring_t)))) {
+        logNoRing = true;
+        return NULL;
+    }
+    logRing = (syslog_ring_t *)p;
+    memset(logRing, 0, sizeof(syslog_ring_t));
+    logRing->inUse = true;
+    logRings[logRingCount] = logRing;
+    __atomic_store_n(&logRingCount, logRingCount + 1, __ATOMIC_RELEASE);
+    return logRing;
+}
+
+/*!
+ * \brief the slow path: the records before this one first, then this one
+ *        formatted on the calling thread
+ */
+static void syslog_inline(const char *format, va_list args)
+{
+    std::lock_guard<std::mutex> lock(logDrainMutex);
+
+    syslog_drain();
+    vprintf(format, args);
+    fflush(stdout);
+}
+
+static void syslog_atexit(void)
+{
+    syslog_stop();
+}
+
+/*!
+ * \brief fork: no record is drained nor a ring registered while the
+ *        process is copied. Only the forking thread goes on in the child,
+ *        without the flusher, so it writes inline, and the records left
+ *        in the rings are the parent's to write.
+ */
+static void syslog_fork_prepare(void)
+{
+    logRingMutex.lock();
+    logDrainMutex.lock();
+    syslog_drain();
+}
+
+static void syslog_fork_parent(void)
+{
+    logDrainMutex.unlock();
+    logRingMutex.unlock();
+}
+
+static void syslog_fork_child(void)
+{
+    for (uint32_t r = 0; r < logRingCount; r++)
+        logRings[r]->tail = logRings[r]->head;
+    logNext = __atomic_load_n(&logSeq, __ATOMIC_RELAXED);
+    logFlusher = NULL;
+    logRunning = false;
+    logDrainMutex.unlock();
+    logRingMutex.unlock();
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int syslog_start(void)
+{
+    std::lock_guard<std::mutex> lock(logDrainMutex);
+    static bool registered = false;
+
+    if (logFlusher != NULL)
+        return 0;
+    __atomic_store_n(&logRunning, true, __ATOMIC_RELEASE);
+    logFlusher = new std::thread(syslog_flusher);
+    if (!registered) {
+        atexit(syslog_atexit);
+        pthread_atfork(syslog_fork_prepare, syslog_fork_parent, syslog_fork_child);
+        registered = true;
+    }
+    return 0;
+}
+
+void syslog_stop(void)
+{
+    std::thread *flusher;
+    {
+        std::lock_guard<std::mutex> lock(logDrainMutex);
+        flusher = logFlusher;
+        logFlusher = NULL;
+        __atomic_store_n(&logRunning, false, __ATOMIC_RELEASE);
+    }
+    if (flusher != NULL) {
+        __atomic_add_fetch(&logWake, 1, __ATOMIC_RELEASE);
+        futex_wake(&logWake, 1, false);
+        flusher->join();
+        delete flusher;
+    }
+    syslog_flush();
+}
+
+void syslog_flush(void)
+{
+    std::lock_guard<std::mutex> lock(logDrainMutex);
+    syslog_drain();
+}
+
+void syslog_set_level(unsigned int flux, unsigned int grav)
+{
+    if (flux < LM_SIZE)
+        __atomic_store_n(&logLevel[flux], (uint8_t)grav, __ATOMIC_RELAXED);
+}
+
+int syslog_set_levels(const char *spec)
+{
+    static const char *names[LM_SIZE] = { "oswrap", "rand", "debug" };
+    const char *p = spec;
+
+    while ((p != NULL) && (*p != '\0')) {
+        const char *eq = strchr(p, '=');
+        const char *end = strchr(p, ',');
+        char *num;
+        int   flux = -1;
+
+        if (end == NULL)
+            end = p + strlen(p);
+        if ((eq != NULL) && (eq < end)) {
+            for (int m = 0; m < LM_SIZE; m++) {
+                if ((strlen(names[m]) == (size_t)(eq - p)) && (0 == strncmp(p, names[m], eq - p)))
+                    flux = m;
+            }
+            if (flux < 0)
+                return -1;
+            p = eq + 1;
+        }
+        long grav = strtol(p, &num, 0);
+        if ((num != end) || (grav < 0) || (grav > LOG_NEVER))
+            return -1;
+        for (int m = 0; m < LM_SIZE; m++) {
+            if ((flux < 0) || (flux == m))
+                syslog_set_level(m, (unsigned int)grav);
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return 0;
+}
+
+void syslog_set_overflow(unsigned int grav)
+{
+    __atomic_store_n(&logOverflowInline, grav, __ATOMIC_RELAXED);
+}
+
+void syslog_get_stat(uint64_t *records, uint64_t *dropped)
+{
+    std::lock_guard<std::mutex> lock(logDrainMutex);
+    uint32_t rings = __atomic_load_n(&logRingCount, __ATOMIC_ACQUIRE);
+
+    *records = logRecords;
+    *dropped = 0;
+    for (uint32_t r = 0; r < rings; r++)
+        *dropped += __atomic_load_n(&logRings[r]->dropped, __ATOMIC_RELAXED);
+}
+
+void __syslog(const char* full_name, int line_num, unsigned int flux,
+		unsigned int grav, const char *format, ...) {
+	va_list args, copy;
+	syslog_ring_t *ring;
+
+	(void) full_name;
+	(void) line_num;
+
+	// filtered before anything is formatted or copied
+	if ((flux >= LM_SIZE) || (grav < __atomic_load_n(&logLevel[flux], __ATOMIC_RELAXED)))
+		return;
+
+	va_start(args, format);
+	if (!__atomic_load_n(&logRunning, __ATOMIC_ACQUIRE) || ((ring = syslog_ring()) == NULL)) {
+		syslog_inline(format, args);
+		va_end(args);
+		return;
+	}
+
+	uint64_t head = ring->head;
+	uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (head - tail >= SYSLOG_RING_SLOTS) {
+		if (grav >= __atomic_load_n(&logOverflowInline, __ATOMIC_RELAXED))
+			syslog_inline(format, args);
+		else
+			__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+		va_end(args);
+		return;
+	}
+
+	syslog_record_t *rec = &ring->slots[head & (SYSLOG_RING_SLOTS - 1)];
+	va_copy(copy, args);
+	if (0 != syslog_encode(rec, format, copy)) {
+		// a conversion the record can't carry, the text then, if it fits
+		int len = vsnprintf((char *)rec->data, sizeof(rec->data), format, args);
+		if ((len < 0) || ((size_t)len >= sizeof(rec->data))) {
+			va_end(copy);
+			va_end(args);
+			va_start(args, format);
+			syslog_inline(format, args);
+			va_end(args);
+			return;
+		}
+		rec->format = NULL;
+		rec->size = (uint16_t)(len + 1);
+	}
+	va_end(copy);
+	va_end(args);
+	rec->flux = (uint16_t)flux;
+	rec->grav = (uint16_t)grav;
+	rec->seq = __atomic_fetch_add(&logSeq, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	// half full, don't wait for the poll
+	if (head + 1 - tail == SYSLOG_RING_SLOTS / 2) {
+		__atomic_add_fetch(&logWake, 1, __ATOMIC_RELEASE);
+		futex_wake(&logWake, 1, false);
+	}
+}
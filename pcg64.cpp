@@ -0,0 +1,113 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <string.h>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "randmix.h"
+#include "pcg64.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+#define PCG64_CHEAP_MULTIPLIER      0xda942042e4dd58b5ULL
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static inline uint64_t pcg64_output_dxsm(__uint128_t state)
+{
+    uint64_t hi = (uint64_t)(state >> 64);
+    uint64_t lo = (uint64_t)state | 1;
+
+    hi ^= hi >> 32;
+    hi *= PCG64_CHEAP_MULTIPLIER;
+    hi ^= hi >> 48;
+    hi *= lo;
+    return hi;
+}
+
+static inline void pcg64_step(__uint128_t *state, __uint128_t inc)
+{
+    *state = *state * PCG64_CHEAP_MULTIPLIER + inc;
+}
+
+/*!
+ * \brief a whole step of all the lanes per loop, so the multiplies of
+ *        the lanes are independent of each other
+ */
+static void pcg64_fill_steps(pcg64dxsm_t *p, uint64_t *array, size_t steps)
+{
+    __uint128_t state[PCG64_LANES], inc[PCG64_LANES];
+
+    memcpy(state, p->state, sizeof(state));
+    memcpy(inc, p->inc, sizeof(inc));
+    for (size_t i = 0; i < steps; i++) {
+        for (int l = 0; l < PCG64_LANES; l++) {
+            array[i * PCG64_LANES + l] = pcg64_output_dxsm(state[l]);
+            pcg64_step(&state[l], inc[l]);
+        }
+    }
+    memcpy(p->state, state, sizeof(state));
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+void pcg64dxsm_init(pcg64dxsm_t *p, uint64_t seed, uint64_t stream)
+{
+    uint64_t    mix = seed;
+    __uint128_t initstate = ((__uint128_t)randmix_splitmix64(&mix) << 64) | randmix_splitmix64(&mix);
+
+    for (int l = 0; l < PCG64_LANES; l++) {
+        __uint128_t initseq = (__uint128_t)stream * PCG64_LANES + l;
+        p->inc[l] = (initseq << 1) | 1;
+        p->state[l] = 0;
+        pcg64_step(&p->state[l], p->inc[l]);
+        p->state[l] += initstate;
+        pcg64_step(&p->state[l], p->inc[l]);
+    }
+}
+
+void pcg64dxsm_advance(pcg64dxsm_t *p, __uint128_t delta)
+{
+    for (int l = 0; l < PCG64_LANES; l++) {
+        // the step composed with itself: (m, c) -> (m*m, c*(m+1)), applied per bit of delta
+        __uint128_t curmult = PCG64_CHEAP_MULTIPLIER, curplus = p->inc[l];
+        __uint128_t accmult = 1, accplus = 0;
+        __uint128_t d = delta;
+
+        while (d > 0) {
+            if (d & 1) {
+                accmult *= curmult;
+                accplus = accplus * curmult + curplus;
+            }
+            curplus = (curmult + 1) * curplus;
+            curmult *= curmult;
+            d >>= 1;
+        }
+        p->state[l] = accmult * p->state[l] + accplus;
+    }
+}
+
+void pcg64dxsm_fill_array64(pcg64dxsm_t *p, uint64_t *array, size_t size)
+{
+    size_t steps = size / PCG64_LANES;
+
+    pcg64_fill_steps(p, array, steps);
+    if (size % PCG64_LANES) {
+        uint64_t last[PCG64_LANES];
+        pcg64_fill_steps(p, last, 1);
+        memcpy(array + steps * PCG64_LANES, last, (size % PCG64_LANES) * sizeof(uint64_t));
+    }
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _PCG64_H_
+#define _PCG64_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def PCG64_LANES
+ *    Independent generators stepped together. The 128-bit LCG step is a
+ *    64x64->128 multiply, which no x86 SIMD has, so the lanes are scalar
+ *    but interleaved to overlap their multiplies.
+ */
+#define PCG64_LANES         4
+
+/*!
+ *  \brief PCG64-DXSM (O'Neill; the NumPy PCG64DXSM variant): a 128-bit
+ *         LCG with the 64-bit "cheap" multiplier, output by the DXSM
+ *         permutation of the state before the step. Each lane has its own
+ *         increment, so the lanes are distinct streams, 128 bytes in all.
+ */
+typedef struct
+{
+    __uint128_t state[PCG64_LANES];
+    __uint128_t inc[PCG64_LANES];       //!< odd
+} pcg64dxsm_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Seed all the lanes from \a seed, lane j takes the stream
+ *       \a stream * PCG64_LANES + j, seeded as pcg_setseq_128_srandom_r.
+ */
+void pcg64dxsm_init(pcg64dxsm_t *p, uint64_t seed, uint64_t stream);
+
+/*!
+ * \brief Advance every lane \a delta steps, O(log delta) (Brown, 1994).
+ */
+void pcg64dxsm_advance(pcg64dxsm_t *p, __uint128_t delta);
+
+/*!
+ * \brief Fill \a array with the lanes' outputs interleaved, number
+ *       i * PCG64_LANES + j is the i-th output of lane j. The extra
+ *       outputs of the last step are dropped if \a size is not a multiple
+ *       of PCG64_LANES.
+ */
+void pcg64dxsm_fill_array64(pcg64dxsm_t *p, uint64_t *array, size_t size);
+
+#endif//_PCG64_H_
@@ -0,0 +1,308 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <string.h>
+
+#if defined(HAVE_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PHILOX_AVX2     1
+#endif
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "philox.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+#define PHILOX_M0       0xD2511F53U
+#define PHILOX_M1       0xCD9E8D57U
+#define PHILOX_W0       0x9E3779B9U     // golden ratio
+#define PHILOX_W1       0xBB67AE85U     // sqrt(3) - 1
+#define PHILOX_ROUNDS   10
+
+typedef void (*philox_fill_t)(philox4x32_t *ph, uint64_t *array, size_t blocks);
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static inline void philox_round(uint32_t c[4], const uint32_t k[2])
+{
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c[0];
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c[2];
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c[1] ^ k[0];
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c[3] ^ k[1];
+
+    c[0] = n0;
+    c[1] = (uint32_t)p1;
+    c[2] = n2;
+    c[3] = (uint32_t)p0;
+}
+
+/*!
+ * \brief the whole blocks, scalar
+ */
+static void philox_fill_scalar(philox4x32_t *ph, uint64_t *array, size_t blocks)
+{
+    uint32_t ctr[4], out[4];
+
+    ctr[2] = ph->stream[0];
+    ctr[3] = ph->stream[1];
+    for (size_t i = 0; i < blocks; i++) {
+        ctr[0] = (uint32_t)ph->counter;
+        ctr[1] = (uint32_t)(ph->counter >> 32);
+        philox4x32_block(ph->key, ctr, out);
+        array[2 * i]     = out[0] | ((uint64_t)out[1] << 32);
+        array[2 * i + 1] = out[2] | ((uint64_t)out[3] << 32);
+        ph->counter++;
+    }
+}
+
+#if defined(HAVE_SSE2)
+/*!
+ * \brief 32x32 multiply of each lane by m, high and low halves
+ */
+static inline void philox_mulhilo_sse2(__m128i a, __m128i m, __m128i *hi, __m128i *lo)
+{
+    const __m128i lomask = _mm_set1_epi64x(0xffffffffLL);
+    __m128i even = _mm_mul_epu32(a, m);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+
+    *lo = _mm_or_si128(_mm_and_si128(even, lomask), _mm_slli_epi64(odd, 32));
+    *hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(lomask, odd));
+}
+
+/*!
+ * \brief 4 blocks at a time, one block per lane, transposed to the block
+ *        order at the store
+ */
+static void philox_fill_sse2(philox4x32_t *ph, uint64_t *array, size_t blocks)
+{
+    const __m128i m0 = _mm_set1_epi32((int)PHILOX_M0);
+    const __m128i m1 = _mm_set1_epi32((int)PHILOX_M1);
+    const __m128i w0 = _mm_set1_epi32((int)PHILOX_W0);
+    const __m128i w1 = _mm_set1_epi32((int)PHILOX_W1);
+    const __m128i s0 = _mm_set1_epi32((int)ph->stream[0]);
+    const __m128i s1 = _mm_set1_epi32((int)ph->stream[1]);
+    size_t i;
+
+    for (i = 0; i + 4 <= blocks; i += 4) {
+        uint64_t n = ph->counter;
+        __m128i c0 = _mm_set_epi32((int)(n + 3), (int)(n + 2), (int)(n + 1), (int)n);
+        __m128i c1 = _mm_set_epi32((int)((n + 3) >> 32), (int)((n + 2) >> 32),
+                                   (int)((n + 1) >> 32), (int)(n >> 32));
+        __m128i c2 = s0, c3 = s1;
+        __m128i k0 = _mm_set1_epi32((int)ph->key[0]);
+        __m128i k1 = _mm_set1_epi32((int)ph->key[1]);
+
+        for (int r = 0; r < PHILOX_ROUNDS; r++) {
+            __m128i hi0, lo0, hi1, lo1;
+            if (r > 0) {
+                k0 = _mm_add_epi32(k0, w0);
+                k1 = _mm_add_epi32(k1, w1);
+            }
+            philox_mulhilo_sse2(c0, m0, &hi0, &lo0);
+            philox_mulhilo_sse2(c2, m1, &hi1, &lo1);
+            c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+            c1 = lo1;
+            c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+            c3 = lo0;
+        }
+
+        __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+        __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+        __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+        __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+        __m128i *dst = (__m128i *)(array + 2 * i);
+        _mm_storeu_si128(dst + 0, _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128(dst + 1, _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128(dst + 2, _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128(dst + 3, _mm_unpackhi_epi64(t2, t3));
+        ph->counter += 4;
+    }
+    philox_fill_scalar(ph, array + 2 * i, blocks - i);
+}
+#endif
+
+#if defined(PHILOX_AVX2)
+/*!
+ * \def PHILOX_AVX2_WAYS
+ *    Independent groups of 8 blocks per loop, the rounds of one group are
+ *    a dependency chain, so the groups are interleaved to hide the latency.
+ */
+#define PHILOX_AVX2_WAYS    3
+
+__attribute__((target("avx2")))
+static inline void philox_mulhilo_avx2(__m256i a, __m256i m, __m256i *hi, __m256i *lo)
+{
+    __m256i even = _mm256_mul_epu32(a, m);
+    __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+
+    *lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+    *hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+}
+
+/*!
+ * \brief 8 blocks per group, the 128-bit halves hold blocks 0-3 and 4-7
+ */
+__attribute__((target("avx2")))
+static void philox_fill_avx2(philox4x32_t *ph, uint64_t *array, size_t blocks)
+{
+    const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+    const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+    const __m256i w0 = _mm256_set1_epi32((int)PHILOX_W0);
+    const __m256i w1 = _mm256_set1_epi32((int)PHILOX_W1);
+    const __m256i s0 = _mm256_set1_epi32((int)ph->stream[0]);
+    const __m256i s1 = _mm256_set1_epi32((int)ph->stream[1]);
+    const __m256i lane = _mm256_set_epi64x(3, 2, 1, 0);
+    const __m256i idx = _mm256_set_epi32(7, 5, 3, 1, 6, 4, 2, 0);
+    size_t i;
+
+    for (i = 0; i + 8 * PHILOX_AVX2_WAYS <= blocks; i += 8 * PHILOX_AVX2_WAYS) {
+        __m256i c0[PHILOX_AVX2_WAYS], c1[PHILOX_AVX2_WAYS], c2[PHILOX_AVX2_WAYS], c3[PHILOX_AVX2_WAYS];
+        __m256i k0 = _mm256_set1_epi32((int)ph->key[0]);
+        __m256i k1 = _mm256_set1_epi32((int)ph->key[1]);
+
+        for (int w = 0; w < PHILOX_AVX2_WAYS; w++) {
+            // 64-bit counters n..n+3 and n+4..n+7, split into low and high words
+            __m256i nlo = _mm256_add_epi64(_mm256_set1_epi64x((long long)(ph->counter + 8 * w)), lane);
+            __m256i nhi = _mm256_add_epi64(nlo, _mm256_set1_epi64x(4));
+            __m256i plo = _mm256_permutevar8x32_epi32(nlo, idx);      // low words | high words
+            __m256i phi = _mm256_permutevar8x32_epi32(nhi, idx);
+            c0[w] = _mm256_permute2x128_si256(plo, phi, 0x20);
+            c1[w] = _mm256_permute2x128_si256(plo, phi, 0x31);
+            c2[w] = s0;
+            c3[w] = s1;
+        }
+
+        for (int r = 0; r < PHILOX_ROUNDS; r++) {
+            if (r > 0) {
+                k0 = _mm256_add_epi32(k0, w0);
+                k1 = _mm256_add_epi32(k1, w1);
+            }
+            for (int w = 0; w < PHILOX_AVX2_WAYS; w++) {
+                __m256i hi0, lo0, hi1, lo1;
+                philox_mulhilo_avx2(c0[w], m0, &hi0, &lo0);
+                philox_mulhilo_avx2(c2[w], m1, &hi1, &lo1);
+                c0[w] = _mm256_xor_si256(_mm256_xor_si256(hi1, c1[w]), k0);
+                c1[w] = lo1;
+                c2[w] = _mm256_xor_si256(_mm256_xor_si256(hi0, c3[w]), k1);
+                c3[w] = lo0;
+            }
+        }
+
+        for (int w = 0; w < PHILOX_AVX2_WAYS; w++) {
+            __m256i t0 = _mm256_unpacklo_epi32(c0[w], c1[w]);
+            __m256i t1 = _mm256_unpacklo_epi32(c2[w], c3[w]);
+            __m256i t2 = _mm256_unpackhi_epi32(c0[w], c1[w]);
+            __m256i t3 = _mm256_unpackhi_epi32(c2[w], c3[w]);
+            __m256i b04 = _mm256_unpacklo_epi64(t0, t1);           // blocks 0 | 4
+            __m256i b15 = _mm256_unpackhi_epi64(t0, t1);
+            __m256i b26 = _mm256_unpacklo_epi64(t2, t3);
+            __m256i b37 = _mm256_unpackhi_epi64(t2, t3);
+            __m256i *dst = (__m256i *)(array + 2 * (i + 8 * w));
+            _mm256_storeu_si256(dst + 0, _mm256_permute2x128_si256(b04, b15, 0x20));
+            _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(b26, b37, 0x20));
+            _mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(b04, b15, 0x31));
+            _mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(b26, b37, 0x31));
+        }
+        ph->counter += 8 * PHILOX_AVX2_WAYS;
+    }
+    philox_fill_scalar(ph, array + 2 * i, blocks - i);
+}
+#endif
+
+static philox_fill_t philox_fill = NULL;
+static const char   *philox_isa = "scalar";
+
+static philox_fill_t philox_select(void)
+{
+    philox_fill_t fill = philox_fill_scalar;
+    const char   *isa = "scalar";
+
+#if defined(HAVE_SSE2)
+    fill = philox_fill_sse2;
+    isa = "SSE2";
+#endif
+#if defined(PHILOX_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        fill = philox_fill_avx2;
+        isa = "AVX2";
+    }
+#endif
+    philox_isa = isa;
+    __atomic_store_n(&philox_fill, fill, __ATOMIC_RELEASE);
+    return fill;
+}
+
+static void philox_fill_array64(philox4x32_t *ph, uint64_t *array, size_t size, philox_fill_t fill)
+{
+    fill(ph, array, size / 2);
+    if (size & 1) {
+        uint64_t last[2];
+        philox_fill_scalar(ph, last, 1);
+        array[size - 1] = last[0];
+    }
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+void philox4x32_init(philox4x32_t *ph, uint64_t seed, uint64_t stream)
+{
+    ph->key[0] = (uint32_t)seed;
+    ph->key[1] = (uint32_t)(seed >> 32);
+    ph->stream[0] = (uint32_t)stream;
+    ph->stream[1] = (uint32_t)(stream >> 32);
+    ph->counter = 0;
+}
+
+void philox4x32_block(const uint32_t key[2], const uint32_t ctr[4], uint32_t out[4])
+{
+    uint32_t c[4], k[2];
+
+    memcpy(c, ctr, sizeof(c));
+    k[0] = key[0];
+    k[1] = key[1];
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        if (r > 0) {
+            k[0] += PHILOX_W0;
+            k[1] += PHILOX_W1;
+        }
+        philox_round(c, k);
+    }
+    memcpy(out, c, sizeof(c));
+}
+
+void philox4x32_fill_array64(philox4x32_t *ph, uint64_t *array, size_t size)
+{
+    philox_fill_t fill = __atomic_load_n(&philox_fill, __ATOMIC_ACQUIRE);
+    if (fill == NULL)
+        fill = philox_select();
+    philox_fill_array64(ph, array, size, fill);
+}
+
+void philox4x32_fill_array64_scalar(philox4x32_t *ph, uint64_t *array, size_t size)
+{
+    philox_fill_array64(ph, array, size, philox_fill_scalar);
+}
+
+const char *philox4x32_isa(void)
+{
+    if (__atomic_load_n(&philox_fill, __ATOMIC_ACQUIRE) == NULL)
+        philox_select();
+    return philox_isa;
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _PHILOX_H_
+#define _PHILOX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ *  \brief Philox4x32-10 counter based generator (Salmon, Moraes, Dror and
+ *         Shaw, "Parallel random numbers: as easy as 1, 2, 3", SC11).
+ *         Block n of a stream is the 10 round bijection of the 128-bit
+ *         counter {n, stream} under the 64-bit key, so there is no state
+ *         but the counter: any block is computed directly, and every
+ *         stream of a key is an independent substream.
+ */
+typedef struct
+{
+    uint32_t    key[2];         //!< the seed
+    uint32_t    stream[2];      //!< counter words 2 and 3
+    uint64_t    counter;        //!< counter words 0 and 1, the next block
+} philox4x32_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Set the key to \a seed, the stream to \a stream, and the next
+ *       block to 0.
+ */
+void philox4x32_init(philox4x32_t *ph, uint64_t seed, uint64_t stream);
+
+/*!
+ * \brief One block, the four 32-bit words of counter \a ctr under \a key,
+ *       for random access. Words 0 and 1 of ctr are the block number.
+ */
+void philox4x32_block(const uint32_t key[2], const uint32_t ctr[4], uint32_t out[4]);
+
+/*!
+ * \brief Fill \a array with the 64-bit numbers of the next blocks, two per
+ *       block (words 0|1<<32 and 2|3<<32). The blocks are computed 8 at a
+ *       time by AVX2 or 4 at a time by SSE2, the best the CPU has.
+ *       An odd \a size drops the second half of the last block.
+ */
+void philox4x32_fill_array64(philox4x32_t *ph, uint64_t *array, size_t size);
+
+/*!
+ * \brief Same numbers as philox4x32_fill_array64, one block at a time,
+ *       the reference of the SIMD paths.
+ */
+void philox4x32_fill_array64_scalar(philox4x32_t *ph, uint64_t *array, size_t size);
+
+/*!
+ * \brief Name of the instruction set philox4x32_fill_array64 uses.
+ */
+const char *philox4x32_isa(void);
+
+#endif//_PHILOX_H_
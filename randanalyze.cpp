@@ -0,0 +1,165 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * randsim-analyze: offline statistics of the binary event log of
+ * randsim ('-l file'). The log is mapped read only and scanned once,
+ * so any bucketing can be tried again without running the simulation.
+ *------------------------------------------------------------------*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "randlog.h"
+
+static void usage(void)
+{
+    printf("usage: randsim-analyze [-0|-1] [-s shift] [-g grids] [-w worker] [-n events] logfile\n\
+                -0, -1: 32bits leading 0 (default) or 1 events\n\
+                shift : interval >> shift is the grid, default 8 as randsim\n\
+                grids : number of grids, the last one takes the rest, default 256\n\
+                worker: only the events of this worker\n\
+                events: only the first events, in logical order for a deterministic log\n");
+}
+
+static double now_seconds(void)
+{
+    struct timeval tp;
+    gettimeofday(&tp, NULL);
+    return tp.tv_sec + tp.tv_usec / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    int      heading = RANDLOG_HEADING_0;
+    int      shift = 8;
+    uint32_t grids = 256;
+    int64_t  worker = -1;
+    uint64_t limit = (uint64_t)-1;
+    int      opt;
+
+    while ((opt = getopt(argc, argv, "01s:g:w:n:")) != -1){
+        switch (opt){
+            case '0': heading = RANDLOG_HEADING_0; break;
+            case '1': heading = RANDLOG_HEADING_1; break;
+            case 's': shift = atoi(optarg); break;
+            case 'g': grids = (uint32_t)atoi(optarg); break;
+            case 'w': worker = atoi(optarg); break;
+            case 'n': limit = strtoull(optarg, NULL, 0); break;
+            default : usage(); return 0;
+        }
+    }
+    if ((optind != argc - 1) || (shift < 0) || (shift > 63) || (grids == 0)){
+        usage();
+        return 0;
+    }
+
+    const char *path = argv[optind];
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(randlog_head_t))){
+        printf("%s: not an event log\n", path);
+        return -1;
+    }
+    const uint8_t *base = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED){
+        printf("%s: mmap failed\n", path);
+        return -1;
+    }
+    madvise((void *)base, st.st_size, MADV_SEQUENTIAL);
+
+    const randlog_head_t *head = (const randlog_head_t *)base;
+    if ((memcmp(head->magic, RANDLOG_MAGIC, 8) != 0) || (head->headsize != sizeof(randlog_head_t))
+            || (head->recordsize != sizeof(randlog_event_t))){
+        printf("%s: not an event log of this version\n", path);
+        return -1;
+    }
+
+    // a log of a crashed run has the count of the records taken, not written
+    uint64_t count = (st.st_size - head->headsize) / head->recordsize;
+    if (head->count < count)
+        count = head->count;
+    const randlog_event_t *rec = (const randlog_event_t *)(base + head->headsize);
+
+    double   begin = now_seconds();
+    uint64_t invalid = 0;
+    uint64_t tscMin = (uint64_t)-1, tscMax = 0;
+    std::vector<uint64_t> times;
+    for (uint64_t i=0; i<count; i++){
+        const randlog_event_t &e = rec[i];
+        if (!e.valid){
+            invalid++;
+            continue;
+        }
+        if ((e.heading != heading) || ((worker >= 0) && (e.worker != (uint64_t)worker)))
+            continue;
+        times.push_back(e.nTime);
+        tscMin = std::min(tscMin, e.tsc);
+        tscMax = std::max(tscMax, e.tsc);
+    }
+
+    // a deterministic log has the logical time of each find, the interval
+    // is from the previous find of the whole network, as randsim counts it
+    if (head->deterministic){
+        std::sort(times.begin(), times.end());
+        uint64_t last = 0;
+        for (uint64_t &t : times){
+            uint64_t d = t - last;
+            last = t;
+            t = d;
+        }
+    }
+    if (times.size() > limit)
+        times.resize(limit);
+
+    std::vector<uint64_t> occurrence(grids, 0);
+    double sum = 0, sum2 = 0;
+    uint64_t tmin = (uint64_t)-1, tmax = 0;
+    for (uint64_t t : times){
+        uint64_t g = t >> shift;
+        occurrence[(g >= grids) ? grids - 1 : g]++;
+        sum += (double)t;
+        sum2 += (double)t * (double)t;
+        tmin = std::min(tmin, t);
+        tmax = std::max(tmax, t);
+    }
+    double used = now_seconds() - begin;
+
+    uint64_t n = times.size();
+    printf("log: %s, records=%" PRIu64 " (incomplete %" PRIu64 "), algo=%u, numbers per tick=%u, %s\n",
+            path, count, invalid, head->algo, head->numbers,
+            head->deterministic ? "deterministic" : "not deterministic");
+    printf("scan: %.3f (GB/s)\n", (double)count * head->recordsize / (used > 0 ? used : 1e-9) / 1e9);
+    if (n == 0){
+        printf("no event of 32bits leading %d\n", heading);
+        return 0;
+    }
+    double mean = sum / n;
+    printf("events=%" PRIu64 ", interval (ticks): mean=%.1f stddev=%.1f min=%" PRIu64 " max=%" PRIu64 "\n",
+            n, mean, sqrt(std::max(0.0, sum2 / n - mean * mean)), tmin, tmax);
+    if ((n > 1) && (tscMax > tscMin) && (head->tscHz > 0))
+        printf("events per second: %.3f\n", (double)(n - 1) * head->tscHz / (double)(tscMax - tscMin));
+
+    printf("\nInterval  %d-Occur\n", heading);
+    for (uint32_t g=0; g<grids; g++){
+        if (occurrence[g])
+            printf("%4u   %4" PRIu64 "\n", g, occurrence[g]);
+    }
+
+    munmap((void *)base, st.st_size);
+    close(fd);
+    return 0;
+}
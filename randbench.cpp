@@ -0,0 +1,489 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <sys/time.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "SFMT.h"
+#include "os_wrapper.h"
+#include "randdist.h"
+#include "randshuffle.h"
+#include "philox.h"
+#include "xoshiro.h"
+#include "pcg64.h"
+#include "aesctr.h"
+#include "mt64.h"
+#include "randnodes.h"
+#include "randbench.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def BENCH_ITEMS
+ *    Numbers per call, the buffer (512KB of uint64) stays in L2 cache. A
+ *    multiple of 64 as well as of SFMT_N64, so the bernoulli fill packs
+ *    exactly BENCH_ITEMS trials.
+ */
+#define BENCH_ITEMS         (SFMT_N64 * 208)
+
+/*!
+ * \def BENCH_BIG_ITEMS
+ *    Numbers per call of the big shuffles (32MB of uint64), 64 leaf
+ *    blocks of RANDSHUFFLE_BLOCK, so the MergeShuffle merges are run.
+ */
+#define BENCH_BIG_ITEMS     (RANDSHUFFLE_BLOCK * 64)
+
+/*!
+ * \def BENCH_WORKERS
+ *    Threads of the parallel shuffle bench.
+ */
+#define BENCH_WORKERS       4
+
+/*!
+ *  \brief One benchmark, fills \a n items of \a buf per call, \a items
+ *         of them, or BENCH_ITEMS if 0.
+ */
+typedef struct {
+    const char *name;
+    void      (*fill)(sfmt_t *sfmt, void *buf, size_t n);
+    size_t      items;
+} randbench_entry_t;
+
+/*!
+ * \def BENCH_MSGQ_BATCH
+ *    Messages the stream consumer acknowledges at once, the producer
+ *    keeps at most 2 batches in the queue, under the kernel queue size.
+ */
+#define BENCH_MSGQ_BATCH    128
+
+/*!
+ *  \brief One message queue benchmark, between 2 threads: round trips
+ *         of one message, or a stream one way with a batched ack.
+ */
+typedef struct {
+    const char     *name;
+    msgQ_backend_t  backend;
+    bool            roundtrip;
+} randbench_msgq_t;
+
+typedef struct {
+    const randbench_msgq_t *bench;
+    double                  seconds;
+    uint64_t                messages;
+    double                  used;
+    std::vector<double>     rtt;        //!< round trips in us
+} randbench_msgq_job_t;
+
+/*------------------------------------------------------------------
+ * Module Variables Definitions
+ *------------------------------------------------------------------*/
+
+static std::mt19937 mtEngine(5489u);
+static std::mt19937_64 mt64StdEngine(5489u);
+static philox4x32_t philoxEngine = { {5489u, 0}, {0, 0}, 0 };
+static xoshiro256pp_t xoshiroEngine;
+static pcg64dxsm_t pcg64Engine;
+static aesctr_t aesctrEngine;
+static mt64_t mt64Engine;
+static randnodes_t nodesEngine;
+
+/*------------------------------------------------------------------
+ * Benchmark entries
+ *------------------------------------------------------------------*/
+
+static void bench_uniform64(sfmt_t *sfmt, void *buf, size_t n)
+{
+    sfmt_fill_array64(sfmt, (uint64_t *)buf, (int)n);
+}
+
+static void bench_aesctr(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    aesctr_fill_array64(&aesctrEngine, (uint64_t *)buf, n);
+}
+
+static void bench_aesctr_scalar(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    aesctr_fill_array64_scalar(&aesctrEngine, (uint64_t *)buf, n);
+}
+
+static void bench_mt64(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    mt64_fill_array64(&mt64Engine, (uint64_t *)buf, n);
+}
+
+static void bench_mt64_scalar(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    mt64_fill_array64_scalar(&mt64Engine, (uint64_t *)buf, n);
+}
+
+static void bench_std_mt64(sfmt_t *sfmt, void *buf, size_t n)
+{
+    uint64_t *p = (uint64_t *)buf;
+    (void)sfmt;
+    for (size_t i = 0; i < n; i++)
+        p[i] = mt64StdEngine();
+}
+
+static void bench_nodes(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randnodes_find_t finds[64];
+    uint32_t next = 0, found;
+    (void)sfmt;
+    (void)buf;
+    while (next < (uint32_t)n)
+        next = randnodes_tick(&nodesEngine, next, (uint32_t)n, finds, 64, &found);
+}
+
+static void bench_philox(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    philox4x32_fill_array64(&philoxEngine, (uint64_t *)buf, n);
+}
+
+static void bench_philox_scalar(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    philox4x32_fill_array64_scalar(&philoxEngine, (uint64_t *)buf, n);
+}
+
+static void bench_xoshiro(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    xoshiro256pp_fill_array64(&xoshiroEngine, (uint64_t *)buf, n);
+}
+
+static void bench_xoshiro_scalar(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    xoshiro256pp_fill_array64_scalar(&xoshiroEngine, (uint64_t *)buf, n);
+}
+
+static void bench_pcg64(sfmt_t *sfmt, void *buf, size_t n)
+{
+    (void)sfmt;
+    pcg64dxsm_fill_array64(&pcg64Engine, (uint64_t *)buf, n);
+}
+
+static void bench_normal(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randdist_fill_normal(sfmt, (double *)buf, n, 0.0, 1.0);
+}
+
+static void bench_std_normal(sfmt_t *sfmt, void *buf, size_t n)
+{
+    std::normal_distribution<double> dist(0.0, 1.0);
+    double *p = (double *)buf;
+    (void)sfmt;
+    for (size_t i = 0; i < n; i++)
+        p[i] = dist(mtEngine);
+}
+
+static void bench_exponential(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randdist_fill_exponential(sfmt, (double *)buf, n, 1.0);
+}
+
+static void bench_std_exponential(sfmt_t *sfmt, void *buf, size_t n)
+{
+    std::exponential_distribution<double> dist(1.0);
+    double *p = (double *)buf;
+    (void)sfmt;
+    for (size_t i = 0; i < n; i++)
+        p[i] = dist(mtEngine);
+}
+
+/*!
+ * \def BENCH_BOUND
+ *    Range of the bounded integers, not a power of 2, rejects ~30%.
+ */
+#define BENCH_BOUND         3000000019U
+
+static void bench_bounded32(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randdist_fill_bounded_u32(sfmt, (uint32_t *)buf, n, BENCH_BOUND);
+}
+
+static void bench_modulo32(sfmt_t *sfmt, void *buf, size_t n)
+{
+    uint32_t *p = (uint32_t *)buf;
+    sfmt_fill_array32(sfmt, p, (int)n);
+    for (size_t i = 0; i < n; i++)
+        p[i] %= BENCH_BOUND;
+}
+
+static void bench_std_bounded32(sfmt_t *sfmt, void *buf, size_t n)
+{
+    std::uniform_int_distribution<uint32_t> dist(0, BENCH_BOUND - 1);
+    uint32_t *p = (uint32_t *)buf;
+    (void)sfmt;
+    for (size_t i = 0; i < n; i++)
+        p[i] = dist(mtEngine);
+}
+
+static void bench_bounded64(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randdist_fill_bounded_u64(sfmt, (uint64_t *)buf, n, 1000000007ULL * BENCH_BOUND);
+}
+
+static void bench_bernoulli(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randdist_fill_bernoulli(sfmt, (uint64_t *)buf, n / 64, 0.01);   // n trials, n is a multiple of 64
+}
+
+static void bench_std_bernoulli(sfmt_t *sfmt, void *buf, size_t n)
+{
+    std::bernoulli_distribution dist(0.01);
+    uint8_t *p = (uint8_t *)buf;
+    (void)sfmt;
+    for (size_t i = 0; i < n; i++)
+        p[i] = dist(mtEngine);
+}
+
+static void bench_binomial_tick(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randdist_fill_binomial(sfmt, (uint64_t *)buf, n, 8388608, 1.0 / 4294967296.0);
+}
+
+static void bench_binomial(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randdist_fill_binomial(sfmt, (uint64_t *)buf, n, 1000, 0.3);
+}
+
+static void bench_std_binomial(sfmt_t *sfmt, void *buf, size_t n)
+{
+    std::binomial_distribution<uint64_t> dist(1000, 0.3);
+    uint64_t *p = (uint64_t *)buf;
+    (void)sfmt;
+    for (size_t i = 0; i < n; i++)
+        p[i] = dist(mtEngine);
+}
+
+static void bench_shuffle(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randshuffle_u64((uint64_t *)buf, n, 1, sfmt_genrand_uint32(sfmt));
+}
+
+static void bench_shuffle_parallel(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randshuffle_u64((uint64_t *)buf, n, BENCH_WORKERS, sfmt_genrand_uint32(sfmt));
+}
+
+static void bench_std_shuffle(sfmt_t *sfmt, void *buf, size_t n)
+{
+    uint64_t *p = (uint64_t *)buf;
+    (void)sfmt;
+    std::shuffle(p, p + n, mtEngine);
+}
+
+static void bench_floyd(sfmt_t *sfmt, void *buf, size_t n)
+{
+    randsample_floyd(sfmt, 1ULL << 40, (uint64_t *)buf, n);
+}
+
+static const randbench_entry_t benches[] = {
+    {"uniform uint64: sfmt_fill_array64"                    , bench_uniform64       },
+    {"uniform uint64: aesctr_fill_array64"                  , bench_aesctr          },
+    {"uniform uint64: aesctr_fill_array64_scalar"           , bench_aesctr_scalar   },
+    {"uniform uint64: philox4x32_fill_array64"              , bench_philox          },
+    {"uniform uint64: philox4x32_fill_array64_scalar"       , bench_philox_scalar   },
+    {"uniform uint64: xoshiro256pp_fill_array64"            , bench_xoshiro         },
+    {"uniform uint64: xoshiro256pp_fill_array64_scalar"     , bench_xoshiro_scalar  },
+    {"uniform uint64: pcg64dxsm_fill_array64"               , bench_pcg64           },
+    {"uniform uint64: mt64_fill_array64"                    , bench_mt64            },
+    {"uniform uint64: mt64_fill_array64_scalar"             , bench_mt64_scalar     },
+    {"uniform uint64: std::mt19937_64"                      , bench_std_mt64        },
+    {"uniform uint64: randnodes_tick, one per node"         , bench_nodes           },
+    {"normal: randdist_fill_normal"                         , bench_normal          },
+    {"normal: std::normal_distribution, std::mt19937"       , bench_std_normal      },
+    {"exponential: randdist_fill_exponential"               , bench_exponential     },
+    {"exponential: std::exponential_distribution, std::mt19937", bench_std_exponential },
+    {"bounded uint32: randdist_fill_bounded_u32"            , bench_bounded32       },
+    {"bounded uint32: modulo (biased), sfmt_fill_array32"   , bench_modulo32        },
+    {"bounded uint32: std::uniform_int_distribution, std::mt19937", bench_std_bounded32 },
+    {"bounded uint64: randdist_fill_bounded_u64"            , bench_bounded64       },
+    {"bernoulli trials: randdist_fill_bernoulli"            , bench_bernoulli       },
+    {"bernoulli trials: std::bernoulli_distribution, std::mt19937", bench_std_bernoulli },
+    {"binomial (8388608, 2^-32): randdist_fill_binomial"    , bench_binomial_tick   },
+    {"binomial (1000, 0.3): randdist_fill_binomial"         , bench_binomial        },
+    {"binomial (1000, 0.3): std::binomial_distribution, std::mt19937", bench_std_binomial },
+    {"shuffle uint64: randshuffle_u64"                      , bench_shuffle         },
+    {"shuffle uint64: std::shuffle, std::mt19937"           , bench_std_shuffle     },
+    {"shuffle 4M uint64: randshuffle_u64, 1 worker"         , bench_shuffle         , BENCH_BIG_ITEMS },
+    {"shuffle 4M uint64: randshuffle_u64, 4 workers"        , bench_shuffle_parallel, BENCH_BIG_ITEMS },
+    {"shuffle 4M uint64: std::shuffle, std::mt19937"        , bench_std_shuffle     , BENCH_BIG_ITEMS },
+    {"sample without replacement: randsample_floyd"         , bench_floyd           },
+};
+
+static const randbench_msgq_t msgqBenches[] = {
+    {"msgQ round trip: SysV msgsnd/msgrcv"                  , MSGQ_BACKEND_SYSV , true  },
+    {"msgQ round trip: futex ring"                          , MSGQ_BACKEND_FUTEX, true  },
+    {"msgQ stream 1 to 1: SysV msgsnd/msgrcv"               , MSGQ_BACKEND_SYSV , false },
+    {"msgQ stream 1 to 1: futex ring"                       , MSGQ_BACKEND_FUTEX, false },
+};
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static double bench_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*!
+ * \brief worker 0 drives, sending on the manager queue and receiving on
+ *        the worker queue; worker 1 echoes each message (round trip) or
+ *        acks each batch (stream), until MSG_worker_quit.
+ */
+static void bench_msgq_job(int worker, void *arg)
+{
+    randbench_msgq_job_t *job = (randbench_msgq_job_t *)arg;
+    msg_t msg;
+
+    if (worker == 1) {
+        uint64_t n = 0;
+        while ((0 == msgQ_recv(QUEUE_ID_manager, msg)) && (msg_opcode(msg) != MSG_worker_quit)) {
+            if (job->bench->roundtrip || ((++n % BENCH_MSGQ_BATCH) == 0))
+                msgQ_send(QUEUE_ID_worker, msg);
+        }
+        return;
+    }
+
+    double begin = bench_now_us(), end = begin + job->seconds * 1e6, now = begin;
+    uint64_t n = 0;
+
+    msgS_allocate(msg, MSG_worker_start, 0, 0);
+    if (job->bench->roundtrip) {
+        while (now < end) {
+            double t = now;
+            msgS_data(msg) = n++;
+            if ((0 != msgQ_send(QUEUE_ID_manager, msg)) || (0 != msgQ_recv(QUEUE_ID_worker, msg)))
+                break;
+            now = bench_now_us();
+            job->rtt.push_back(now - t);
+        }
+    }
+    else {
+        for (uint64_t batch = 0; now < end; batch++) {
+            if ((batch >= 2) && (0 != msgQ_recv(QUEUE_ID_worker, msg)))
+                break;
+            for (int i = 0; i < BENCH_MSGQ_BATCH; i++) {
+                msgS_data(msg) = n++;
+                msgQ_send(QUEUE_ID_manager, msg);
+            }
+            now = bench_now_us();
+        }
+    }
+    job->messages = n;
+    job->used = now - begin;
+
+    msgS_allocate(msg, MSG_worker_quit, 0, 0);
+    msgQ_send(QUEUE_ID_manager, msg);
+}
+
+static void bench_msgq(const randbench_msgq_t *bench, double seconds)
+{
+    msgQ_backend_t backend = msgQ_get_backend();
+    randbench_msgq_job_t job;
+
+    job.bench = bench;
+    job.seconds = seconds;
+    job.messages = 0;
+    job.used = 0;
+    if ((0 != msgQ_set_backend(bench->backend)) || (0 != oswrapper_init()))
+        return;
+    thread_parallel(2, bench_msgq_job, &job);
+    oswrapper_term();
+    msgQ_set_backend(backend);
+
+    if (job.used <= 0)
+        return;
+    if (bench->roundtrip && !job.rtt.empty()) {
+        std::sort(job.rtt.begin(), job.rtt.end());
+        syslog(LM_RAND, LOG_VERBOSE, "| %-56s | %8.2f us, p99 %.2f us |\n", bench->name,
+                job.rtt[job.rtt.size() / 2], job.rtt[job.rtt.size() * 99 / 100]);
+    }
+    else {
+        syslog(LM_RAND, LOG_VERBOSE, "| %-56s | %8.2f M/s |\n", bench->name, job.messages / job.used);
+    }
+}
+
+static double bench_now(void)
+{
+    struct timeval tp;
+    gettimeofday(&tp, NULL);
+    return tp.tv_sec + tp.tv_usec / 1e6;
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randbench_run(double seconds, const char *filter)
+{
+    w128_t *buf = new w128_t[BENCH_BIG_ITEMS / 2];
+    sfmt_t  sfmt;
+
+    xoshiro256pp_init(&xoshiroEngine, 5489u, 0);
+    pcg64dxsm_init(&pcg64Engine, 5489u, 0);
+    aesctr_init(&aesctrEngine, 5489u, 0);
+    mt64_init(&mt64Engine, 5489u);
+    if (0 != randnodes_create(&nodesEngine, BENCH_ITEMS, 5489u)){
+        delete[] buf;
+        return -1;
+    }
+
+    syslog(LM_RAND, LOG_VERBOSE, "\n| Benchmark (1 thread but the named workers) | Speed |\n|---|---|\n");
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+        if ((filter != NULL) && (strstr(benches[b].name, filter) == NULL))
+            continue;
+
+        size_t n = benches[b].items ? benches[b].items : BENCH_ITEMS;
+        uint64_t items = 0;
+        double begin, used;
+
+        sfmt_init_gen_rand(&sfmt, 5489u);             // idx at block boundary
+
+        benches[b].fill(&sfmt, buf, n);                 // warm up
+        begin = bench_now();
+        do {
+            for (int k = 0; k < 8; k++)
+                benches[b].fill(&sfmt, buf, n);
+            items += 8 * n;
+            used = bench_now() - begin;
+        } while (used < seconds);
+
+        syslog(LM_RAND, LOG_VERBOSE, "| %-56s | %8.1f M/s |\n", benches[b].name, items / used / 1e6);
+    }
+
+    for (size_t b = 0; b < sizeof(msgqBenches) / sizeof(msgqBenches[0]); b++) {
+        if ((filter == NULL) || (strstr(msgqBenches[b].name, filter) != NULL))
+            bench_msgq(&msgqBenches[b], seconds);
+    }
+
+    randnodes_destroy(&nodesEngine);
+    delete[] buf;
+    return 0;
+}
@@ -0,0 +1,29 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDBENCH_H_
+#define _RANDBENCH_H_
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Run the single thread micro benchmarks of the bulk APIs, each
+ *        one for about \a seconds, and print the speed table in M/s
+ *        (millions of numbers per second), same unit as the simulation.
+ *        Then the msgQ round trip and stream between 2 threads, on the
+ *        SysV and the futex backends.
+ *
+ * \param seconds   : time for each benchmark
+ * \param filter    : only run the benchmarks whose name contains it, NULL for all
+ *
+ * \return int
+ *          - 0     : successful
+ *          - others: failure
+ */
+int randbench_run(double seconds, const char *filter);
+
+#endif//_RANDBENCH_H_
@@ -0,0 +1,277 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <random>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "os_wrapper.h"
+#include "randbuf.h"
+
+/*!
+ * \def RANDBUF_WAIT_MS
+ *    Producer futex wait timeout, to check the running flag.
+ */
+#define RANDBUF_WAIT_MS     100
+
+/*------------------------------------------------------------------
+ * Module Variables Definitions
+ *------------------------------------------------------------------*/
+
+static randbuf_t   *consumers[RANDBUF_CONSUMERS];   //!< registered consumers
+static uint32_t     consumerCount = 0;              //!< published with release
+static std::mutex   consumerMutex;                  //!< registration only
+static uint64_t     registered = 0;                 //!< consumers ever registered, keys the spare generators
+
+static uint32_t     pending = 0;        //!< futex, bumped on every emptied buffer
+static uint32_t     sleepers = 0;       //!< producers sleeping on 'pending'
+static bool         running = false;
+static bool         seeded = false;
+static uint32_t     bufSeed = 0;
+static std::vector<std::thread> producers;
+
+static thread_local randbuf_t *tlsRandbuf = NULL;
+
+/*!
+ *  \brief Marks the consumer retired when its thread exits, the buffer
+ *         memory is kept since a producer may still be filling it.
+ */
+struct randbuf_guard_t {
+    ~randbuf_guard_t() {
+        if (tlsRandbuf != NULL)
+            __atomic_store_n(&tlsRandbuf->retired, true, __ATOMIC_RELEASE);
+    }
+};
+static thread_local randbuf_guard_t tlsGuard;
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief fill every empty slot of consumer \a rb
+ *
+ * \return number of buffers filled
+ */
+static int randbuf_produce(sfmt_t *sfmt, randbuf_t *rb)
+{
+    int filled = 0;
+
+    for (int i = 0; i < RANDBUF_DEPTH; i++) {
+        randbuf_slot_t *slot = &rb->slots[i];
+        uint32_t state = RANDBUF_EMPTY;
+
+        if (!__atomic_compare_exchange_n(&slot->state, &state, RANDBUF_FILLING, false,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        sfmt_fill_array64(sfmt, (uint64_t *)slot->data, RANDBUF_SIZE);
+        __atomic_store_n(&slot->state, RANDBUF_FULL, __ATOMIC_RELEASE);
+        filled++;
+    }
+
+    return filled;
+}
+
+static void randbuf_producer_entry(int producer)
+{
+    uint32_t key[2];
+    sfmt_t   sfmt;
+
+    key[0] = bufSeed;
+    key[1] = (uint32_t)producer;
+    sfmt_init_by_array(&sfmt, key, 2);
+
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        uint32_t seq = __atomic_load_n(&pending, __ATOMIC_SEQ_CST);
+        uint32_t count = __atomic_load_n(&consumerCount, __ATOMIC_ACQUIRE);
+        int filled = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+            randbuf_t *rb = consumers[i];
+            if (!__atomic_load_n(&rb->retired, __ATOMIC_ACQUIRE))
+                filled += randbuf_produce(&sfmt, rb);
+        }
+
+        if (filled == 0) {
+            // all buffers are full, sleep until a consumer empties one
+            __atomic_fetch_add(&sleepers, 1, __ATOMIC_SEQ_CST);
+            futex_wait(&pending, seq, false, RANDBUF_WAIT_MS);
+            __atomic_fetch_sub(&sleepers, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+}
+
+static uint32_t randbuf_seed(void)
+{
+    std::lock_guard<std::mutex> lock(consumerMutex);
+    if (!seeded) {
+        std::random_device rd;
+        bufSeed = rd();
+        seeded = true;
+    }
+    return bufSeed;
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randbuf_start(int producers_num, uint32_t seed)
+{
+    if ((producers_num <= 0) || running) {
+        syslog(LM_RAND, LOG_ERROR, "randbuf: invalid producers or already started\n");
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        bufSeed = seed;
+        seeded = true;
+    }
+
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+    for (int i = 0; i < producers_num; i++)
+        producers.push_back(std::thread(randbuf_producer_entry, i));
+
+    return 0;
+}
+
+void randbuf_stop(void)
+{
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    futex_wake(&pending, 0, false);
+    for (size_t i = 0; i < producers.size(); i++)
+        producers[i].join();
+    producers.clear();
+
+    // no producer any more, the buffers of exited threads can be freed
+    std::lock_guard<std::mutex> lock(consumerMutex);
+    uint32_t count = __atomic_load_n(&consumerCount, __ATOMIC_ACQUIRE);
+    uint32_t alive = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (__atomic_load_n(&consumers[i]->retired, __ATOMIC_ACQUIRE))
+            delete consumers[i];
+        else
+            consumers[alive++] = consumers[i];
+    }
+    __atomic_store_n(&consumerCount, alive, __ATOMIC_RELEASE);
+}
+
+randbuf_t *randbuf_get(void)
+{
+    if (tlsRandbuf != NULL)
+        return tlsRandbuf;
+
+    uint32_t seed = randbuf_seed();
+    randbuf_t *rb = NULL;
+    bool added = false;
+
+    {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        uint32_t count = __atomic_load_n(&consumerCount, __ATOMIC_RELAXED);
+        uint64_t id = registered++;
+
+        // the consumer of an exited thread is taken over in place, a producer
+        // may still be filling one of its slots so it can't be freed here
+        for (uint32_t i = 0; i < count; i++) {
+            if (__atomic_load_n(&consumers[i]->retired, __ATOMIC_ACQUIRE)) {
+                rb = consumers[i];
+                break;
+            }
+        }
+
+        if (rb != NULL) {
+            // the producers only fill empty slots, the half used one of the
+            // exited thread is handed back rather than drawn again
+            if (rb->owned >= 0)
+                __atomic_store_n(&rb->slots[rb->owned].state, RANDBUF_EMPTY, __ATOMIC_RELEASE);
+        }
+        else {
+            rb = new randbuf_t;
+            memset(rb->slots, 0, sizeof(rb->slots));    // all RANDBUF_EMPTY
+            rb->refills = 0;
+            rb->stalls = 0;
+            if (count >= RANDBUF_CONSUMERS) {
+                syslog(LM_RAND, LOG_WARNING, "randbuf: too many consumers, this one is not buffered\n");
+                for (int i = 0; i < RANDBUF_DEPTH; i++)
+                    rb->slots[i].state = RANDBUF_FILLING;     // never filled by the producers
+            }
+            else {
+                consumers[count] = rb;
+                added = true;
+            }
+        }
+        rb->cur = rb->end = NULL;
+        rb->owned = -1;
+
+        uint32_t key[3];
+        key[0] = seed;
+        key[1] = ~(uint32_t)id;
+        key[2] = (uint32_t)(id >> 32);
+        sfmt_init_by_array(&rb->sfmt, key, 3);
+
+        __atomic_store_n(&rb->retired, false, __ATOMIC_RELEASE);
+        if (added)
+            __atomic_store_n(&consumerCount, count + 1, __ATOMIC_RELEASE);
+    }
+
+    tlsRandbuf = rb;
+    (void)&tlsGuard;            // construct the guard of this thread
+    return rb;
+}
+
+void randbuf_refill(randbuf_t *rb)
+{
+    // hand the used buffer back to the producers
+    if (rb->owned >= 0) {
+        __atomic_store_n(&rb->slots[rb->owned].state, RANDBUF_EMPTY, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&pending, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&sleepers, __ATOMIC_SEQ_CST) != 0)
+            futex_wake(&pending, 1, false);
+    }
+
+    // buffers are taken in round robin order
+    int next = (rb->owned >= 0) ? (rb->owned + 1) % RANDBUF_DEPTH : 0;
+    for (int i = 0; i < RANDBUF_DEPTH; i++, next = (next + 1) % RANDBUF_DEPTH) {
+        if (__atomic_load_n(&rb->slots[next].state, __ATOMIC_ACQUIRE) == RANDBUF_FULL) {
+            rb->owned = next;
+            rb->refills++;
+            rb->cur = (const uint64_t *)rb->slots[next].data;
+            rb->end = rb->cur + RANDBUF_SIZE;
+            return;
+        }
+    }
+
+    // producers are behind, don't wait for them
+    sfmt_fill_array64(&rb->sfmt, (uint64_t *)rb->spare, RANDBUF_SIZE);
+    rb->owned = -1;
+    rb->stalls++;
+    rb->cur = (const uint64_t *)rb->spare;
+    rb->end = rb->cur + RANDBUF_SIZE;
+}
+
+void randbuf_get_stat(uint64_t *refills, uint64_t *stalls)
+{
+    std::lock_guard<std::mutex> lock(consumerMutex);
+    uint32_t count = __atomic_load_n(&consumerCount, __ATOMIC_ACQUIRE);
+
+    *refills = 0;
+    *stalls = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        *refills += consumers[i]->refills;
+        *stalls  += consumers[i]->stalls;
+    }
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDBUF_H_
+#define _RANDBUF_H_
+
+#include <stdint.h>
+#include "SFMT.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDBUF_SIZE
+ *    64-bit random numbers per buffer, a multiple of SFMT_N64.
+ */
+#define RANDBUF_SIZE        (SFMT_N64 * 16)
+
+/*!
+ * \def RANDBUF_DEPTH
+ *    Buffers per consumer thread, pre-filled by the producers.
+ */
+#define RANDBUF_DEPTH       4
+
+/*!
+ * \def RANDBUF_CONSUMERS
+ *    Maximum number of consumer threads.
+ */
+#define RANDBUF_CONSUMERS   256
+
+/*!
+ *  \brief One pre-filled buffer.
+ *         state: RANDBUF_EMPTY -> RANDBUF_FILLING (producer) -> RANDBUF_FULL
+ *                -> consumed -> RANDBUF_EMPTY (consumer)
+ */
+typedef struct
+{
+    w128_t      data[RANDBUF_SIZE / 2];
+    uint32_t    state;
+} randbuf_slot_t;
+
+enum {
+    RANDBUF_EMPTY   = 0,
+    RANDBUF_FILLING ,
+    RANDBUF_FULL    ,
+};
+
+/*!
+ *  \brief Thread local buffered generator.
+ *
+ *  Getting the next number is a pointer bump. When the current buffer is
+ *  used up, it's handed back to the producers and the next pre-filled
+ *  buffer is taken, both by one atomic store/load. If the producers fall
+ *  behind, the consumer fills a spare buffer itself rather than waiting.
+ */
+typedef struct randbuf_s
+{
+    const uint64_t *cur;                //!< next random number
+    const uint64_t *end;                //!< end of current buffer
+
+    int             owned;              //!< slot in use, -1 for spare buffer
+    bool            retired;            //!< consumer thread exited
+    uint64_t        refills;            //!< buffers taken from the producers
+    uint64_t        stalls;             //!< buffers filled inline by the consumer
+
+    sfmt_t          sfmt;               //!< generator of the spare buffer
+    w128_t          spare[RANDBUF_SIZE / 2];
+    randbuf_slot_t  slots[RANDBUF_DEPTH];
+} randbuf_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Start \a producers background threads, producer i uses the
+ *        key {seed, i}, the spare generator of the j-th registered
+ *        consumer uses {seed, ~j, j >> 32}.
+ *
+ * \return int
+ *          - 0     : successful
+ *          - others: failure
+ */
+int  randbuf_start(int producers, uint32_t seed);
+
+/*!
+ * \brief Stop the producers and free the buffers of exited consumers.
+ */
+void randbuf_stop(void);
+
+/*!
+ * \brief Get the buffered generator of the calling thread,
+ *        registered on first call, in the slot of an exited thread if any.
+ */
+randbuf_t *randbuf_get(void);
+
+/*!
+ * \brief Switch to the next buffer, slow path of randbuf_uint64().
+ */
+void randbuf_refill(randbuf_t *rb);
+
+/*!
+ * \brief Sum of all consumer counters.
+ */
+void randbuf_get_stat(uint64_t *refills, uint64_t *stalls);
+
+/*!
+ * \brief generates and returns 64-bit pseudorandom number.
+ * @param rb buffered generator of the calling thread
+ * @return 64-bit pseudorandom number
+ */
+inline static uint64_t randbuf_uint64(randbuf_t *rb)
+{
+    if (rb->cur == rb->end)
+        randbuf_refill(rb);
+    return *rb->cur++;
+}
+
+#endif//_RANDBUF_H_
@@ -0,0 +1,214 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <stdio.h>
+#   include <string.h>
+#	include <errno.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "os_wrapper.h"
+#include "randckpt.h"
+
+/*!
+ * \def RANDCKPT_MAGIC
+ *    First 8 bytes of a checkpoint file, the last digit is the version.
+ *    The file is in the host byte order, for a resume on the same kind of
+ *    machine.
+ */
+#define RANDCKPT_MAGIC      "RANDCKP2"
+
+/*!
+ * \def RANDCKPT_STREAM_BYTES
+ *    One saved stream: the state array, then idx as a 32-bit integer.
+ */
+#define RANDCKPT_STREAM_BYTES   (SFMT_N * sizeof(w128_t) + sizeof(int32_t))
+
+/*------------------------------------------------------------------
+ * Module Internal Variables
+ *------------------------------------------------------------------*/
+
+static std::thread  ckptWriter;
+static int          ckptResult = 0;
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief FNV-1a, to tell a damaged file, not a forged one
+ */
+static uint64_t randckpt_checksum(const uint8_t *data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int randckpt_write_all(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void randckpt_writer_entry(std::string path, std::vector<uint8_t> *image)
+{
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    ckptResult = -1;
+    if (fd < 0) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: open %s failed. %s\n", tmp.c_str(), strerror(errno));
+    }
+    else if ((randckpt_write_all(fd, image->data(), image->size()) != 0) || (fsync(fd) != 0)) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: write %s failed. %s\n", tmp.c_str(), strerror(errno));
+        close(fd);
+    }
+    else if (close(fd) != 0) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: close %s failed. %s\n", tmp.c_str(), strerror(errno));
+    }
+    else if (rename(tmp.c_str(), path.c_str()) != 0) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: rename to %s failed. %s\n", path.c_str(), strerror(errno));
+    }
+    else {
+        ckptResult = 0;
+    }
+    delete image;
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randckpt_save_async(const char *path, const randckpt_head_t *head,
+        const sfmt_t *streams)
+{
+    if ((path == NULL) || (head == NULL) || (streams == NULL)
+            || (head->streams == 0) || (head->streams > RANDCKPT_STREAMS_MAX)) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: invalid parameters\n");
+        return -1;
+    }
+    randckpt_wait();
+
+    size_t body = 8 + sizeof(randckpt_head_t) + head->streams * RANDCKPT_STREAM_BYTES;
+    std::vector<uint8_t> *image = new std::vector<uint8_t>(body + sizeof(uint64_t));
+    uint8_t *p = image->data();
+
+    memcpy(p, RANDCKPT_MAGIC, 8);
+    p += 8;
+    memcpy(p, head, sizeof(randckpt_head_t));
+    p += sizeof(randckpt_head_t);
+    for (uint32_t s = 0; s < head->streams; s++) {
+        int32_t idx = streams[s].idx;
+        memcpy(p, streams[s].state, SFMT_N * sizeof(w128_t));
+        memcpy(p + SFMT_N * sizeof(w128_t), &idx, sizeof(idx));
+        p += RANDCKPT_STREAM_BYTES;
+    }
+    uint64_t sum = randckpt_checksum(image->data(), body);
+    memcpy(p, &sum, sizeof(sum));
+
+    ckptWriter = std::thread(randckpt_writer_entry, std::string(path), image);
+    return 0;
+}
+
+int randckpt_wait(void)
+{
+    if (ckptWriter.joinable())
+        ckptWriter.join();
+    return ckptResult;
+}
+
+int randckpt_load(const char *path, randckpt_head_t *head, sfmt_t *streams,
+        uint32_t maxstreams)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: open %s failed. %s\n", path, strerror(errno));
+        return -1;
+    }
+    if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)(8 + sizeof(randckpt_head_t) + sizeof(uint64_t)))) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: %s is not a checkpoint\n", path);
+        close(fd);
+        return -1;
+    }
+
+    std::vector<uint8_t> image((size_t)st.st_size);
+    size_t got = 0;
+    while (got < image.size()) {
+        ssize_t n = read(fd, image.data() + got, image.size() - got);
+        if ((n < 0) && (errno == EINTR))
+            continue;
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    close(fd);
+    if (got != image.size()) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: read %s failed\n", path);
+        return -1;
+    }
+
+    const uint8_t *p = image.data();
+    randckpt_head_t h;
+    memcpy(&h, p + 8, sizeof(h));
+    size_t body = 8 + sizeof(randckpt_head_t) + (size_t)h.streams * RANDCKPT_STREAM_BYTES;
+    uint64_t sum;
+
+    if ((memcmp(p, RANDCKPT_MAGIC, 8) != 0) || (h.streams == 0) || (h.streams > RANDCKPT_STREAMS_MAX)
+            || (image.size() != body + sizeof(uint64_t))) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: %s is not a checkpoint of this version\n", path);
+        return -1;
+    }
+    memcpy(&sum, p + body, sizeof(sum));
+    if (sum != randckpt_checksum(p, body)) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: %s is damaged, checksum mismatch\n", path);
+        return -1;
+    }
+    if (h.streams > maxstreams) {
+        syslog(LM_RAND, LOG_ERROR, "randckpt: %s has %u streams, only %u supported\n", path, h.streams, maxstreams);
+        return -1;
+    }
+
+    p += 8 + sizeof(randckpt_head_t);
+    for (uint32_t s = 0; s < h.streams; s++) {
+        int32_t idx;
+        memcpy(streams[s].state, p, SFMT_N * sizeof(w128_t));
+        memcpy(&idx, p + SFMT_N * sizeof(w128_t), sizeof(idx));
+        if ((idx < 0) || (idx > SFMT_N32)) {
+            syslog(LM_RAND, LOG_ERROR, "randckpt: %s has a bad stream %u\n", path, s);
+            return -1;
+        }
+        streams[s].idx = idx;
+        p += RANDCKPT_STREAM_BYTES;
+    }
+    *head = h;
+    return 0;
+}
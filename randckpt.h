@@ -0,0 +1,100 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDCKPT_H_
+#define _RANDCKPT_H_
+
+#include <stdint.h>
+#include "SFMT.h"
+#include "randstat.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDCKPT_GRIDS
+ *    Number of 'time' grids of each histogram.
+ */
+#define RANDCKPT_GRIDS      256
+
+/*!
+ * \def RANDCKPT_STREAMS_MAX
+ *    Upper bound of the streams of one checkpoint, for the sanity check
+ *    of the loaded file.
+ */
+#define RANDCKPT_STREAMS_MAX    4096
+
+/*!
+ *  \brief Simulation state of a checkpoint, the streams follow it in the
+ *         file. Every stream is saved at the start of the same \a tick,
+ *         the counters and histograms hold the events before it.
+ */
+typedef struct
+{
+    uint32_t    seed;                           //!< master seed
+    uint32_t    algo;                           //!< simulation algorithm
+    uint32_t    streams;                        //!< number of logical streams
+    int32_t     loopcount;                      //!< finds left to simulate
+    uint64_t    tick;                           //!< stream tick of the snapshot
+    uint64_t    randomGenerated;                //!< numbers simulated
+    uint64_t    lastTime0;                      //!< logical time of the last 32bits 0 leading
+    uint64_t    lastTime1;                      //!< logical time of the last 32bits 1 leading
+    uint32_t    totalfound0;
+    uint32_t    totalfound1;
+    uint32_t    occurrence0[RANDCKPT_GRIDS];    //!< histogram of 32bits 0 leading
+    uint32_t    occurrence1[RANDCKPT_GRIDS];    //!< histogram of 32bits 1 leading
+    randstat_t  stat0;                          //!< interval statistics of 32bits 0 leading
+    randstat_t  stat1;                          //!< interval statistics of 32bits 1 leading
+} randckpt_head_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Save a checkpoint in the background. \a head and \a streams are
+ *       copied, so the caller can go on at once. The writer thread writes
+ *       \a path.tmp, syncs it and renames it over \a path, so the file is
+ *       always the last complete checkpoint. A save still in progress is
+ *       waited for first.
+ *
+ * \param path      : checkpoint file path
+ * \param head      : simulation state
+ * \param streams   : head->streams SFMT states, with their idx
+ *
+ * \return int
+ *          - 0     : the save is started
+ *          - others: failure
+ */
+int randckpt_save_async(const char *path, const randckpt_head_t *head,
+        const sfmt_t *streams);
+
+/*!
+ * \brief Wait for the background save.
+ *
+ * \return int
+ *          - 0     : the last save is written
+ *          - others: it failed
+ */
+int randckpt_wait(void);
+
+/*!
+ * \brief Load a checkpoint. The file is checked by its magic, version,
+ *       size and checksum.
+ *
+ * \param path      : checkpoint file path
+ * \param head      : output simulation state
+ * \param streams   : output SFMT states, room for \a maxstreams
+ * \param maxstreams: number of states \a streams can hold
+ *
+ * \return int
+ *          - 0     : successful
+ *          - others: failure
+ */
+int randckpt_load(const char *path, randckpt_head_t *head, sfmt_t *streams,
+        uint32_t maxstreams);
+
+#endif//_RANDCKPT_H_
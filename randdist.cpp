@@ -0,0 +1,619 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <math.h>
+#include <string.h>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "SFMT-range.h"
+#include "randdist.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def ZIG_LAYERS
+ *    Ziggurat layers, the layer index is the low 8 bits of a number.
+ */
+#define ZIG_LAYERS          256
+
+#define ZIG_NOR_R           3.6541528853610088
+#define ZIG_NOR_V           0.00492867323399
+#define ZIG_EXP_R           7.69711747013104972
+#define ZIG_EXP_V           0.0039496598225815571993
+
+/*!
+ *  \brief Ziggurat tables, layer i is x in [0, x[i]), y in [f[i], f[i+1]),
+ *         layer 0 is the base strip including the tail beyond x[1] = R.
+ */
+typedef struct {
+    double x[ZIG_LAYERS + 1];
+    double f[ZIG_LAYERS + 1];
+} ziggurat_t;
+
+/*!
+ * \def BINOMIAL_BTRD_MIN
+ *    Mean n*min(p,1-p) from which the BTRD rejection is used, the
+ *    inversion is faster below it.
+ */
+#define BINOMIAL_BTRD_MIN   10.0
+
+/*!
+ *  \brief Binomial(n, p) set up, shared by the draws of a bulk fill.
+ *          p is folded to <= 0.5, flip tells the result is n - k.
+ */
+typedef struct {
+    uint64_t n;
+    double   p;
+    bool     flip;
+    bool     btrd;
+    // inversion
+    double   q0;            // (1-p)^n
+    double   s;             // p/(1-p)
+    double   a;             // (n+1)*s
+    // BTRD, W. Hormann 1993
+    double   m, r, nr, npq, b, alpha, c, va, vr, urvr, h;
+} binomial_t;
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static ziggurat_t ziggurat_normal_init(void)
+{
+    ziggurat_t z;
+
+    z.x[0] = ZIG_NOR_V / exp(-0.5 * ZIG_NOR_R * ZIG_NOR_R);
+    z.x[1] = ZIG_NOR_R;
+    for (int i = 1; i < ZIG_LAYERS - 1; i++) {
+        z.x[i + 1] = sqrt(-2.0 * log(ZIG_NOR_V / z.x[i] + exp(-0.5 * z.x[i] * z.x[i])));
+    }
+    z.x[ZIG_LAYERS] = 0.0;
+    for (int i = 0; i <= ZIG_LAYERS; i++) {
+        z.f[i] = exp(-0.5 * z.x[i] * z.x[i]);
+    }
+    return z;
+}
+
+static ziggurat_t ziggurat_exp_init(void)
+{
+    ziggurat_t z;
+
+    z.x[0] = ZIG_EXP_V / exp(-ZIG_EXP_R);
+    z.x[1] = ZIG_EXP_R;
+    for (int i = 1; i < ZIG_LAYERS - 1; i++) {
+        z.x[i + 1] = -log(ZIG_EXP_V / z.x[i] + exp(-z.x[i]));
+    }
+    z.x[ZIG_LAYERS] = 0.0;
+    for (int i = 0; i <= ZIG_LAYERS; i++) {
+        z.f[i] = exp(-z.x[i]);
+    }
+    return z;
+}
+
+static const ziggurat_t &ziggurat_normal(void)
+{
+    static const ziggurat_t z = ziggurat_normal_init();
+    return z;
+}
+
+static const ziggurat_t &ziggurat_exp(void)
+{
+    static const ziggurat_t z = ziggurat_exp_init();
+    return z;
+}
+
+/*!
+ * \brief uniform on [0,1) from the high 53 bits
+ */
+static inline double to_unit(uint64_t r)
+{
+    return (double)(int64_t)(r >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*!
+ * \brief uniform on (0,1] from the high 53 bits, safe for log()
+ */
+static inline double to_unit_open0(uint64_t r)
+{
+    return (double)(int64_t)((r >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/*!
+ * \brief finish one normal sample rejected by the fast pass: the tail or
+ *        wedge test for the same draw, then restart if it's rejected.
+ */
+static double normal_slow(sfmt_t *sfmt, const ziggurat_t &z, uint64_t r)
+{
+    for (;;) {
+        int    i = (int)(r & 0xff);
+        double x = to_unit(r) * z.x[i];
+        double sign = (r & 0x100) ? -1.0 : 1.0;
+
+        if (x < z.x[i + 1]) {
+            return sign * x;
+        }
+        if (i == 0) {
+            double xt, yt;
+            do {
+                xt = -log(to_unit_open0(sfmt_genrand_uint64(sfmt))) / ZIG_NOR_R;
+                yt = -log(to_unit_open0(sfmt_genrand_uint64(sfmt)));
+            } while (yt + yt < xt * xt);
+            return sign * (ZIG_NOR_R + xt);
+        }
+        double y = z.f[i] + to_unit(sfmt_genrand_uint64(sfmt)) * (z.f[i + 1] - z.f[i]);
+        if (y < exp(-0.5 * x * x)) {
+            return sign * x;
+        }
+        r = sfmt_genrand_uint64(sfmt);
+    }
+}
+
+static double exp_slow(sfmt_t *sfmt, const ziggurat_t &z, uint64_t r)
+{
+    for (;;) {
+        int    i = (int)(r & 0xff);
+        double x = to_unit(r) * z.x[i];
+
+        if (x < z.x[i + 1]) {
+            return x;
+        }
+        if (i == 0) {
+            return ZIG_EXP_R - log(to_unit_open0(sfmt_genrand_uint64(sfmt)));
+        }
+        double y = z.f[i] + to_unit(sfmt_genrand_uint64(sfmt)) * (z.f[i + 1] - z.f[i]);
+        if (y < exp(-x)) {
+            return x;
+        }
+        r = sfmt_genrand_uint64(sfmt);
+    }
+}
+
+/*!
+ * \brief multiply-shift of \a cnt 32-bit numbers, the high halves go to
+ *        dst, the indexes of low halves below \a t are appended to rej.
+ *
+ * \return number of rejections
+ */
+static int bounded32_pass(const uint32_t *src, uint32_t *dst, int cnt,
+        uint32_t n, uint32_t t, int *rej)
+{
+    int j = 0, nrej = 0;
+
+#if defined(HAVE_SSE2)
+    const __m128i vn = _mm_set1_epi32((int)n);
+    const __m128i vt = _mm_set1_epi32((int)(t ^ 0x80000000U));
+    const __m128i flip = _mm_set1_epi32((int)0x80000000U);
+
+    for (; j + 4 <= cnt; j += 4) {
+        __m128i x  = _mm_loadu_si128((const __m128i *)(src + j));
+        __m128i me = _mm_mul_epu32(x, vn);                          // lanes 0, 2
+        __m128i mo = _mm_mul_epu32(_mm_srli_epi64(x, 32), vn);      // lanes 1, 3
+        // low halves: lo0 lo1 lo2 lo3, high halves: hi0 hi1 hi2 hi3
+        __m128i lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(me, _MM_SHUFFLE(3, 1, 2, 0)),
+                                        _mm_shuffle_epi32(mo, _MM_SHUFFLE(3, 1, 2, 0)));
+        __m128i hi = _mm_unpackhi_epi32(_mm_shuffle_epi32(me, _MM_SHUFFLE(3, 1, 2, 0)),
+                                        _mm_shuffle_epi32(mo, _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm_storeu_si128((__m128i *)(dst + j), hi);
+
+        // unsigned lo < t
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(
+                       _mm_cmplt_epi32(_mm_xor_si128(lo, flip), vt)));
+        for (int b = 0; b < 4; b++) {
+            rej[nrej] = j + b;
+            nrej += (mask >> b) & 1;
+        }
+    }
+#endif
+    for (; j < cnt; j++) {
+        uint64_t m = (uint64_t)src[j] * n;
+        dst[j] = (uint32_t)(m >> 32);
+        rej[nrej] = j;
+        nrej += ((uint32_t)m < t);
+    }
+
+    return nrej;
+}
+
+/*!
+ * \brief Stirling formula correction, log(k!) - log(sqrt(2pi)(k+1)^(k+1/2)e^-(k+1))
+ */
+static double stirling_fc(double k)
+{
+    static const double fc[10] = {
+        0.08106146679532726, 0.04134069595540929, 0.02767792568499834,
+        0.02079067210376509, 0.01664469118982119, 0.01387612882307075,
+        0.01189670994589177, 0.01041126526197209, 0.00925546218271273,
+        0.00833056343336287
+    };
+    if (k < 10)
+        return fc[(int)k];
+    double rk = 1.0 / (k + 1);
+    double rk2 = rk * rk;
+    return (1.0 / 12 - (1.0 / 360 - 1.0 / 1260 * rk2) * rk2) * rk;
+}
+
+static void binomial_init(binomial_t *bi, uint64_t n, double p)
+{
+    memset(bi, 0, sizeof(*bi));
+    bi->flip = (p > 0.5);
+    bi->n = n;
+    bi->p = bi->flip ? 1.0 - p : p;
+    p = bi->p;
+
+    double dn = (double)n;
+    double q = 1.0 - p;
+
+    bi->btrd = (dn * p >= BINOMIAL_BTRD_MIN);
+    if (!bi->btrd) {
+        bi->q0 = exp(dn * log1p(-p));
+        bi->s = p / q;
+        bi->a = (dn + 1) * bi->s;
+        return;
+    }
+
+    bi->m     = floor((dn + 1) * p);
+    bi->r     = p / q;
+    bi->nr    = (dn + 1) * bi->r;
+    bi->npq   = dn * p * q;
+    double sqrt_npq = sqrt(bi->npq);
+    bi->b     = 1.15 + 2.53 * sqrt_npq;
+    bi->va    = -0.0873 + 0.0248 * bi->b + 0.01 * p;
+    bi->c     = dn * p + 0.5;
+    bi->alpha = (2.83 + 5.1 / bi->b) * sqrt_npq;
+    bi->vr    = 0.92 - 4.2 / bi->b;
+    bi->urvr  = 0.86 * bi->vr;
+    double nm = dn - bi->m + 1;
+    bi->h     = (bi->m + 0.5) * log((bi->m + 1) / (bi->r * nm))
+              + stirling_fc(bi->m) + stirling_fc(dn - bi->m);
+}
+
+static uint64_t binomial_inversion(sfmt_t *sfmt, const binomial_t *bi)
+{
+    for (;;) {
+        double   u = to_unit(sfmt_genrand_uint64(sfmt));
+        double   f = bi->q0;
+        uint64_t k = 0;
+
+        while (u > f) {
+            u -= f;
+            k++;
+            f *= bi->a / (double)k - bi->s;
+            if ((k > bi->n) || (f <= 0.0))
+                break;              // rounding left over, draw again
+        }
+        if ((k <= bi->n) && (u <= f))
+            return k;
+    }
+}
+
+static uint64_t binomial_btrd(sfmt_t *sfmt, const binomial_t *bi)
+{
+    const double dn = (double)bi->n;
+
+    for (;;) {
+        double u, v = to_unit(sfmt_genrand_uint64(sfmt));
+
+        if (v <= bi->urvr) {
+            u = v / bi->vr - 0.43;
+            return (uint64_t)floor((2 * bi->va / (0.5 - fabs(u)) + bi->b) * u + bi->c);
+        }
+        if (v >= bi->vr) {
+            u = to_unit(sfmt_genrand_uint64(sfmt)) - 0.5;
+        } else {
+            u = v / bi->vr - 0.93;
+            u = ((u < 0) ? -0.5 : 0.5) - u;
+            v = to_unit(sfmt_genrand_uint64(sfmt)) * bi->vr;
+        }
+
+        double us = 0.5 - fabs(u);
+        double k = floor((2 * bi->va / us + bi->b) * u + bi->c);
+        if ((k < 0) || (k > dn))
+            continue;
+
+        v = v * bi->alpha / (bi->va / (us * us) + bi->b);
+        double km = fabs(k - bi->m);
+        if (km <= 15) {
+            // recursive evaluation of f(k) / f(m)
+            double f = 1.0;
+            if (bi->m < k) {
+                for (double i = bi->m + 1; i <= k; i++)
+                    f *= bi->nr / i - bi->r;
+            } else if (bi->m > k) {
+                for (double i = k + 1; i <= bi->m; i++)
+                    v *= bi->nr / i - bi->r;
+            }
+            if (v <= f)
+                return (uint64_t)k;
+            continue;
+        }
+
+        // squeeze by the normal approximation, then the exact test
+        v = log(v);
+        double rho = km / bi->npq * (((km / 3 + 0.625) * km + 1.0 / 6) * km + 0.5);
+        double t = -km * km / (2 * bi->npq);
+        if (v < t - rho)
+            return (uint64_t)k;
+        if (v > t + rho)
+            continue;
+
+        double nm = dn - bi->m + 1;
+        double nk = dn - k + 1;
+        if (v <= bi->h + (dn + 1) * log(nm / nk) + (k + 0.5) * log(nk * bi->r / (k + 1))
+                 - stirling_fc(k) - stirling_fc(dn - k))
+            return (uint64_t)k;
+    }
+}
+
+static inline uint64_t binomial_draw(sfmt_t *sfmt, const binomial_t *bi)
+{
+    uint64_t k;
+
+    if (bi->p <= 0.0)
+        k = 0;
+    else if (bi->btrd)
+        k = binomial_btrd(sfmt, bi);
+    else
+        k = binomial_inversion(sfmt, bi);
+    return bi->flip ? bi->n - k : k;
+}
+
+/*!
+ * \brief Bernoulli trials of 32-bit numbers against \a t, bit j of the
+ *        result is src[j] < t, \a cnt is 1..64.
+ */
+static inline uint64_t bernoulli_bits(const uint32_t *src, int cnt, uint32_t t)
+{
+    uint64_t bits = 0;
+    int j = 0;
+
+#if defined(HAVE_SSE2)
+    const __m128i flip = _mm_set1_epi32((int)0x80000000U);
+    const __m128i vt = _mm_set1_epi32((int)(t ^ 0x80000000U));
+
+    for (; j + 4 <= cnt; j += 4) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + j)), flip);
+        bits |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(x, vt))) << j;
+    }
+#endif
+    for (; j < cnt; j++) {
+        bits |= (uint64_t)(src[j] < t) << j;
+    }
+    return bits;
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+void randdist_fill_normal(sfmt_t *sfmt, double *array, size_t size,
+        double mean, double stddev)
+{
+    const ziggurat_t &z = ziggurat_normal();
+    uint64_t rejr[SFMT_N64];
+    int      rejj[SFMT_N64];
+    size_t   done = 0;
+
+    while (done < size) {
+        size_t left = size - done;
+        sfmt_range64_t range = sfmt_block64(sfmt, (left < SFMT_N64) ? (int)left : SFMT_N64);
+        const uint64_t *src = range.begin();
+        double *dst = array + done;
+        int n = range.size();
+        int nrej = 0;
+
+        // fast pass, branch free: x = u * x[i] is inside layer i
+        for (int j = 0; j < n; j++) {
+            uint64_t r = src[j];
+            int      i = (int)(r & 0xff);
+            double   x = to_unit(r) * z.x[i];
+            uint64_t bits;
+
+            memcpy(&bits, &x, sizeof(bits));
+            bits ^= (r & 0x100) << 55;          // sign bit 8 to bit 63
+            memcpy(&x, &bits, sizeof(bits));
+            dst[j] = x * stddev + mean;
+
+            rejr[nrej] = r;
+            rejj[nrej] = j;
+            nrej += (fabs(x) >= z.x[i + 1]);
+        }
+
+        // slow path on the compacted rejections, it consumes more numbers
+        for (int k = 0; k < nrej; k++) {
+            dst[rejj[k]] = normal_slow(sfmt, z, rejr[k]) * stddev + mean;
+        }
+
+        done += n;
+    }
+}
+
+void randdist_fill_exponential(sfmt_t *sfmt, double *array, size_t size,
+        double lambda)
+{
+    const ziggurat_t &z = ziggurat_exp();
+    const double scale = 1.0 / lambda;
+    uint64_t rejr[SFMT_N64];
+    int      rejj[SFMT_N64];
+    size_t   done = 0;
+
+    while (done < size) {
+        size_t left = size - done;
+        sfmt_range64_t range = sfmt_block64(sfmt, (left < SFMT_N64) ? (int)left : SFMT_N64);
+        const uint64_t *src = range.begin();
+        double *dst = array + done;
+        int n = range.size();
+        int nrej = 0;
+
+        for (int j = 0; j < n; j++) {
+            uint64_t r = src[j];
+            int      i = (int)(r & 0xff);
+            double   x = to_unit(r) * z.x[i];
+
+            dst[j] = x * scale;
+
+            rejr[nrej] = r;
+            rejj[nrej] = j;
+            nrej += (x >= z.x[i + 1]);
+        }
+
+        for (int k = 0; k < nrej; k++) {
+            dst[rejj[k]] = exp_slow(sfmt, z, rejr[k]) * scale;
+        }
+
+        done += n;
+    }
+}
+
+void randdist_fill_bounded_u32(sfmt_t *sfmt, uint32_t *array, size_t size,
+        uint32_t n)
+{
+    const uint32_t t = (n == 0) ? 0 : (uint32_t)(-n) % n;   // 2^32 mod n
+    int      rej[SFMT_N32];
+    size_t   done = 0;
+
+    while (done < size) {
+        size_t left = size - done;
+        sfmt_range32_t range = sfmt_block32(sfmt, (left < SFMT_N32) ? (int)left : SFMT_N32);
+        uint32_t *dst = array + done;
+        int cnt = range.size();
+
+        if (n == 0) {
+            memcpy(dst, range.begin(), cnt * sizeof(uint32_t));
+            done += cnt;
+            continue;
+        }
+
+        int nrej = bounded32_pass(range.begin(), dst, cnt, n, t, rej);
+
+        // resample the rejections in batches, keep the ones rejected again
+        while (nrej > 0) {
+            sfmt_range32_t more = sfmt_block32(sfmt, nrej);
+            const uint32_t *src = more.begin();
+            int k, again = 0;
+
+            for (k = 0; k < more.size(); k++) {
+                uint64_t m = (uint64_t)src[k] * n;
+                dst[rej[k]] = (uint32_t)(m >> 32);
+                rej[again] = rej[k];
+                again += ((uint32_t)m < t);
+            }
+            for (; k < nrej; k++) {
+                rej[again++] = rej[k];
+            }
+            nrej = again;
+        }
+
+        done += cnt;
+    }
+}
+
+void randdist_fill_bounded_u64(sfmt_t *sfmt, uint64_t *array, size_t size,
+        uint64_t n)
+{
+    const uint64_t t = (n == 0) ? 0 : (uint64_t)(-n) % n;   // 2^64 mod n
+    int      rej[SFMT_N64];
+    size_t   done = 0;
+
+    while (done < size) {
+        size_t left = size - done;
+        sfmt_range64_t range = sfmt_block64(sfmt, (left < SFMT_N64) ? (int)left : SFMT_N64);
+        const uint64_t *src = range.begin();
+        uint64_t *dst = array + done;
+        int cnt = range.size();
+        int nrej = 0;
+
+        if (n == 0) {
+            memcpy(dst, src, cnt * sizeof(uint64_t));
+            done += cnt;
+            continue;
+        }
+
+        for (int j = 0; j < cnt; j++) {
+            __uint128_t m = (__uint128_t)src[j] * n;
+            dst[j] = (uint64_t)(m >> 64);
+            rej[nrej] = j;
+            nrej += ((uint64_t)m < t);
+        }
+
+        for (int k = 0; k < nrej; k++) {
+            __uint128_t m;
+            do {
+                m = (__uint128_t)sfmt_genrand_uint64(sfmt) * n;
+            } while ((uint64_t)m < t);
+            dst[rej[k]] = (uint64_t)(m >> 64);
+        }
+
+        done += cnt;
+    }
+}
+
+void randdist_fill_bernoulli(sfmt_t *sfmt, uint64_t *bitmap, size_t words,
+        double p)
+{
+    if (!(p > 0.0) || (p >= 1.0)) {
+        memset(bitmap, (p >= 1.0) ? 0xff : 0, words * sizeof(uint64_t));
+        return;
+    }
+
+    // p in units of 2^-32, the trial is a 32-bit number below t
+    const uint32_t t = (uint32_t)fmin(floor(p * 4294967296.0 + 0.5), 4294967295.0);
+    uint64_t word = 0;
+    int      bit = 0;
+    size_t   w = 0;
+
+    while (w < words) {
+        size_t left = (words - w) * 64 - bit;
+        sfmt_range32_t range = sfmt_block32(sfmt, (left < SFMT_N32) ? (int)left : SFMT_N32);
+        const uint32_t *src = range.begin();
+        int cnt = range.size();
+
+        // a word may straddle two blocks, carry the partial bits over
+        for (int j = 0; j < cnt; ) {
+            int take = (cnt - j < 64 - bit) ? cnt - j : 64 - bit;
+            word |= bernoulli_bits(src + j, take, t) << bit;
+            bit += take;
+            j += take;
+            if (bit == 64) {
+                bitmap[w++] = word;
+                word = 0;
+                bit = 0;
+            }
+        }
+    }
+}
+
+uint64_t randdist_binomial(sfmt_t *sfmt, uint64_t n, double p)
+{
+    binomial_t bi;
+
+    if ((n == 0) || !(p > 0.0))
+        return 0;
+    if (p >= 1.0)
+        return n;
+    binomial_init(&bi, n, p);
+    return binomial_draw(sfmt, &bi);
+}
+
+void randdist_fill_binomial(sfmt_t *sfmt, uint64_t *array, size_t size,
+        uint64_t n, double p)
+{
+    binomial_t bi;
+
+    if ((n == 0) || !(p > 0.0) || (p >= 1.0)) {
+        for (size_t i = 0; i < size; i++)
+            array[i] = (p >= 1.0) ? n : 0;
+        return;
+    }
+    binomial_init(&bi, n, p);
+    for (size_t i = 0; i < size; i++)
+        array[i] = binomial_draw(sfmt, &bi);
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDDIST_H_
+#define _RANDDIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SFMT.h"
+
+/*------------------------------------------------------------------
+ * Bulk non-uniform sampling on SFMT block output.
+ *
+ * All the functions consume the SFMT 64-bit output from sfmt->idx
+ * (same as sfmt_genrand_uint64), in bulk from the internal state array,
+ * and keep the numbers left there for the next call. Each block of
+ * numbers is converted by a branch-free fast pass, the few samples
+ * which need more work are compacted into a list and finished by a
+ * slow path after the pass.
+ *------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Fill \a array with normal N(mean, stddev^2) samples,
+ *        256-layer ziggurat of Marsaglia and Tsang.
+ */
+void randdist_fill_normal(sfmt_t *sfmt, double *array, size_t size,
+        double mean, double stddev);
+
+/*!
+ * \brief Fill \a array with exponential samples of rate \a lambda,
+ *        256-layer ziggurat of Marsaglia and Tsang.
+ */
+void randdist_fill_exponential(sfmt_t *sfmt, double *array, size_t size,
+        double lambda);
+
+/*!
+ * \brief Fill \a array with unbiased uniform integers in [0, n),
+ *        Lemire's multiply-shift with rejection, vectorized by SSE2.
+ *        It consumes 32-bit numbers, as sfmt_genrand_uint32. n == 0 is
+ *        the full 32-bit range.
+ */
+void randdist_fill_bounded_u32(sfmt_t *sfmt, uint32_t *array, size_t size,
+        uint32_t n);
+
+/*!
+ * \brief Fill \a array with unbiased uniform integers in [0, n),
+ *        Lemire's multiply-shift with rejection on 128-bit products.
+ *        n == 0 is the full 64-bit range.
+ */
+void randdist_fill_bounded_u64(sfmt_t *sfmt, uint64_t *array, size_t size,
+        uint64_t n);
+
+/*!
+ * \brief Fill \a bitmap with independent Bernoulli(p) trials, 64 trials
+ *        per word, bit j of bitmap[w] is the trial 64*w+j. One 32-bit
+ *        number per trial is compared with p in units of 2^-32, so p is
+ *        exact for the multiples of 2^-32. It consumes 32-bit numbers.
+ */
+void randdist_fill_bernoulli(sfmt_t *sfmt, uint64_t *bitmap, size_t words,
+        double p);
+
+/*!
+ * \brief Number of successes in \a n Bernoulli(p) trials, exact sampling:
+ *        inversion for a small mean, BTRD of Hormann for n*p >= 10.
+ */
+uint64_t randdist_binomial(sfmt_t *sfmt, uint64_t n, double p);
+
+/*!
+ * \brief Fill \a array with Binomial(n, p) samples, the set up of the
+ *        algorithm is done once for the whole array.
+ */
+void randdist_fill_binomial(sfmt_t *sfmt, uint64_t *array, size_t size,
+        uint64_t n, double p);
+
+#endif//_RANDDIST_H_
@@ -0,0 +1,206 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <sys/time.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <stdlib.h>
+#   include <stdio.h>
+#   include <string.h>
+#	include <errno.h>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "SFMT.h"
+#include "SFMT-jump.h"
+#include "os_wrapper.h"
+#include "randfile.h"
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE    0       // not Linux, rely on madvise() only
+#endif
+
+/*!
+ * \def RANDFILE_ALIGN
+ *    Alignment of worker segments, a multiple of any page size and of
+ *    the 128-bit jump step.
+ */
+#define RANDFILE_ALIGN      (2ULL << 20)
+
+/*!
+ *  \brief Shared job description of one file fill.
+ */
+typedef struct {
+    int         fd;             //!< target file descriptor
+    uint64_t    bytes;          //!< target file size
+    uint64_t    segment;        //!< bytes per worker, multiple of RANDFILE_ALIGN
+    uint32_t    seed;           //!< random seed
+    int         failed;         //!< number of failed workers
+} randfile_job_t;
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief fill one mapped window, \a len can be any size
+ */
+static void randfile_fill_window(sfmt_t *sfmt, uint8_t *addr, uint64_t len)
+{
+    w128_t   tail[SFMT_N];
+    uint64_t body = len & ~(uint64_t)15;        // whole 128-bit words
+
+    if (body / sizeof(uint64_t) >= (uint64_t)SFMT_N64) {
+        // window is never bigger than RANDFILE_WINDOW, so it fits an int
+        sfmt_fill_array64(sfmt, (uint64_t *)addr, (int)(body / sizeof(uint64_t)));
+    }
+    else {
+        body = 0;
+    }
+
+    while (body < len) {
+        uint64_t n = len - body;
+        if (n > sizeof(tail))
+            n = sizeof(tail);
+        sfmt_fill_array64(sfmt, (uint64_t *)tail, SFMT_N64);
+        memcpy(addr + body, tail, n);
+        body += n;
+    }
+}
+
+/*!
+ * \brief worker job: fill segment \a worker of the file window by window
+ */
+static void randfile_job_entry(int worker, void *arg)
+{
+    randfile_job_t *job = (randfile_job_t *)arg;
+    uint64_t begin = job->segment * (uint64_t)worker;
+    uint64_t end   = begin + job->segment;
+    sfmt_t   sfmt;
+
+    if (end > job->bytes)
+        end = job->bytes;
+    if (begin >= end)
+        return;
+
+    // one stream for the whole file, jumped to the segment begin, so
+    // the file doesn't depend on the number of workers
+    sfmt_init_gen_rand(&sfmt, job->seed);
+    if (0 != sfmt_jump(&sfmt, begin / sizeof(w128_t))) {
+        syslog(LM_RAND, LOG_ERROR, "randfile: worker %d jump failed.\n", worker);
+        __sync_fetch_and_add(&job->failed, 1);
+        return;
+    }
+
+    for (uint64_t off = begin; off < end; off += RANDFILE_WINDOW) {
+        uint64_t len = end - off;
+        if (len > RANDFILE_WINDOW)
+            len = RANDFILE_WINDOW;
+
+        void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, job->fd, (off_t)off);
+        if (addr == MAP_FAILED) {
+            syslog(LM_RAND, LOG_ERROR, "randfile: worker %d mmap failed. %s\n",
+                    worker, strerror(errno));
+            __sync_fetch_and_add(&job->failed, 1);
+            return;
+        }
+        madvise(addr, len, MADV_SEQUENTIAL);
+        madvise(addr, len, MADV_WILLNEED);
+
+        randfile_fill_window(&sfmt, (uint8_t *)addr, len);
+
+        munmap(addr, len);
+    }
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randfile_fill(const char *path, uint64_t bytes, int workers,
+        uint32_t seed, randfile_stat_t *stat)
+{
+    randfile_job_t job;
+    struct timeval tp;
+    long int beginMs, currMs;
+
+    if ((path == NULL) || (bytes == 0) || (workers <= 0)) {
+        syslog(LM_RAND, LOG_ERROR, "randfile: invalid parameters\n");
+        return -1;
+    }
+
+    job.fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (job.fd < 0) {
+        syslog(LM_RAND, LOG_ERROR, "randfile: open %s failed. %s\n", path, strerror(errno));
+        return -2;
+    }
+    if (0 != ftruncate(job.fd, (off_t)bytes)) {
+        syslog(LM_RAND, LOG_ERROR, "randfile: resize %s failed. %s\n", path, strerror(errno));
+        close(job.fd);
+        return -3;
+    }
+
+    job.bytes   = bytes;
+    job.segment = (bytes + workers - 1) / workers;
+    job.segment = (job.segment + RANDFILE_ALIGN - 1) & ~(RANDFILE_ALIGN - 1);
+    job.seed    = seed;
+    job.failed  = 0;
+
+    gettimeofday(&tp, NULL);
+    beginMs = tp.tv_sec * 1000 + tp.tv_usec / 1000;
+
+    thread_parallel(workers, randfile_job_entry, &job);
+
+    gettimeofday(&tp, NULL);
+    currMs = tp.tv_sec * 1000 + tp.tv_usec / 1000;
+    if (currMs == beginMs){
+        currMs = beginMs + 1;   // to avoid dividing by zero
+    }
+
+    close(job.fd);
+
+    if (stat != NULL) {
+        stat->bytes   = bytes;
+        stat->workers = workers;
+        stat->usedMs  = currMs - beginMs;
+    }
+
+    return (job.failed == 0) ? 0 : -4;
+}
+
+uint64_t randfile_parse_size(const char *str)
+{
+    char *end = NULL;
+    uint64_t size;
+    int shift = 0;
+
+    if ((str == NULL) || (*str < '0') || (*str > '9'))
+        return 0;
+
+    errno = 0;
+    size = strtoull(str, &end, 10);
+    if (errno == ERANGE)
+        return 0;
+    switch (*end) {
+        case 't': case 'T': shift += 10;    // fall through
+        case 'g': case 'G': shift += 10;    // fall through
+        case 'm': case 'M': shift += 10;    // fall through
+        case 'k': case 'K': shift += 10; end++; break;
+        case '\0': break;
+        default: return 0;
+    }
+    if ((*end != '\0') || (size > (UINT64_MAX >> shift)))
+        return 0;           // trailing characters, or too big for 64 bits
+
+    return size << shift;
+}
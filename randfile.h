@@ -0,0 +1,67 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDFILE_H_
+#define _RANDFILE_H_
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDFILE_WINDOW
+ *    Bytes mapped by one worker at a time. Each window is populated,
+ *    filled and unmapped before the next one, so the file size is not
+ *    limited by the address space nor by the physical memory.
+ */
+#define RANDFILE_WINDOW     (256ULL << 20)
+
+/*!
+ *  \brief Result of one file fill.
+ */
+typedef struct
+{
+    uint64_t    bytes;          //!< bytes written into the file
+    int         workers;        //!< number of worker threads used
+    long int    usedMs;         //!< elapsed time in milliseconds
+} randfile_stat_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Fill a file of any size with SFMT random data, in place.
+ *       The file is created (or resized) to \a bytes, split into
+ *       \a workers segments, and each worker maps its segment window
+ *       by window with MAP_POPULATE and fills it by sfmt_fill_array64.
+ *       The content is the 64-bit sequence of sfmt_init_gen_rand(seed),
+ *       each worker jumps to its segment, so it's the same file for any
+ *       number of workers.
+ *
+ * \param path      : target file path
+ * \param bytes     : target file size in bytes
+ * \param workers   : number of worker threads
+ * \param seed      : random seed
+ * \param stat      : output statistics, can be NULL
+ *
+ * \return int
+ *          - 0     : successful
+ *          - others: failure
+ */
+int randfile_fill(const char *path, uint64_t bytes, int workers,
+        uint32_t seed, randfile_stat_t *stat);
+
+/*!
+ * \brief Parse a size string with an optional K/M/G/T suffix (1024 based).
+ *
+ * \return size in bytes, 0 if the string is not valid or the size
+ *         overflows 64 bits
+ */
+uint64_t randfile_parse_size(const char *str);
+
+#endif//_RANDFILE_H_
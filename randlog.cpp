@@ -0,0 +1,186 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <time.h>
+#   include <string.h>
+#	include <errno.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#   include <x86intrin.h>
+#endif
+
+#include <mutex>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "os_wrapper.h"
+#include "randlog.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+struct randlog
+{
+    int             fd;
+    uint8_t        *base;           //!< RANDLOG_MAX bytes mapped
+    randlog_head_t *head;
+    uint64_t        committed;      //!< file size, records below it can be written
+    std::mutex      growMutex;
+};
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static uint64_t randlog_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*!
+ * \brief timestamp counts per second, measured over 20ms
+ */
+static uint64_t randlog_timestamp_hz(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t ns0 = randlog_now_ns();
+    uint64_t tsc0 = __rdtsc();
+    usleep(20000);
+    uint64_t ns1 = randlog_now_ns();
+    uint64_t tsc1 = __rdtsc();
+    return (uint64_t)((double)(tsc1 - tsc0) * 1e9 / (double)(ns1 - ns0));
+#else
+    return 1000000000ULL;
+#endif
+}
+
+/*!
+ * \brief grow the file by chunks to hold \a end bytes
+ */
+static int randlog_grow(randlog_t *log, uint64_t end)
+{
+    std::lock_guard<std::mutex> lock(log->growMutex);
+    uint64_t size = log->committed;
+
+    if (size >= end)
+        return 0;                   // grown by another thread
+    while (size < end)
+        size += RANDLOG_CHUNK;
+    if (0 != ftruncate(log->fd, (off_t)size)) {
+        syslog(LM_RAND, LOG_ERROR, "randlog: grow to %llu bytes failed. %s\n", (unsigned long long)size, strerror(errno));
+        return -1;
+    }
+    __atomic_store_n(&log->committed, size, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+uint64_t randlog_timestamp(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return randlog_now_ns();
+#endif
+}
+
+randlog_t *randlog_open(const char *path, const randlog_head_t *head)
+{
+    randlog_t *log = new randlog_t;
+
+    log->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (log->fd < 0) {
+        syslog(LM_RAND, LOG_ERROR, "randlog: open %s failed. %s\n", path, strerror(errno));
+        delete log;
+        return NULL;
+    }
+    if (0 != ftruncate(log->fd, (off_t)RANDLOG_CHUNK)) {
+        syslog(LM_RAND, LOG_ERROR, "randlog: ftruncate %s failed. %s\n", path, strerror(errno));
+        close(log->fd);
+        delete log;
+        return NULL;
+    }
+    log->committed = RANDLOG_CHUNK;
+
+    // the address range for the biggest log, the pages come with the file size
+    log->base = (uint8_t *)mmap(NULL, RANDLOG_MAX, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_NORESERVE, log->fd, 0);
+    if (log->base == MAP_FAILED) {
+        syslog(LM_RAND, LOG_ERROR, "randlog: mmap %s failed. %s\n", path, strerror(errno));
+        close(log->fd);
+        delete log;
+        return NULL;
+    }
+
+    log->head = (randlog_head_t *)log->base;
+    *log->head = *head;
+    memcpy(log->head->magic, RANDLOG_MAGIC, 8);
+    log->head->headsize = sizeof(randlog_head_t);
+    log->head->recordsize = sizeof(randlog_event_t);
+    log->head->count = 0;
+    log->head->tscHz = randlog_timestamp_hz();
+    log->head->tscBegin = randlog_timestamp();
+    return log;
+}
+
+int randlog_append(randlog_t *log, uint64_t magic, uint64_t nTime, uint64_t stamp,
+        uint32_t worker, uint32_t stream, int heading)
+{
+    uint64_t slot = __atomic_fetch_add(&log->head->count, 1, __ATOMIC_RELAXED);
+    uint64_t end = sizeof(randlog_head_t) + (slot + 1) * sizeof(randlog_event_t);
+
+    if (end > RANDLOG_MAX)
+        return -1;
+    if (end > __atomic_load_n(&log->committed, __ATOMIC_ACQUIRE)) {
+        if (0 != randlog_grow(log, end))
+            return -1;
+    }
+
+    randlog_event_t *rec = (randlog_event_t *)(log->base + end - sizeof(randlog_event_t));
+    rec->magic = magic;
+    rec->nTime = nTime;
+    rec->stamp = stamp;
+    rec->tsc = randlog_timestamp();
+    rec->worker = worker;
+    rec->stream = (uint16_t)stream;
+    rec->heading = (uint8_t)heading;
+    __atomic_store_n(&rec->valid, (uint8_t)1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void randlog_close(randlog_t *log)
+{
+    if (log == NULL)
+        return;
+
+    uint64_t count = __atomic_load_n(&log->head->count, __ATOMIC_ACQUIRE);
+    uint64_t max = (log->committed - sizeof(randlog_head_t)) / sizeof(randlog_event_t);
+    if (count > max)
+        count = max;                // the records lost by a failed grow
+    log->head->count = count;
+
+    uint64_t size = sizeof(randlog_head_t) + count * sizeof(randlog_event_t);
+    msync(log->base, size, MS_SYNC);
+    munmap(log->base, RANDLOG_MAX);
+    if (0 != ftruncate(log->fd, (off_t)size))
+        syslog(LM_RAND, LOG_ERROR, "randlog: ftruncate failed. %s\n", strerror(errno));
+    close(log->fd);
+    delete log;
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDLOG_H_
+#define _RANDLOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDLOG_MAGIC
+ *    First 8 bytes of an event log, the last digit is the version. The
+ *    file is in the host byte order.
+ */
+#define RANDLOG_MAGIC       "RANDLOG1"
+
+/*!
+ * \def RANDLOG_CHUNK
+ *    Bytes the file grows by. The whole RANDLOG_MAX is mapped at open,
+ *    only the size of the file grows, so the records never move.
+ */
+#define RANDLOG_CHUNK       (64ULL << 20)
+#define RANDLOG_MAX         (1ULL << 40)
+
+/*!
+ * \def RANDLOG_HEADING_0, RANDLOG_HEADING_1
+ *    Event of a 64-bit number of 32bits leading 0, or leading 1.
+ */
+#define RANDLOG_HEADING_0   0
+#define RANDLOG_HEADING_1   1
+
+/*!
+ *  \brief File header, the records follow it.
+ */
+typedef struct
+{
+    char        magic[8];       //!< RANDLOG_MAGIC
+    uint32_t    headsize;       //!< sizeof(randlog_head_t)
+    uint32_t    recordsize;     //!< sizeof(randlog_event_t)
+    uint64_t    count;          //!< records taken, some of the last may be incomplete after a crash
+    uint64_t    tscHz;          //!< timestamp counts per second
+    uint64_t    tscBegin;       //!< timestamp at the open
+    uint32_t    seed;           //!< master seed of a deterministic run
+    uint32_t    algo;           //!< simulation algorithm
+    uint32_t    deterministic;  //!< 1: nTime is the logical time of the find, else ticks since the worker's last find
+    uint32_t    numbers;        //!< numbers per tick
+    uint32_t    streams;        //!< logical streams of a deterministic run
+    uint32_t    reserved[7];
+} randlog_head_t;
+
+/*!
+ *  \brief One found number.
+ */
+typedef struct
+{
+    uint64_t    magic;          //!< the found 64-bit number
+    uint64_t    nTime;          //!< as the message to the manager
+    uint64_t    stamp;          //!< tick of the stream, or of the worker
+    uint64_t    tsc;            //!< timestamp of the find
+    uint32_t    worker;         //!< worker index
+    uint16_t    stream;         //!< logical stream, 0 if not deterministic
+    uint8_t     heading;        //!< RANDLOG_HEADING_0 or RANDLOG_HEADING_1
+    uint8_t     valid;          //!< set last, 0 for a record never completed
+} randlog_event_t;
+
+typedef struct randlog randlog_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Create (truncate) an event log.
+ *
+ * \param path      : log file path
+ * \param head      : run description, magic, sizes, count and timestamps are set here
+ *
+ * \return the log, NULL if failed
+ */
+randlog_t *randlog_open(const char *path, const randlog_head_t *head);
+
+/*!
+ * \brief Append one record, from any thread. A record is taken by an
+ *       atomic add on the count, and written in place in the mapping, no
+ *       lock and no system call but when the file grows by a chunk.
+ *
+ * \return int
+ *          - 0     : successful
+ *          - others: the record is lost, the log is full or can't grow
+ */
+int randlog_append(randlog_t *log, uint64_t magic, uint64_t nTime, uint64_t stamp,
+        uint32_t worker, uint32_t stream, int heading);
+
+/*!
+ * \brief Cut the file to the records taken, sync and unmap it.
+ */
+void randlog_close(randlog_t *log);
+
+/*!
+ * \brief Timestamp of the records, the TSC on x86.
+ */
+uint64_t randlog_timestamp(void);
+
+#endif//_RANDLOG_H_
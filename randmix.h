@@ -0,0 +1,36 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDMIX_H_
+#define _RANDMIX_H_
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief The bit mixing steps the engines share for their seeding and
+ *       output, one copy inlined in each of them.
+ */
+static inline uint64_t randmix_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/*!
+ * \brief splitmix64 (Vigna): advance \a x by the golden gamma and return
+ *       its mix, the next word of a seed expanded from \a x.
+ */
+static inline uint64_t randmix_splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+#endif//_RANDMIX_H_
@@ -0,0 +1,269 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RANDNODES_X86   1
+#endif
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "os_wrapper.h"
+#include "randdist.h"
+#include "randmix.h"
+#include "randnodes.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDNODES_POWER_CHUNK
+ *    Normal samples drawn at a time for the hash powers.
+ */
+#define RANDNODES_POWER_CHUNK   1024
+
+typedef uint32_t (*randnodes_tick_t)(randnodes_t *rn, uint32_t i, uint32_t end,
+        randnodes_find_t *finds, uint32_t max, uint32_t *found);
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static inline uint64_t randnodes_next(uint64_t *s0, uint64_t *s1)
+{
+    uint64_t a = *s0, b = *s1;
+    uint64_t result = randmix_rotl(a + b, 17) + a;
+
+    b ^= a;
+    *s0 = randmix_rotl(a, 49) ^ b ^ (b << 21);
+    *s1 = randmix_rotl(b, 28);
+    return result;
+}
+
+static inline void randnodes_check(uint64_t number, uint32_t power, uint32_t node,
+        randnodes_find_t *finds, uint32_t *found)
+{
+    uint64_t threshold = (uint64_t)power << 16;
+
+    if (number < threshold) {
+        finds[*found].number = number;
+        finds[*found].node = node;
+        finds[*found].heading = 0;
+        (*found)++;
+    }
+    else if (~number < threshold) {
+        finds[*found].number = number;
+        finds[*found].node = node;
+        finds[*found].heading = 1;
+        (*found)++;
+    }
+}
+
+/*!
+ * \brief node by node, until the end or the finds are full
+ */
+static uint32_t randnodes_tick_scalar(randnodes_t *rn, uint32_t i, uint32_t end,
+        randnodes_find_t *finds, uint32_t max, uint32_t *found)
+{
+    for (; (i < end) && (*found < max); i++)
+        randnodes_check(randnodes_next(&rn->s0[i], &rn->s1[i]), rn->power[i], i, finds, found);
+    return i;
+}
+
+#if defined(RANDNODES_X86)
+/*!
+ * \brief 4 nodes per instruction. No unsigned 64-bit compare in AVX2, the
+ *        sign bits are flipped for the signed one. A vector is only
+ *        started with room for all its finds, the rare hits are sorted
+ *        out by the scalar check.
+ */
+__attribute__((target("avx2")))
+static uint32_t randnodes_tick_avx2(randnodes_t *rn, uint32_t i, uint32_t end,
+        randnodes_find_t *finds, uint32_t max, uint32_t *found)
+{
+#define RANDNODES_ROTL_AVX2(v, k) _mm256_or_si256(_mm256_slli_epi64(v, k), _mm256_srli_epi64(v, 64 - (k)))
+    const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    const __m256i nsign = _mm256_set1_epi64x(0x7fffffffffffffffLL);
+
+    for (; (i + 4 <= end) && (*found + 4 <= max); i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&rn->s0[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i *)&rn->s1[i]);
+        __m256i result = _mm256_add_epi64(RANDNODES_ROTL_AVX2(_mm256_add_epi64(a, b), 17), a);
+
+        b = _mm256_xor_si256(b, a);
+        a = _mm256_xor_si256(_mm256_xor_si256(RANDNODES_ROTL_AVX2(a, 49), b), _mm256_slli_epi64(b, 21));
+        b = RANDNODES_ROTL_AVX2(b, 28);
+        _mm256_storeu_si256((__m256i *)&rn->s0[i], a);
+        _mm256_storeu_si256((__m256i *)&rn->s1[i], b);
+
+        __m256i t = _mm256_xor_si256(_mm256_slli_epi64(
+                _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)&rn->power[i])), 16), sign);
+        __m256i hit0 = _mm256_cmpgt_epi64(t, _mm256_xor_si256(result, sign));     // number < threshold
+        __m256i hit1 = _mm256_cmpgt_epi64(t, _mm256_xor_si256(result, nsign));    // ~number < threshold
+        __m256i hit = _mm256_or_si256(hit0, hit1);
+        if (!_mm256_testz_si256(hit, hit)) {
+            alignas(32) uint64_t number[4];
+            _mm256_store_si256((__m256i *)number, result);
+            for (int l = 0; l < 4; l++)
+                randnodes_check(number[l], rn->power[i + l], i + l, finds, found);
+        }
+    }
+#undef RANDNODES_ROTL_AVX2
+    return randnodes_tick_scalar(rn, i, end, finds, max, found);
+}
+
+/*!
+ * \brief 8 nodes per instruction, native rotate and unsigned compare
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"     // _mm512_undefined_epi32() of the shift intrinsics
+__attribute__((target("avx512f")))
+static uint32_t randnodes_tick_avx512(randnodes_t *rn, uint32_t i, uint32_t end,
+        randnodes_find_t *finds, uint32_t max, uint32_t *found)
+{
+    const __m512i ones = _mm512_set1_epi64(-1);
+
+    for (; (i + 8 <= end) && (*found + 8 <= max); i += 8) {
+        __m512i a = _mm512_loadu_si512(&rn->s0[i]);
+        __m512i b = _mm512_loadu_si512(&rn->s1[i]);
+        __m512i result = _mm512_add_epi64(_mm512_rol_epi64(_mm512_add_epi64(a, b), 17), a);
+
+        b = _mm512_xor_si512(b, a);
+        a = _mm512_xor_si512(_mm512_xor_si512(_mm512_rol_epi64(a, 49), b), _mm512_slli_epi64(b, 21));
+        b = _mm512_rol_epi64(b, 28);
+        _mm512_storeu_si512(&rn->s0[i], a);
+        _mm512_storeu_si512(&rn->s1[i], b);
+
+        __m512i t = _mm512_slli_epi64(_mm512_cvtepu32_epi64(
+                _mm256_loadu_si256((const __m256i *)&rn->power[i])), 16);
+        __mmask8 hit = _mm512_cmplt_epu64_mask(result, t)
+                     | _mm512_cmplt_epu64_mask(_mm512_xor_si512(result, ones), t);
+        if (hit) {
+            alignas(64) uint64_t number[8];
+            _mm512_store_si512(number, result);
+            for (int l = 0; l < 8; l++)
+                randnodes_check(number[l], rn->power[i + l], i + l, finds, found);
+        }
+    }
+    return randnodes_tick_scalar(rn, i, end, finds, max, found);
+}
+#pragma GCC diagnostic pop
+#endif
+
+static randnodes_tick_t randnodes_tick_fn = NULL;
+static const char      *randnodes_isa_name = "scalar";
+
+static randnodes_tick_t randnodes_select(void)
+{
+    randnodes_tick_t tick = randnodes_tick_scalar;
+    const char      *isa = "scalar";
+
+#if defined(RANDNODES_X86)
+    if (__builtin_cpu_supports("avx512f")) {
+        tick = randnodes_tick_avx512;
+        isa = "AVX-512";
+    }
+    else if (__builtin_cpu_supports("avx2")) {
+        tick = randnodes_tick_avx2;
+        isa = "AVX2";
+    }
+#endif
+    randnodes_isa_name = isa;
+    __atomic_store_n(&randnodes_tick_fn, tick, __ATOMIC_RELEASE);
+    return tick;
+}
+
+static void *randnodes_alloc(size_t size)
+{
+    void *p = NULL;
+
+    if (0 != posix_memalign(&p, 64, size))
+        return NULL;
+    return p;
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randnodes_create(randnodes_t *rn, uint32_t nodes, uint64_t seed)
+{
+    memset(rn, 0, sizeof(*rn));
+    rn->s0 = (uint64_t *)randnodes_alloc(nodes * sizeof(uint64_t));
+    rn->s1 = (uint64_t *)randnodes_alloc(nodes * sizeof(uint64_t));
+    rn->power = (uint32_t *)randnodes_alloc(nodes * sizeof(uint32_t));
+    if ((rn->s0 == NULL) || (rn->s1 == NULL) || (rn->power == NULL)) {
+        syslog(LM_RAND, LOG_ERROR, "randnodes: no memory for %u nodes\n", nodes);
+        randnodes_destroy(rn);
+        return -1;
+    }
+    rn->nodes = nodes;
+
+    for (uint32_t i = 0; i < nodes; i++) {
+        uint64_t x = seed ^ ((uint64_t)i << 32) ^ i;
+        rn->s0[i] = randmix_splitmix64(&x);
+        rn->s1[i] = randmix_splitmix64(&x);
+        if ((rn->s0[i] | rn->s1[i]) == 0)       // the one state xoroshiro can't leave
+            rn->s1[i] = 1;
+        rn->power[i] = RANDNODES_POWER_ONE;
+    }
+    return 0;
+}
+
+void randnodes_destroy(randnodes_t *rn)
+{
+    free(rn->s0);
+    free(rn->s1);
+    free(rn->power);
+    memset(rn, 0, sizeof(*rn));
+}
+
+void randnodes_set_power(randnodes_t *rn, sfmt_t *sfmt, double sigma)
+{
+    double z[RANDNODES_POWER_CHUNK];
+
+    if (sigma <= 0.0) {
+        for (uint32_t i = 0; i < rn->nodes; i++)
+            rn->power[i] = RANDNODES_POWER_ONE;
+        return;
+    }
+    // exp(N(-sigma^2/2, sigma^2)) has mean 1
+    for (uint32_t i = 0; i < rn->nodes; i += RANDNODES_POWER_CHUNK) {
+        uint32_t n = rn->nodes - i;
+        if (n > RANDNODES_POWER_CHUNK)
+            n = RANDNODES_POWER_CHUNK;
+        randdist_fill_normal(sfmt, z, n, -0.5 * sigma * sigma, sigma);
+        for (uint32_t k = 0; k < n; k++) {
+            double power = RANDNODES_POWER_ONE * exp(z[k]) + 0.5;
+            rn->power[i + k] = (power >= 4294967295.0) ? 0xffffffffu : (uint32_t)power;
+        }
+    }
+}
+
+uint32_t randnodes_tick(randnodes_t *rn, uint32_t begin, uint32_t end,
+        randnodes_find_t *finds, uint32_t max, uint32_t *found)
+{
+    randnodes_tick_t tick = __atomic_load_n(&randnodes_tick_fn, __ATOMIC_ACQUIRE);
+    if (tick == NULL)
+        tick = randnodes_select();
+    *found = 0;
+    return tick(rn, begin, end, finds, max, found);
+}
+
+const char *randnodes_isa(void)
+{
+    if (__atomic_load_n(&randnodes_tick_fn, __ATOMIC_ACQUIRE) == NULL)
+        randnodes_select();
+    return randnodes_isa_name;
+}
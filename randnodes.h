@@ -0,0 +1,86 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDNODES_H_
+#define _RANDNODES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFMT.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDNODES_POWER_ONE
+ *    Hash power of a nominal node, whose number of a tick is found with
+ *    p = 2^-32 for each heading, like one number of the other algos.
+ */
+#define RANDNODES_POWER_ONE     65536u
+
+/*!
+ *  \brief One small generator per simulated node, xoroshiro128++ (Blackman
+ *         and Vigna), kept structure of arrays: word 0 of all the nodes,
+ *         then word 1, then the hash powers, 20 bytes per node. A tick
+ *         of a node range is one pass over the three arrays, 4 or 8
+ *         nodes per instruction.
+ */
+typedef struct
+{
+    uint32_t    nodes;
+    uint64_t   *s0;             //!< xoroshiro128++ state word 0 of each node
+    uint64_t   *s1;             //!< state word 1
+    uint32_t   *power;          //!< hash power, RANDNODES_POWER_ONE is nominal
+} randnodes_t;
+
+/*!
+ *  \brief A node whose number of the tick is below its threshold
+ *         (heading 0), or above the complement of it (heading 1).
+ */
+typedef struct
+{
+    uint64_t    number;
+    uint32_t    node;
+    uint32_t    heading;        //!< 0: leading 0, 1: leading 1
+} randnodes_find_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Allocate \a nodes nodes of nominal power, node i seeded by
+ *       splitmix64 of (\a seed, i).
+ * \return int - 0 : successful
+ */
+int randnodes_create(randnodes_t *rn, uint32_t nodes, uint64_t seed);
+
+void randnodes_destroy(randnodes_t *rn);
+
+/*!
+ * \brief Log-normal hash powers of spread \a sigma and mean 1, so the
+ *       expected finds of the whole network are the same as nominal.
+ *       sigma 0 gives every node the nominal power.
+ */
+void randnodes_set_power(randnodes_t *rn, sfmt_t *sfmt, double sigma);
+
+/*!
+ * \brief One number of each node of [begin, end): node i finds heading 0
+ *       if its number is below power[i] << 16, heading 1 if the complement
+ *       of the number is, so a nominal node finds exactly the numbers of
+ *       32bits leading 0 or 1. Stops after \a max finds.
+ * \return uint32_t - the node to continue from, \a end if all ticked
+ */
+uint32_t randnodes_tick(randnodes_t *rn, uint32_t begin, uint32_t end,
+        randnodes_find_t *finds, uint32_t max, uint32_t *found);
+
+/*!
+ * \brief Name of the instruction set randnodes_tick uses.
+ */
+const char *randnodes_isa(void);
+
+#endif//_RANDNODES_H_
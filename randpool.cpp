@@ -0,0 +1,493 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <stdlib.h>
+#   include <stdio.h>
+#   include <string.h>
+#   include <inttypes.h>
+#   include <signal.h>
+#   include <time.h>
+#	include <errno.h>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "os_wrapper.h"
+#include "randpool.h"
+
+/*!
+ * \def RANDPOOL_MAGIC
+ *    "RSPOOL01", written last by the server when the pool is ready.
+ */
+#define RANDPOOL_MAGIC          0x31304c4f4f505352ULL
+
+#define RANDPOOL_CACHELINE      64
+#define RANDPOOL_PAGE           4096
+
+/*!
+ * \def RANDPOOL_WAIT_MS
+ *    Server futex wait timeout, to check the running flag.
+ */
+#define RANDPOOL_WAIT_MS        100
+
+/*!
+ * \def RANDPOOL_RECLAIM_MS
+ *    A claimed block without its owner pid, the client died between the
+ *    claim and the pid store, is reclaimed after holding the ring so long.
+ */
+#define RANDPOOL_RECLAIM_MS     1000
+
+/*!
+ *  \brief Shared memory header, one cache line per hot counter.
+ */
+typedef struct {
+    uint64_t magic;             //!< RANDPOOL_MAGIC when ready
+    uint32_t blocks;            //!< ring size in blocks, power of 2
+    uint32_t blockw128;         //!< block size in 128-bit words
+    uint64_t size;              //!< total shared memory size
+    int32_t  pid;               //!< the server, written first
+
+    uint64_t head      __attribute__((aligned(RANDPOOL_CACHELINE)));  //!< next block to fill
+    uint64_t tail      __attribute__((aligned(RANDPOOL_CACHELINE)));  //!< next block to claim
+
+    uint32_t filled    __attribute__((aligned(RANDPOOL_CACHELINE)));  //!< futex, bumped on fill
+    uint32_t clientwaiters;     //!< clients sleeping on 'filled'
+
+    uint32_t freed     __attribute__((aligned(RANDPOOL_CACHELINE)));  //!< futex, bumped on release
+    uint32_t serverwaiters;     //!< server workers sleeping on 'freed'
+
+    uint64_t produced  __attribute__((aligned(RANDPOOL_CACHELINE)));  //!< blocks filled
+    uint64_t stalls;            //!< server waits for a free block
+    uint64_t reclaimed;         //!< blocks of dead clients released by the server
+} randpool_hdr_t;
+
+/*!
+ *  \brief Ring slot sequence, Vyukov's bounded queue protocol:
+ *         seq == pos     : free,   block pos can be filled
+ *         seq == pos + 1 : filled, block pos can be claimed
+ */
+typedef struct {
+    uint64_t seq  __attribute__((aligned(RANDPOOL_CACHELINE)));
+    int32_t  owner;             //!< pid of the client of a claimed block, 0 if none
+} randpool_slot_t;
+
+/*!
+ *  \brief Process local pool handle.
+ */
+struct randpool_s {
+    randpool_hdr_t  *hdr;       //!< shared header
+    randpool_slot_t *slots;     //!< shared slot array
+    w128_t          *data;      //!< shared blocks
+    size_t           size;      //!< mapped size
+    bool             owner;     //!< true on the server side
+    char             name[64];  //!< shared memory object name
+};
+
+/*!
+ *  \brief Shared job description of randpool_serve().
+ */
+typedef struct {
+    randpool_t     *pool;
+    uint32_t        seed;
+    volatile bool  *running;
+} randpool_job_t;
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static size_t randpool_slots_offset(void)
+{
+    return (sizeof(randpool_hdr_t) + RANDPOOL_CACHELINE - 1) & ~(size_t)(RANDPOOL_CACHELINE - 1);
+}
+
+static size_t randpool_data_offset(uint32_t blocks)
+{
+    size_t off = randpool_slots_offset() + blocks * sizeof(randpool_slot_t);
+    return (off + RANDPOOL_PAGE - 1) & ~(size_t)(RANDPOOL_PAGE - 1);
+}
+
+static void randpool_set_name(randpool_t *pool, const char *name)
+{
+    if (name[0] == '/')
+        snprintf(pool->name, sizeof(pool->name), "%s", name);
+    else
+        snprintf(pool->name, sizeof(pool->name), "/%s", name);
+}
+
+static void randpool_attach(randpool_t *pool, void *addr, size_t size)
+{
+    pool->hdr   = (randpool_hdr_t *)addr;
+    pool->slots = (randpool_slot_t *)((uint8_t *)addr + randpool_slots_offset());
+    pool->data  = (w128_t *)((uint8_t *)addr + randpool_data_offset(pool->hdr->blocks));
+    pool->size  = size;
+}
+
+static inline w128_t *randpool_block(randpool_t *pool, uint64_t pos)
+{
+    return pool->data + (pos & (pool->hdr->blocks - 1)) * (uint64_t)pool->hdr->blockw128;
+}
+
+/*!
+ * \brief A pool \a name already exists: remove it if it's stale, that is
+ *        its server is gone. A pool whose server is alive, or which can't
+ *        be checked, is kept.
+ * \return int - 0 : removed
+ */
+static int randpool_remove_stale(const char *name)
+{
+    struct stat st;
+    int32_t pid;
+    void *addr;
+    int   fd;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return (errno == ENOENT) ? 0 : -1;
+    if ((0 != fstat(fd, &st)) || ((size_t)st.st_size < sizeof(randpool_hdr_t))) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: %s exists and is no pool, remove /dev/shm%s by hand\n", name, name);
+        close(fd);
+        return -1;
+    }
+    addr = mmap(NULL, sizeof(randpool_hdr_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return -1;
+    pid = __atomic_load_n(&((randpool_hdr_t *)addr)->pid, __ATOMIC_ACQUIRE);
+    munmap(addr, sizeof(randpool_hdr_t));
+
+    if (pid <= 0) {
+        // being created, or its server died before it wrote the pid
+        syslog(LM_RAND, LOG_ERROR, "randpool: %s is not ready, remove /dev/shm%s by hand if no server runs\n", name, name);
+        return -1;
+    }
+    if ((0 == kill(pid, 0)) || (errno != ESRCH)) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: %s is served by pid %d\n", name, (int)pid);
+        return -1;
+    }
+    syslog(LM_RAND, LOG_WARNING, "randpool: %s of a stopped server (pid %d) is removed\n", name, (int)pid);
+    if ((0 != shm_unlink(name)) && (errno != ENOENT))
+        return -1;
+    return 0;
+}
+
+static uint64_t randpool_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/*!
+ * \brief Block \a ticket, the one the producers wait for, is claimed: if its
+ *        client is gone, release it in its place. \a since is when the
+ *        block was first seen claimed without an owner.
+ * \return bool - true if reclaimed
+ */
+static bool randpool_reclaim(randpool_t *pool, uint64_t ticket, uint64_t *since)
+{
+    randpool_hdr_t  *hdr  = pool->hdr;
+    randpool_slot_t *slot = &pool->slots[ticket & (hdr->blocks - 1)];
+    uint64_t filled = ticket + 1;
+    int32_t  owner;
+
+    if ((__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != filled)
+            || (__atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE) <= ticket))
+        return false;       // released, or not claimed yet
+
+    owner = __atomic_load_n(&slot->owner, __ATOMIC_ACQUIRE);
+    if (owner != 0) {
+        *since = 0;
+        if ((0 == kill(owner, 0)) || (errno != ESRCH))
+            return false;
+    }
+    else {
+        uint64_t now = randpool_now_ms();
+        if (*since == 0)
+            *since = now;
+        if (now - *since < RANDPOOL_RECLAIM_MS)
+            return false;
+    }
+
+    __atomic_store_n(&slot->owner, 0, __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&slot->seq, &filled, ticket + hdr->blocks, false,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return false;       // released meanwhile
+    *since = 0;
+    __atomic_fetch_add(&hdr->reclaimed, 1, __ATOMIC_RELAXED);
+    syslog(LM_RAND, LOG_WARNING, "randpool: block %" PRIu64 " of dead client %d reclaimed\n", ticket, (int)owner);
+    return true;
+}
+
+/*!
+ * \brief server worker: claim free blocks and fill them in place
+ */
+static void randpool_serve_entry(int worker, void *arg)
+{
+    randpool_job_t *job  = (randpool_job_t *)arg;
+    randpool_t     *pool = job->pool;
+    randpool_hdr_t *hdr  = pool->hdr;
+    uint32_t key[2];
+    sfmt_t   sfmt;
+    uint64_t orphanSince = 0;
+
+    key[0] = job->seed;
+    key[1] = (uint32_t)worker;
+    sfmt_init_by_array(&sfmt, key, 2);
+
+    while (*job->running) {
+        uint64_t pos = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+        randpool_slot_t *slot = &pool->slots[pos & (hdr->blocks - 1)];
+        int64_t dif = (int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (dif == 0) {
+            if (!__atomic_compare_exchange_n(&hdr->head, &pos, pos + 1, false,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                continue;
+
+            sfmt_fill_array64(&sfmt, (uint64_t *)randpool_block(pool, pos), hdr->blockw128 * 2);
+            __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+            __atomic_fetch_add(&hdr->produced, 1, __ATOMIC_RELAXED);
+
+            __atomic_fetch_add(&hdr->filled, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&hdr->clientwaiters, __ATOMIC_SEQ_CST) != 0)
+                futex_wake(&hdr->filled, 0, true);
+        }
+        else if (dif < 0) {
+            // ring is full, wait for the clients to release a block
+            // a client killed between claim and release holds its block for ever
+            if (randpool_reclaim(pool, pos - hdr->blocks, &orphanSince))
+                continue;
+            uint32_t freed = __atomic_load_n(&hdr->freed, __ATOMIC_SEQ_CST);
+            __atomic_fetch_add(&hdr->serverwaiters, 1, __ATOMIC_SEQ_CST);
+            if ((int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) - pos) < 0) {
+                __atomic_fetch_add(&hdr->stalls, 1, __ATOMIC_RELAXED);
+                futex_wait(&hdr->freed, freed, true, RANDPOOL_WAIT_MS);
+            }
+            __atomic_fetch_sub(&hdr->serverwaiters, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+randpool_t *randpool_create(const char *name, uint32_t blocks, uint32_t blockw128)
+{
+    randpool_t *pool;
+    size_t size;
+    void  *addr;
+    int    fd;
+
+    if (blocks == 0)
+        blocks = RANDPOOL_BLOCKS;
+    if (blockw128 == 0)
+        blockw128 = RANDPOOL_BLOCK_W128;
+    if ((name == NULL) || ((blocks & (blocks - 1)) != 0) || (blockw128 < SFMT_N)) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: invalid parameters\n");
+        return NULL;
+    }
+
+    pool = new randpool_t;
+    randpool_set_name(pool, name);
+    pool->owner = true;
+
+    size = randpool_data_offset(blocks) + (size_t)blocks * blockw128 * sizeof(w128_t);
+
+    // only the user of the server reads or writes the blocks
+    fd = shm_open(pool->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if ((fd < 0) && (errno == EEXIST) && (0 == randpool_remove_stale(pool->name)))
+        fd = shm_open(pool->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: shm_open %s failed. %s\n", pool->name, strerror(errno));
+        delete pool;
+        return NULL;
+    }
+    if (0 != ftruncate(fd, (off_t)size)) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: resize %s failed. %s\n", pool->name, strerror(errno));
+        close(fd);
+        shm_unlink(pool->name);
+        delete pool;
+        return NULL;
+    }
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: mmap %s failed. %s\n", pool->name, strerror(errno));
+        shm_unlink(pool->name);
+        delete pool;
+        return NULL;
+    }
+
+    // shared memory object is zero filled
+    randpool_hdr_t *hdr = (randpool_hdr_t *)addr;
+    __atomic_store_n(&hdr->pid, (int32_t)getpid(), __ATOMIC_RELEASE);
+    hdr->blocks    = blocks;
+    hdr->blockw128 = blockw128;
+    hdr->size      = size;
+    randpool_attach(pool, addr, size);
+    for (uint32_t i = 0; i < blocks; i++)
+        pool->slots[i].seq = i;
+
+    __atomic_store_n(&hdr->magic, RANDPOOL_MAGIC, __ATOMIC_RELEASE);
+
+    return pool;
+}
+
+int randpool_serve(randpool_t *pool, int workers, uint32_t seed, volatile bool *running)
+{
+    randpool_job_t job;
+
+    if ((pool == NULL) || !pool->owner || (running == NULL)) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: serve on an invalid pool\n");
+        return -1;
+    }
+
+    job.pool    = pool;
+    job.seed    = seed;
+    job.running = running;
+
+    return thread_parallel(workers, randpool_serve_entry, &job);
+}
+
+void randpool_destroy(randpool_t *pool)
+{
+    if (pool == NULL)
+        return;
+
+    // wake up the clients, they will see the pool is gone on next claim
+    __atomic_store_n(&pool->hdr->magic, 0, __ATOMIC_RELEASE);
+    munmap(pool->hdr, pool->size);
+    shm_unlink(pool->name);
+    delete pool;
+}
+
+randpool_t *randpool_open(const char *name)
+{
+    randpool_t *pool;
+    struct stat st;
+    void *addr;
+    int   fd;
+
+    if (name == NULL)
+        return NULL;
+
+    pool = new randpool_t;
+    randpool_set_name(pool, name);
+    pool->owner = false;
+
+    fd = shm_open(pool->name, O_RDWR, 0);
+    if (fd < 0) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: shm_open %s failed. %s\n", pool->name, strerror(errno));
+        delete pool;
+        return NULL;
+    }
+    if ((0 != fstat(fd, &st)) || ((size_t)st.st_size < sizeof(randpool_hdr_t))) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: %s is not ready\n", pool->name);
+        close(fd);
+        delete pool;
+        return NULL;
+    }
+    addr = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: mmap %s failed. %s\n", pool->name, strerror(errno));
+        delete pool;
+        return NULL;
+    }
+
+    randpool_hdr_t *hdr = (randpool_hdr_t *)addr;
+    if ((__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != RANDPOOL_MAGIC)
+            || (hdr->size != (uint64_t)st.st_size)) {
+        syslog(LM_RAND, LOG_ERROR, "randpool: %s is not a valid pool\n", pool->name);
+        munmap(addr, (size_t)st.st_size);
+        delete pool;
+        return NULL;
+    }
+
+    randpool_attach(pool, addr, (size_t)st.st_size);
+    return pool;
+}
+
+const w128_t *randpool_claim(randpool_t *pool, uint64_t *ticket, bool nowait)
+{
+    randpool_hdr_t *hdr = pool->hdr;
+
+    for (;;) {
+        uint64_t pos = __atomic_load_n(&hdr->tail, __ATOMIC_RELAXED);
+        randpool_slot_t *slot = &pool->slots[pos & (hdr->blocks - 1)];
+        int64_t dif = (int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&hdr->tail, &pos, pos + 1, false,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                __atomic_store_n(&slot->owner, (int32_t)getpid(), __ATOMIC_RELEASE);
+                *ticket = pos;
+                return randpool_block(pool, pos);
+            }
+        }
+        else if (dif < 0) {
+            // pool is empty
+            if (nowait || (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != RANDPOOL_MAGIC))
+                return NULL;
+
+            uint32_t filled = __atomic_load_n(&hdr->filled, __ATOMIC_SEQ_CST);
+            __atomic_fetch_add(&hdr->clientwaiters, 1, __ATOMIC_SEQ_CST);
+            if ((int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) - (pos + 1)) < 0)
+                futex_wait(&hdr->filled, filled, true, RANDPOOL_WAIT_MS);
+            __atomic_fetch_sub(&hdr->clientwaiters, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+}
+
+void randpool_release(randpool_t *pool, uint64_t ticket)
+{
+    randpool_hdr_t  *hdr  = pool->hdr;
+    randpool_slot_t *slot = &pool->slots[ticket & (hdr->blocks - 1)];
+    uint64_t filled = ticket + 1;
+
+    // the server may have reclaimed it already, if this client looked dead
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != filled)
+        return;
+    __atomic_store_n(&slot->owner, 0, __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&slot->seq, &filled, ticket + hdr->blocks, false,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return;
+
+    __atomic_fetch_add(&hdr->freed, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&hdr->serverwaiters, __ATOMIC_SEQ_CST) != 0)
+        futex_wake(&hdr->freed, 0, true);
+}
+
+uint32_t randpool_block_size(randpool_t *pool)
+{
+    return pool->hdr->blockw128;
+}
+
+void randpool_get_stat(randpool_t *pool, randpool_stat_t *stat)
+{
+    stat->produced = __atomic_load_n(&pool->hdr->produced, __ATOMIC_RELAXED);
+    stat->consumed = __atomic_load_n(&pool->hdr->tail, __ATOMIC_RELAXED);
+    stat->stalls   = __atomic_load_n(&pool->hdr->stalls, __ATOMIC_RELAXED);
+    stat->reclaimed = __atomic_load_n(&pool->hdr->reclaimed, __ATOMIC_RELAXED);
+}
+
+void randpool_close(randpool_t *pool)
+{
+    if (pool == NULL)
+        return;
+
+    munmap(pool->hdr, pool->size);
+    delete pool;
+}
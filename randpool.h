@@ -0,0 +1,134 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDPOOL_H_
+#define _RANDPOOL_H_
+
+#include <stdint.h>
+#include "SFMT.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDPOOL_BLOCKS
+ *    Default number of blocks in the shared ring, must be power of 2.
+ */
+#define RANDPOOL_BLOCKS         256
+
+/*!
+ * \def RANDPOOL_BLOCK_W128
+ *    Default block size in 128-bit words (64KB), at least SFMT_N.
+ */
+#define RANDPOOL_BLOCK_W128     4096
+
+/*!
+ *  \brief Random pool handle, for both the server and the clients.
+ *
+ *  The pool is a POSIX shared memory ring of fixed size w128_t blocks.
+ *  Server workers claim free blocks and fill them in place by
+ *  sfmt_fill_array64, clients claim filled blocks, read them in place and
+ *  release them. Claim and release are lock-free; futex is only called
+ *  when the ring is empty (client waits) or full (server waits, that is
+ *  the backpressure when the clients fall behind).
+ */
+typedef struct randpool_s randpool_t;
+
+/*!
+ *  \brief Pool counters, all of them are in blocks.
+ */
+typedef struct
+{
+    uint64_t    produced;       //!< blocks filled by the server
+    uint64_t    consumed;       //!< blocks claimed by the clients
+    uint64_t    stalls;         //!< times the server waited for a free block
+    uint64_t    reclaimed;      //!< blocks of dead clients released by the server
+} randpool_stat_t;
+
+/*------------------------------------------------------------------
+ * Server side
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Create the shared memory pool \a name, readable and writable by
+ *        the user of the server only. A pool of the same name is taken
+ *        over only if its server is gone, an alive one makes it fail.
+ *
+ * \param name      : shared memory object name, such as "/randsim"
+ * \param blocks    : ring size in blocks, power of 2, 0 for default
+ * \param blockw128 : block size in 128-bit words, 0 for default
+ *
+ * \return pool handle, NULL on failure
+ */
+randpool_t *randpool_create(const char *name, uint32_t blocks, uint32_t blockw128);
+
+/*!
+ * \brief Fill the pool continuously with \a workers threads, until
+ *        *running becomes false. Worker i uses the key {seed, i}.
+ *
+ * \return int
+ *          - 0     : successful
+ *          - others: failure
+ */
+int randpool_serve(randpool_t *pool, int workers, uint32_t seed, volatile bool *running);
+
+/*!
+ * \brief Unmap and remove the shared memory pool.
+ */
+void randpool_destroy(randpool_t *pool);
+
+/*------------------------------------------------------------------
+ * Client side
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Attach to an existing pool \a name.
+ *
+ * \return pool handle, NULL on failure
+ */
+randpool_t *randpool_open(const char *name);
+
+/*!
+ * \brief Claim one filled block, waiting if the pool is empty.
+ *        The block stays owned by the caller until randpool_release().
+ *
+ * \param pool      : pool handle
+ * \param ticket    : output ticket, to be given to randpool_release()
+ * \param nowait    : true if don't want wait
+ *
+ * \return pointer to the block in shared memory, NULL if nowait and empty
+ */
+const w128_t *randpool_claim(randpool_t *pool, uint64_t *ticket, bool nowait);
+
+/*!
+ * \brief Give back a block claimed by randpool_claim().
+ *
+ *        A client killed before it releases a block would hold the ring
+ *        for ever: the claim stores the client pid in the block's slot,
+ *        and the server releases the block itself once that pid is gone
+ *        (same pid namespace as the server), or after RANDPOOL_RECLAIM_MS
+ *        if the client died before it stored the pid. A client stopped
+ *        that long inside randpool_claim() may so lose its block, its
+ *        release is then ignored.
+ */
+void randpool_release(randpool_t *pool, uint64_t ticket);
+
+/*!
+ * \brief Block size in 128-bit words.
+ */
+uint32_t randpool_block_size(randpool_t *pool);
+
+/*!
+ * \brief Read the pool counters.
+ */
+void randpool_get_stat(randpool_t *pool, randpool_stat_t *stat);
+
+/*!
+ * \brief Detach from the pool, the shared memory object is kept.
+ */
+void randpool_close(randpool_t *pool);
+
+#endif//_RANDPOOL_H_
@@ -0,0 +1,396 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "os_wrapper.h"
+#include "randsched.h"
+#include "randsim.h"
+#include "randproc.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+#define RANDPROC_PAGE           4096
+#define RANDPROC_CACHELINE      64
+
+/*!
+ * \def RANDPROC_EVENTS
+ *    Events of the ring of a worker process, power of 2. A full ring drops
+ *    the event, its find is still in the counters and histograms.
+ */
+#define RANDPROC_EVENTS         1024
+
+/*!
+ * \def RANDPROC_ROUND_MS
+ *    Coordinator round: drain the rings, reap the dead workers.
+ */
+#define RANDPROC_ROUND_MS       10
+
+/*!
+ * \def RANDPROC_STOP_MS
+ *    Time the workers have to see the stop flag before they're killed.
+ */
+#define RANDPROC_STOP_MS        2000
+
+/*!
+ *  \brief What a worker process publishes, only written by it and page
+ *         aligned, so its pages are first touched on the worker's node.
+ *         A restarted worker goes on with the counters of the dead one.
+ */
+typedef struct
+{
+    uint64_t            ticks;
+    uint64_t            found[2];
+    uint64_t            dropped;
+    uint64_t            eventHead   __attribute__((aligned(RANDPROC_CACHELINE)));
+    uint64_t            occurrence[2][RANDPROC_GRIDS] __attribute__((aligned(RANDPROC_CACHELINE)));
+    randproc_event_t    events[RANDPROC_EVENTS];
+} __attribute__((aligned(RANDPROC_PAGE))) randproc_slot_t;
+
+/*!
+ *  \brief A worker process as the coordinator sees it, only written by the
+ *         coordinator.
+ */
+typedef struct
+{
+    int32_t     pid;            //!< 0 once reaped
+    int32_t     node;           //!< -1 if not placed
+    uint64_t    stream;         //!< substream of the seed
+    uint64_t    eventTail       __attribute__((aligned(RANDPROC_CACHELINE)));
+} randproc_proc_t;
+
+/*!
+ *  \brief The shared segment, mapped before the forks.
+ */
+typedef struct
+{
+    uint32_t            stop;       //!< set by the coordinator, workers quit
+    uint32_t            procs;
+    uint32_t            numbers;
+    int32_t             algo;
+    uint64_t            seed;
+    randproc_proc_t     proc[RANDPROC_MAX];
+} randproc_shm_t;
+
+/*!
+ * \def RANDPROC_SHM_HEAD
+ *    The slots follow the header, from its next page.
+ */
+#define RANDPROC_SHM_HEAD       ((sizeof(randproc_shm_t) + RANDPROC_PAGE - 1) & ~(size_t)(RANDPROC_PAGE - 1))
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static inline randproc_slot_t *randproc_slot(randproc_shm_t *shm, uint32_t p)
+{
+    return (randproc_slot_t *)((char *)shm + RANDPROC_SHM_HEAD) + p;
+}
+
+/*!
+ * \brief Pin the calling process to the cpus of \a node.
+ */
+static void randproc_place(int node)
+{
+    int cpus[RANDSCHED_CPUS];
+    int n = randsched_numa_cpus(node, cpus, RANDSCHED_CPUS);
+    cpu_set_t set;
+
+    if (n <= 0)
+        return;
+    CPU_ZERO(&set);
+    for (int i = 0; i < n; i++)
+        CPU_SET(cpus[i], &set);
+    if (0 != sched_setaffinity(0, sizeof(set), &set))
+        syslog(LM_RAND, LOG_WARNING, "randproc: pid %d not placed on node %d, errno=%d\n", (int)getpid(), node, errno);
+}
+
+/*!
+ * \brief Count a find in the slot, its interval grid as the threads mode.
+ */
+static inline void randproc_count(randproc_slot_t *slot, uint64_t nTime, uint32_t heading)
+{
+    uint64_t grid = nTime >> 8;
+
+    __atomic_store_n(&slot->found[heading], slot->found[heading] + 1, __ATOMIC_RELAXED);
+    if (grid > RANDPROC_GRIDS - 1)
+        grid = RANDPROC_GRIDS - 1;
+    __atomic_store_n(&slot->occurrence[heading][grid], slot->occurrence[heading][grid] + 1, __ATOMIC_RELAXED);
+}
+
+/*!
+ * \brief Body of a worker process: scan its substream tick by tick until
+ *       the stop flag, never returns.
+ */
+static void randproc_worker(randproc_shm_t *shm, uint32_t p)
+{
+    randproc_proc_t *proc = &shm->proc[p];
+    randproc_slot_t *slot = randproc_slot(shm, p);
+    uint32_t numbers = shm->numbers;
+    uint64_t *array64 = NULL;
+    uint64_t nTime[2] = {0, 0};
+
+    // the coordinator gone, the worker goes too
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (__atomic_load_n(&shm->stop, __ATOMIC_ACQUIRE) || (getppid() == 1))
+        _exit(0);
+
+    if (proc->node >= 0)
+        randproc_place(proc->node);
+
+    randsim_gen_t *gen = randsim_gen_create(shm->algo, shm->seed, proc->stream);
+    if ((gen == NULL) || (0 != posix_memalign((void **)&array64, RANDPROC_PAGE, numbers * sizeof(uint64_t)))){
+        syslog(LM_RAND, LOG_ERROR, "randproc: worker %u out of memory\n", p);
+        _exit(1);
+    }
+    // first touch, after the placement, so the buffer is on the local node
+    randsched_prefault(array64, numbers * sizeof(uint64_t));
+
+    while (!__atomic_load_n(&shm->stop, __ATOMIC_RELAXED)){
+        bool found[2] = {false, false};
+        uint64_t tick = slot->ticks;
+
+        randsim_gen_fill(gen, array64, numbers);
+        for (uint32_t i = 0; i < numbers; i++){
+            uint32_t high = (uint32_t)(array64[i] >> 32);
+            if ((uint32_t)(high + 1) > 1)
+                continue;
+            uint32_t heading = (high != 0) ? 1 : 0;
+            uint64_t head = slot->eventHead;
+
+            randproc_count(slot, nTime[heading], heading);
+            found[heading] = true;
+            if (head - __atomic_load_n(&proc->eventTail, __ATOMIC_ACQUIRE) >= RANDPROC_EVENTS){
+                __atomic_store_n(&slot->dropped, slot->dropped + 1, __ATOMIC_RELAXED);
+                continue;
+            }
+            randproc_event_t *ev = &slot->events[head & (RANDPROC_EVENTS - 1)];
+            ev->number = array64[i];
+            ev->nTime = nTime[heading];
+            ev->tick = tick;
+            ev->heading = heading;
+            ev->proc = p;
+            __atomic_store_n(&slot->eventHead, head + 1, __ATOMIC_RELEASE);
+        }
+
+        __atomic_store_n(&slot->ticks, tick + 1, __ATOMIC_RELAXED);
+        for (int h = 0; h < 2; h++)
+            nTime[h] = found[h] ? 0 : nTime[h] + 1;
+    }
+
+    randsim_gen_destroy(gen);
+    free(array64);
+    _exit(0);
+}
+
+/*!
+ * \brief Fork the worker of slot \a p.
+ * \return int - 0 : successful
+ */
+static int randproc_spawn(randproc_shm_t *shm, uint32_t p)
+{
+    pid_t pid;
+
+    fflush(NULL);       // no buffered output written twice
+    pid = fork();
+    if (pid < 0){
+        syslog(LM_RAND, LOG_ERROR, "randproc: fork of worker %u failed, errno=%d\n", p, errno);
+        return -1;
+    }
+    if (pid == 0)
+        randproc_worker(shm, p);
+
+    shm->proc[p].pid = (int32_t)pid;
+    return 0;
+}
+
+/*!
+ * \brief Hand the events of slot \a p to \a fn.
+ * \return int - non 0 if \a fn asked to stop
+ */
+static int randproc_drain(randproc_shm_t *shm, uint32_t p, randproc_event_fn fn, void *ctx)
+{
+    randproc_proc_t *proc = &shm->proc[p];
+    randproc_slot_t *slot = randproc_slot(shm, p);
+    uint64_t head = __atomic_load_n(&slot->eventHead, __ATOMIC_ACQUIRE);
+    uint64_t tail = proc->eventTail;
+    int stop = 0;
+
+    while ((tail != head) && !stop){
+        randproc_event_t ev = slot->events[tail & (RANDPROC_EVENTS - 1)];
+        __atomic_store_n(&proc->eventTail, ++tail, __ATOMIC_RELEASE);
+        stop = fn(&ev, ctx);
+    }
+    return stop;
+}
+
+static void randproc_merge(randproc_shm_t *shm, randproc_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    for (uint32_t p = 0; p < shm->procs; p++){
+        randproc_slot_t *slot = randproc_slot(shm, p);
+        result->ticks += __atomic_load_n(&slot->ticks, __ATOMIC_RELAXED);
+        result->dropped += __atomic_load_n(&slot->dropped, __ATOMIC_RELAXED);
+        for (int h = 0; h < 2; h++){
+            result->found[h] += __atomic_load_n(&slot->found[h], __ATOMIC_RELAXED);
+            for (int g = 0; g < RANDPROC_GRIDS; g++)
+                result->occurrence[h][g] += __atomic_load_n(&slot->occurrence[h][g], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*!
+ * \brief Reap the workers which ended, restart those which died unless
+ *       the run is stopping.
+ * \return int - workers alive
+ */
+static int randproc_reap(randproc_shm_t *shm, uint32_t *restarts, uint64_t *nextStream,
+        randproc_event_fn fn, void *ctx)
+{
+    int status, alive = 0;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0){
+        uint32_t p;
+        for (p = 0; (p < shm->procs) && (shm->proc[p].pid != pid); p++)
+            ;
+        if (p == shm->procs)
+            continue;
+        shm->proc[p].pid = 0;
+        if (__atomic_load_n(&shm->stop, __ATOMIC_RELAXED))
+            continue;
+
+        if (WIFSIGNALED(status))
+            syslog(LM_RAND, LOG_ERROR, "randproc: worker %u (pid %d, stream %" PRIu64 ") killed by signal %d\n",
+                    p, (int)pid, shm->proc[p].stream, WTERMSIG(status));
+        else
+            syslog(LM_RAND, LOG_ERROR, "randproc: worker %u (pid %d, stream %" PRIu64 ") exited with %d\n",
+                    p, (int)pid, shm->proc[p].stream, WEXITSTATUS(status));
+
+        // what it published is kept, the new worker takes a stream never used
+        randproc_drain(shm, p, fn, ctx);
+        if (*restarts >= RANDPROC_RESTARTS){
+            syslog(LM_RAND, LOG_ERROR, "randproc: %u restarts already, worker %u left out\n", *restarts, p);
+            continue;
+        }
+        (*restarts)++;
+        shm->proc[p].stream = (*nextStream)++;
+        randproc_spawn(shm, p);
+    }
+
+    for (uint32_t p = 0; p < shm->procs; p++)
+        if (shm->proc[p].pid != 0)
+            alive++;
+    return alive;
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randproc_run(const randproc_config_t *cfg, randproc_event_fn fn, void *ctx,
+        randproc_result_t *result)
+{
+    randproc_shm_t *shm;
+    size_t size;
+    int nodes = cfg->numa ? randsched_numa_nodes() : 1;
+    uint32_t restarts = 0;
+    uint64_t nextStream = (uint64_t)cfg->procs;
+    uint64_t beginNs, lastNs, lastTicks = 0;
+    int stop = 0, alive;
+
+    if ((cfg->procs <= 0) || (cfg->procs > RANDPROC_MAX) || (cfg->numbers == 0) || (fn == NULL)){
+        syslog(LM_RAND, LOG_ERROR, "randproc: invalid settings, procs=%d\n", cfg->procs);
+        return -1;
+    }
+
+    size = RANDPROC_SHM_HEAD + (size_t)cfg->procs * sizeof(randproc_slot_t);
+    shm = (randproc_shm_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED){
+        syslog(LM_RAND, LOG_ERROR, "randproc: shared segment of %zu bytes failed, errno=%d\n", size, errno);
+        return -1;
+    }
+    shm->procs = (uint32_t)cfg->procs;
+    shm->numbers = cfg->numbers;
+    shm->algo = cfg->algo;
+    shm->seed = cfg->seed;
+
+    syslog(LM_RAND, LOG_VERBOSE, "\nmulti process run: %d processes on %d NUMA node(s), %u numbers a tick\n",
+            cfg->procs, nodes, cfg->numbers);
+
+    beginNs = lastNs = randsched_now_ns();
+    for (int p = 0; p < cfg->procs; p++){
+        shm->proc[p].node = cfg->numa ? (p % nodes) : -1;
+        shm->proc[p].stream = (uint64_t)p;
+        if (0 != randproc_spawn(shm, (uint32_t)p)){
+            stop = 1;
+            break;
+        }
+    }
+
+    // coordinator: events to the caller, dead workers restarted, a status every second
+    while (!stop){
+        usleep(RANDPROC_ROUND_MS * 1000);
+        for (uint32_t p = 0; (p < shm->procs) && !stop; p++)
+            stop = randproc_drain(shm, p, fn, ctx);
+        if (!stop)
+            stop = fn(NULL, ctx);
+        alive = randproc_reap(shm, &restarts, &nextStream, fn, ctx);
+        if (alive == 0){
+            syslog(LM_RAND, LOG_ERROR, "randproc: no worker left, the run stops.\n");
+            break;
+        }
+
+        uint64_t now = randsched_now_ns();
+        if (now - lastNs >= 1000000000ULL){
+            randproc_merge(shm, result);
+            syslog(LM_RAND, LOG_VERBOSE, "processes: alive=%d, speed=%" PRIu64 " (M/s), found %" PRIu64 "/%" PRIu64 ", restarts=%u\n",
+                    alive, (result->ticks - lastTicks) * cfg->numbers * 1000 / (now - lastNs),
+                    result->found[0], result->found[1], restarts);
+            lastTicks = result->ticks;
+            lastNs = now;
+        }
+    }
+
+    // stop: the flag first, the workers left after RANDPROC_STOP_MS are killed
+    __atomic_store_n(&shm->stop, 1, __ATOMIC_RELEASE);
+    for (int waited = 0; waited < RANDPROC_STOP_MS; waited += RANDPROC_ROUND_MS){
+        if (randproc_reap(shm, &restarts, &nextStream, fn, ctx) == 0)
+            break;
+        usleep(RANDPROC_ROUND_MS * 1000);
+    }
+    for (uint32_t p = 0; p < shm->procs; p++){
+        if (shm->proc[p].pid != 0){
+            syslog(LM_RAND, LOG_WARNING, "randproc: worker %u (pid %d) doesn't stop, killed\n", p, shm->proc[p].pid);
+            kill(shm->proc[p].pid, SIGKILL);
+            waitpid(shm->proc[p].pid, NULL, 0);
+            shm->proc[p].pid = 0;
+        }
+    }
+
+    randproc_merge(shm, result);
+    result->restarts = restarts;
+    result->seconds = (double)(randsched_now_ns() - beginNs) / 1e9;
+    munmap(shm, size);
+    return 0;
+}
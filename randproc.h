@@ -0,0 +1,98 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDPROC_H_
+#define _RANDPROC_H_
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDPROC_MAX
+ *    Worker processes of a run.
+ */
+#define RANDPROC_MAX            256
+
+/*!
+ * \def RANDPROC_GRIDS
+ *    Interval grids of the histograms, the ticks >> 8 as the threads mode.
+ */
+#define RANDPROC_GRIDS          256
+
+/*!
+ * \def RANDPROC_RESTARTS
+ *    Worker processes restarted at most in a run, so a worker which
+ *    always crashes doesn't fork forever.
+ */
+#define RANDPROC_RESTARTS       64
+
+/*!
+ *  \brief Settings of a multi process run.
+ */
+typedef struct
+{
+    int         procs;          //!< worker processes, 1 .. RANDPROC_MAX
+    int         algo;           //!< a number generator of randsim.h
+    uint64_t    seed;           //!< process i draws stream i of the seed
+    uint32_t    numbers;        //!< numbers of a tick
+    bool        numa;           //!< process i on the cpus of node i mod nodes
+} randproc_config_t;
+
+/*!
+ *  \brief A number of a worker process with 32bits leading 0 (heading 0)
+ *         or 1 (heading 1), \a nTime ticks of that process after its
+ *         previous one of the same heading.
+ */
+typedef struct
+{
+    uint64_t    number;
+    uint64_t    nTime;
+    uint64_t    tick;           //!< tick of the process
+    uint32_t    heading;
+    uint32_t    proc;
+} randproc_event_t;
+
+/*!
+ *  \brief The counters of all the worker processes, merged. Those of a
+ *         crashed worker are kept, they are in the shared segment.
+ */
+typedef struct
+{
+    uint64_t    ticks;
+    uint64_t    found[2];
+    uint64_t    dropped;        //!< events not taken, the histograms have them
+    uint64_t    occurrence[2][RANDPROC_GRIDS];
+    uint32_t    restarts;
+    double      seconds;
+} randproc_result_t;
+
+/*!
+ * \brief Called by the coordinator for each event, in the order of each
+ *        process, and with \a ev NULL every round of it (10ms) so the
+ *        caller can check its own stop conditions.
+ * \return int - non 0 to stop the run
+ */
+typedef int (*randproc_event_fn)(const randproc_event_t *ev, void *ctx);
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Fork \a cfg->procs worker processes, each scanning its own
+ *       substream and publishing its counters, histograms and events
+ *       into a shared segment, and coordinate them until \a fn asks to
+ *       stop: the events are handed to \a fn, the merged counters are
+ *       logged every second, a worker which dies is restarted on a new
+ *       substream.
+ * \return int - 0 : successful
+ */
+int randproc_run(const randproc_config_t *cfg, randproc_event_fn fn, void *ctx,
+        randproc_result_t *result);
+
+#endif//_RANDPROC_H_
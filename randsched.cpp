@@ -0,0 +1,359 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "os_wrapper.h"
+#include "randsched.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+#define RANDSCHED_SYSFS_CPU     "/sys/devices/system/cpu/"
+#define RANDSCHED_ITEM_LEN      64
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief "2-5,7" (sysfs) or "2-5:7" (profile) to a cpu list, the cpus
+ *       already in it are skipped.
+ * \return int - number of the cpus in \a cpus, -1 if it's not a list
+ */
+static int randsched_cpulist(const char *list, char sep, int *cpus, int n, int max)
+{
+    const char *p = list;
+
+    while ((*p != '\0') && (*p != '\n')) {
+        char *end;
+        long first = strtol(p, &end, 10), last;
+        if ((end == p) || (first < 0))
+            return -1;
+        last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if ((end == p + 1) || (last < first))
+                return -1;
+            p = end;
+        }
+        for (long c = first; (c <= last) && (c < CPU_SETSIZE); c++) {
+            int k;
+            for (k = 0; (k < n) && (cpus[k] != c); k++)
+                ;
+            if ((k == n) && (n < max))
+                cpus[n++] = (int)c;
+        }
+        if (*p == sep)
+            p++;
+        else if ((*p != '\0') && (*p != '\n'))
+            return -1;
+    }
+    return n;
+}
+
+/*!
+ * \brief the cpu list of a sysfs file, none if the file is missing, empty
+ *       or "(null)" (nohz_full of the kernels without it)
+ */
+static int randsched_sysfs_cpus(const char *name, int *cpus, int max)
+{
+    char line[1024];
+    FILE *f = fopen(name, "r");
+    int n = 0;
+
+    if (f == NULL)
+        return 0;
+    if ((fgets(line, sizeof(line), f) != NULL) && (line[0] >= '0') && (line[0] <= '9'))
+        n = randsched_cpulist(line, ',', cpus, 0, max);
+    fclose(f);
+    return (n < 0) ? 0 : n;
+}
+
+static int randsched_parse_role(thread_sched_t *sched, const char *value)
+{
+    static const struct { const char *name; int policy; } policies[] = {
+        {"other", SCHED_OTHER}, {"batch", SCHED_BATCH}, {"fifo", SCHED_FIFO}, {"rr", SCHED_RR},
+    };
+    char name[RANDSCHED_ITEM_LEN];
+    size_t len = strcspn(value, ":");
+    int p;
+
+    if (len >= sizeof(name))
+        return -1;
+    memcpy(name, value, len);
+    name[len] = '\0';
+    for (p = 0; p < (int)(sizeof(policies) / sizeof(policies[0])); p++) {
+        if (0 == strcmp(name, policies[p].name))
+            break;
+    }
+    if (p == (int)(sizeof(policies) / sizeof(policies[0])))
+        return -1;
+
+    sched->policy = policies[p].policy;
+    sched->priority = 0;
+    sched->nice = 0;
+    if (value[len] == ':') {
+        char *end;
+        sched->priority = (int)strtol(value + len + 1, &end, 10);
+        if (*end == ':')
+            sched->nice = (int)strtol(end + 1, &end, 10);
+        if (*end != '\0')
+            return -1;
+    }
+
+    bool realtime = (sched->policy == SCHED_FIFO) || (sched->policy == SCHED_RR);
+    if (realtime && ((sched->priority < 1) || (sched->priority > 99)))
+        return -1;
+    if (!realtime && (sched->priority != 0))
+        return -1;
+    if ((sched->nice < -20) || (sched->nice > 19))
+        return -1;
+    return 0;
+}
+
+/*!
+ * \brief bin of a time, log-linear: 16 + 8 * (log2(ns) - 4) + the next 3 bits
+ */
+static inline int randsched_bin(uint64_t ns)
+{
+    if (ns < 16)
+        return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    return 16 + (e - 4) * 8 + (int)((ns >> (e - 3)) & 7);
+}
+
+/*!
+ * \brief middle of a bin in ns
+ */
+static double randsched_bin_ns(int bin)
+{
+    if (bin < 16)
+        return bin;
+    int e = (bin - 16) / 8 + 4;
+    double low = (double)(8 + (bin - 16) % 8) * (double)(1ULL << (e - 3));
+    return low + (double)(1ULL << (e - 3)) / 2;
+}
+
+static double randsched_percentile(const uint64_t *bins, uint64_t n, double q)
+{
+    uint64_t rank = (uint64_t)(q * (double)(n - 1)), seen = 0;
+
+    for (int b = 0; b < RANDSCHED_JITTER_BINS; b++) {
+        seen += bins[b];
+        if (seen > rank)
+            return randsched_bin_ns(b);
+    }
+    return randsched_bin_ns(RANDSCHED_JITTER_BINS - 1);
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randsched_parse(randsched_profile_t *prof, const char *spec)
+{
+    const thread_sched_t none = THREAD_SCHED_DEFAULT;
+    const char *p = spec;
+
+    memset(prof, 0, sizeof(*prof));
+    for (int r = 0; r < RANDSCHED_ROLE_MAX; r++)
+        prof->role[r] = none;
+
+    while (*p != '\0') {
+        char item[RANDSCHED_ITEM_LEN];
+        size_t len = strcspn(p, ",");
+        if ((len == 0) || (len >= sizeof(item))) {
+            syslog(LM_RAND, LOG_ERROR, "schedule profile: bad item at '%s'\n", p);
+            return -1;
+        }
+        memcpy(item, p, len);
+        item[len] = '\0';
+        p += len;
+        if (*p == ',')
+            p++;
+
+        int rs = 0;
+        if (0 == strncmp(item, "worker=", 7))
+            rs = randsched_parse_role(&prof->role[RANDSCHED_ROLE_worker], item + 7);
+        else if (0 == strncmp(item, "manager=", 8))
+            rs = randsched_parse_role(&prof->role[RANDSCHED_ROLE_manager], item + 8);
+        else if (0 == strcmp(item, "cpus=isolated"))
+            prof->isolated = true;
+        else if (0 == strncmp(item, "cpus=", 5)) {
+            prof->ncpus = randsched_cpulist(item + 5, ':', prof->cpus, 0, RANDSCHED_CPUS);
+            rs = (prof->ncpus > 0) ? 0 : -1;
+        }
+        else if (0 == strcmp(item, "mlock"))
+            prof->mlock = true;
+        else
+            rs = -1;
+        if (rs != 0) {
+            syslog(LM_RAND, LOG_ERROR, "schedule profile: bad item '%s'\n", item);
+            return -1;
+        }
+    }
+    prof->enabled = true;
+    return 0;
+}
+
+int randsched_isolated(int *cpus, int max)
+{
+    int isolated[RANDSCHED_CPUS], nohz[RANDSCHED_CPUS];
+    int ni = randsched_sysfs_cpus(RANDSCHED_SYSFS_CPU "isolated", isolated, RANDSCHED_CPUS);
+    int nn = randsched_sysfs_cpus(RANDSCHED_SYSFS_CPU "nohz_full", nohz, RANDSCHED_CPUS);
+    int n = 0;
+
+    for (int i = 0; (i < ni) && (n < max); i++) {
+        for (int k = 0; k < nn; k++) {
+            if (nohz[k] == isolated[i]) {
+                cpus[n++] = isolated[i];
+                break;
+            }
+        }
+    }
+    for (int i = 0; (i < ni) && (n < max); i++) {
+        int k;
+        for (k = 0; (k < n) && (cpus[k] != isolated[i]); k++)
+            ;
+        if (k == n)
+            cpus[n++] = isolated[i];
+    }
+    for (int i = 0; (i < nn) && (n < max); i++) {
+        int k;
+        for (k = 0; (k < n) && (cpus[k] != nohz[i]); k++)
+            ;
+        if (k == n)
+            cpus[n++] = nohz[i];
+    }
+    return n;
+}
+
+int randsched_numa_nodes(void)
+{
+    int nodes = 0, cpus[RANDSCHED_CPUS];
+
+    while ((nodes < RANDSCHED_CPUS) && (randsched_numa_cpus(nodes, cpus, RANDSCHED_CPUS) > 0))
+        nodes++;
+    return (nodes > 0) ? nodes : 1;
+}
+
+int randsched_numa_cpus(int node, int *cpus, int max)
+{
+    char name[RANDSCHED_ITEM_LEN];
+
+    snprintf(name, sizeof(name), "/sys/devices/system/node/node%d/cpulist", node);
+    return randsched_sysfs_cpus(name, cpus, max);
+}
+
+int randsched_apply(randsched_profile_t *prof, int workers)
+{
+    int failed = 0;
+
+    if (prof->isolated) {
+        prof->ncpus = randsched_isolated(prof->cpus, RANDSCHED_CPUS);
+        if (prof->ncpus == 0)
+            syslog(LM_RAND, LOG_WARNING, "schedule profile: no isolcpus nor nohz_full cpu, the OS places the workers.\n");
+        else if (prof->ncpus < workers)
+            syslog(LM_RAND, LOG_WARNING, "schedule profile: %d isolated cpus for %d workers, some share a cpu.\n",
+                    prof->ncpus, workers);
+    }
+
+    if (prof->mlock && (0 != mlockall(MCL_CURRENT | MCL_FUTURE))) {
+        syslog(LM_RAND, LOG_ERROR, "schedule profile: mlockall failed, %s. The buffers are only prefaulted.\n",
+                strerror(errno));
+        failed++;
+    }
+
+    for (int w = 0; w < workers; w++) {
+        thread_sched_t sched;
+        randsched_worker(prof, w, &sched);
+        if (0 != thread_set_sched((thread_id_t)(THREAD_ID_worker1 + w), &sched))
+            failed++;
+    }
+    if (0 != thread_self_sched("manager", &prof->role[RANDSCHED_ROLE_manager]))
+        failed++;
+
+    syslog(LM_RAND, LOG_VERBOSE, "schedule profile: worker policy %d priority %d nice %d, manager policy %d priority %d nice %d, %d worker cpus%s%s\n",
+            prof->role[RANDSCHED_ROLE_worker].policy, prof->role[RANDSCHED_ROLE_worker].priority,
+            prof->role[RANDSCHED_ROLE_worker].nice, prof->role[RANDSCHED_ROLE_manager].policy,
+            prof->role[RANDSCHED_ROLE_manager].priority, prof->role[RANDSCHED_ROLE_manager].nice,
+            prof->ncpus, prof->isolated ? " (isolated)" : "", prof->mlock ? ", memory locked" : "");
+    return failed;
+}
+
+void randsched_worker(const randsched_profile_t *prof, int w, thread_sched_t *sched)
+{
+    *sched = prof->role[RANDSCHED_ROLE_worker];
+    if (prof->ncpus > 0)
+        sched->cpu = prof->cpus[w % prof->ncpus];
+}
+
+void randsched_prefault(void *p, size_t size)
+{
+    volatile char *c = (volatile char *)p;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    for (size_t i = 0; i < size; i += page)
+        c[i] = c[i];
+    if (size > 0)
+        c[size - 1] = c[size - 1];
+}
+
+uint64_t randsched_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void randsched_jitter_add(randsched_jitter_t *j, uint64_t ns)
+{
+    j->n++;
+    j->sum += ns;
+    if (ns > j->max)
+        j->max = ns;
+    j->bins[randsched_bin(ns)]++;
+}
+
+void randsched_jitter_report(const char *name, const randsched_jitter_t *j, int n)
+{
+    static uint64_t bins[RANDSCHED_JITTER_BINS];
+    uint64_t count = 0, sum = 0, max = 0;
+
+    memset(bins, 0, sizeof(bins));
+    for (int w = 0; w < n; w++) {
+        count += j[w].n;
+        sum += j[w].sum;
+        if (j[w].max > max)
+            max = j[w].max;
+        for (int b = 0; b < RANDSCHED_JITTER_BINS; b++)
+            bins[b] += j[w].bins[b];
+    }
+    if (count == 0)
+        return;
+
+    double p50 = randsched_percentile(bins, count, 0.50);
+    double p999 = randsched_percentile(bins, count, 0.999);
+    syslog(LM_RAND, LOG_VERBOSE, "%s: %" PRIu64 " blocks, mean %.1f us, p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us, jitter (p99.9-p50) %.1f us\n",
+            name, count, (double)sum / count / 1e3, p50 / 1e3, randsched_percentile(bins, count, 0.99) / 1e3,
+            p999 / 1e3, max / 1e3, (p999 - p50) / 1e3);
+}
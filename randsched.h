@@ -0,0 +1,133 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDSCHED_H_
+#define _RANDSCHED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "os_wrapper.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDSCHED_CPUS
+ *    Cpus a profile can place the workers on.
+ */
+#define RANDSCHED_CPUS          256
+
+/*!
+ * \def RANDSCHED_JITTER_BINS
+ *    Log-linear bins of the block times in ns: exact under 16 ns, then 8
+ *    bins per power of 2, so a percentile is within 12.5%.
+ */
+#define RANDSCHED_JITTER_BINS   512
+
+/*!
+ * \enum randsched_role_t
+ *    The threads a profile sets up.
+ */
+typedef enum {
+    RANDSCHED_ROLE_worker,      //!< the generation workers
+    RANDSCHED_ROLE_manager,     //!< the main thread, which takes the events
+    RANDSCHED_ROLE_MAX
+} randsched_role_t;
+
+/*!
+ *  \brief Scheduling profile of a simulation run: policy, priority and
+ *         nice level per role, the cpus of the workers, and memory locked
+ *         and prefaulted so no page fault hits a block.
+ */
+typedef struct
+{
+    bool            enabled;
+    thread_sched_t  role[RANDSCHED_ROLE_MAX];
+    bool            isolated;               //!< workers on the isolated cpus found at apply
+    int             cpus[RANDSCHED_CPUS];   //!< the cpus of the workers, in turn
+    int             ncpus;                  //!< 0: let the OS place them
+    bool            mlock;                  //!< mlockall the current and future pages
+} randsched_profile_t;
+
+/*!
+ *  \brief Times of the blocks of one worker, only written by it.
+ */
+typedef struct
+{
+    uint64_t    n;
+    uint64_t    sum;
+    uint64_t    max;
+    uint64_t    bins[RANDSCHED_JITTER_BINS];
+} randsched_jitter_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Parse a profile of items split by ',':
+ *       - worker=policy[:priority[:nice]], manager=... : other, batch,
+ *         fifo or rr, e.g. "worker=fifo:80" or "manager=other:0:-10"
+ *       - cpus=isolated, the isolcpus / nohz_full cpus of the kernel,
+ *         or cpus=2-5:7 for a list split by ':'
+ *       - mlock
+ * \return int - 0 : successful
+ */
+int randsched_parse(randsched_profile_t *prof, const char *spec);
+
+/*!
+ * \brief The isolated cpus of the kernel command line, from sysfs: the
+ *       isolcpus ones, then the nohz_full ones not already listed. Those
+ *       in both come first, they have neither other tasks nor the tick.
+ * \return int - number of the cpus in \a cpus
+ */
+int randsched_isolated(int *cpus, int max);
+
+/*!
+ * \brief NUMA nodes of the machine, node0 .. nodeN-1 of sysfs with cpus,
+ *       1 if the kernel shows none. randsched_numa_cpus() gives the cpus
+ *       of one of them.
+ */
+int randsched_numa_nodes(void);
+int randsched_numa_cpus(int node, int *cpus, int max);
+
+/*!
+ * \brief Lock the memory if asked, set the profile of the \a workers
+ *       worker threads, to be applied when they are created, and apply
+ *       the manager one to the calling thread. What the OS refuses is
+ *       logged and left out, the run goes on.
+ * \return int - 0 : all applied
+ */
+int randsched_apply(randsched_profile_t *prof, int workers);
+
+/*!
+ * \brief The profile of worker \a w, its cpu in turn of the profile's,
+ *       for the worker threads which aren't created by thread_create and
+ *       apply it by thread_self_sched themselves.
+ */
+void randsched_worker(const randsched_profile_t *prof, int w, thread_sched_t *sched);
+
+/*!
+ * \brief Touch every page of [p, p+size) for write, so its faults are
+ *       taken now instead of in the first blocks.
+ */
+void randsched_prefault(void *p, size_t size);
+
+/*!
+ * \brief Monotonic clock in ns.
+ */
+uint64_t randsched_now_ns(void);
+
+void randsched_jitter_add(randsched_jitter_t *j, uint64_t ns);
+
+/*!
+ * \brief Print the block times of \a n workers merged: mean, p50, p99,
+ *       p99.9, max, and the jitter p99.9 - p50.
+ */
+void randsched_jitter_report(const char *name, const randsched_jitter_t *j, int n);
+
+#endif//_RANDSCHED_H_
@@ -0,0 +1,323 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "SFMT-range.h"
+#include "os_wrapper.h"
+#include "randshuffle.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ *  \brief Bulk reader of 64-bit numbers, one SFMT block at a time.
+ */
+typedef struct {
+    sfmt_t         *sfmt;
+    const uint64_t *cur;
+    const uint64_t *end;
+} shuffle_rng_t;
+
+/*!
+ *  \brief Shared job description of one level of the parallel shuffle.
+ *         level 0 shuffles the leaf blocks, level L merges the pairs of
+ *         adjacent runs of \a span elements.
+ */
+typedef struct {
+    void       *array;          //!< elements to shuffle
+    size_t      size;           //!< number of elements
+    uint32_t    seed;           //!< random seed
+    uint32_t    level;          //!< 0 for the leaf blocks
+    size_t      span;           //!< elements per run to merge
+    size_t      tasks;          //!< number of tasks of this level
+    size_t      next;           //!< next task to take, shared by the workers
+} randshuffle_job_t;
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static inline uint64_t rng_next(shuffle_rng_t *rng)
+{
+    if (rng->cur == rng->end) {
+        sfmt_range64_t range = sfmt_block64(rng->sfmt);
+        rng->cur = range.begin();
+        rng->end = range.end();
+    }
+    return *rng->cur++;
+}
+
+/*!
+ * \brief put the unused numbers back, so the SFMT sequence continues
+ *        from the first unused one, as sfmt_genrand_uint64 would.
+ */
+static inline void rng_release(shuffle_rng_t *rng)
+{
+    rng->sfmt->idx -= 2 * (int)(rng->end - rng->cur);
+    rng->cur = rng->end;
+}
+
+/*!
+ * \brief uniform on [0, n), Lemire's multiply-shift, the threshold
+ *        division is only needed for the rare low products below n.
+ */
+static inline uint64_t rng_bounded(shuffle_rng_t *rng, uint64_t n)
+{
+    __uint128_t m = (__uint128_t)rng_next(rng) * n;
+
+    if ((uint64_t)m < n) {
+        uint64_t t = (0 - n) % n;
+        while ((uint64_t)m < t)
+            m = (__uint128_t)rng_next(rng) * n;
+    }
+    return (uint64_t)(m >> 64);
+}
+
+/*!
+ * \brief uniform on (0,1], safe for log()
+ */
+static inline double rng_unit(shuffle_rng_t *rng)
+{
+    return (double)(int64_t)((rng_next(rng) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+template <class T>
+static void fisher_yates(shuffle_rng_t *rng, T *a, size_t n)
+{
+    for (size_t i = n; i > 1; i--) {
+        size_t j = (size_t)rng_bounded(rng, i);
+        std::swap(a[i - 1], a[j]);
+    }
+}
+
+/*!
+ * \brief merge the shuffled a[0, m) and a[m, n) into a shuffled a[0, n).
+ *        Fair coins pick the side until one side runs out, the rest is
+ *        inserted at random positions of the merged prefix.
+ */
+template <class T>
+static void shuffle_merge(shuffle_rng_t *rng, T *a, size_t m, size_t n)
+{
+    size_t   u = 0, v = m;
+    uint64_t bits = 0;
+    int      nbits = 0;
+
+    for (;;) {
+        // neither side can run out in the next k coins, no check and no
+        // branch on the coin for them. y is the head of the right side,
+        // the next one is loaded ahead, so v is the only carried chain.
+        size_t k = std::min(n - v - 1, v - u);
+        while ((k > 0) && (v + 1 < n)) {
+            if (nbits == 0) {
+                bits = rng_next(rng);
+                nbits = 64;
+            }
+            size_t run = std::min(k, (size_t)nbits);
+            T y = a[v];
+            for (size_t i = 0; i < run; i++) {
+                T mask = (T)0 - (T)(bits & 1);
+                T x = a[u];
+                T z = a[v + 1];
+                bits >>= 1;
+                a[u] = x ^ ((x ^ y) & mask);
+                a[v] = y ^ ((x ^ y) & mask);
+                y = y ^ ((y ^ z) & mask);
+                v += (size_t)(mask & 1);
+                u++;
+            }
+            nbits -= (int)run;
+            k -= run;
+        }
+
+        if (nbits == 0) {
+            bits = rng_next(rng);
+            nbits = 64;
+        }
+        uint64_t coin = bits & 1;
+        bits >>= 1;
+        nbits--;
+
+        if (coin) {
+            if (v == n)
+                break;
+            std::swap(a[u], a[v]);
+            v++;
+        }
+        else if (u == v) {
+            break;
+        }
+        u++;
+    }
+
+    for (; u < n; u++) {
+        std::swap(a[u], a[rng_bounded(rng, u + 1)]);
+    }
+}
+
+/*!
+ * \brief worker job: take the tasks of one level until none is left
+ */
+template <class T>
+static void randshuffle_job_entry(int worker, void *arg)
+{
+    randshuffle_job_t *job = (randshuffle_job_t *)arg;
+    T       *a = (T *)job->array;
+    sfmt_t   sfmt;
+    uint32_t key[4];
+
+    (void)worker;
+    for (;;) {
+        size_t task = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (task >= job->tasks)
+            break;
+
+        // the stream depends on the task only, not on the worker
+        key[0] = job->seed;
+        key[1] = job->level;
+        key[2] = (uint32_t)task;
+        key[3] = (uint32_t)((uint64_t)task >> 32);
+        sfmt_init_by_array(&sfmt, key, 4);
+        shuffle_rng_t rng = { &sfmt, NULL, NULL };
+
+        if (job->level == 0) {
+            size_t begin = task * RANDSHUFFLE_BLOCK;
+            size_t n = std::min((size_t)RANDSHUFFLE_BLOCK, job->size - begin);
+            fisher_yates(&rng, a + begin, n);
+        }
+        else {
+            size_t begin = task * 2 * job->span;
+            size_t mid = begin + job->span;
+            if (mid >= job->size)
+                continue;                   // odd run out, nothing to merge
+            size_t end = std::min(mid + job->span, job->size);
+            shuffle_merge(&rng, a + begin, mid - begin, end - begin);
+        }
+    }
+}
+
+template <class T>
+static int randshuffle_level(randshuffle_job_t *job, int workers)
+{
+    int w = (job->tasks < (size_t)workers) ? (int)job->tasks : workers;
+
+    job->next = 0;
+    if (w <= 1) {
+        randshuffle_job_entry<T>(0, job);
+        return 0;
+    }
+    return thread_parallel(w, randshuffle_job_entry<T>, job);
+}
+
+template <class T>
+static int randshuffle(T *array, size_t size, int workers, uint32_t seed)
+{
+    randshuffle_job_t job;
+    int ret;
+
+    if ((array == NULL) || (workers <= 0)) {
+        syslog(LM_RAND, LOG_ERROR, "randshuffle: invalid parameters\n");
+        return -1;
+    }
+    if (size < 2)
+        return 0;
+
+    job.array = array;
+    job.size  = size;
+    job.seed  = seed;
+    job.level = 0;
+    job.span  = RANDSHUFFLE_BLOCK;
+    job.tasks = (size + RANDSHUFFLE_BLOCK - 1) / RANDSHUFFLE_BLOCK;
+    ret = randshuffle_level<T>(&job, workers);
+
+    while ((ret == 0) && (job.span < size)) {
+        job.level++;
+        job.tasks = (size + 2 * job.span - 1) / (2 * job.span);
+        ret = randshuffle_level<T>(&job, workers);
+        job.span *= 2;
+    }
+
+    return ret;
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randshuffle_u64(uint64_t *array, size_t size, int workers, uint32_t seed)
+{
+    return randshuffle(array, size, workers, seed);
+}
+
+int randshuffle_u32(uint32_t *array, size_t size, int workers, uint32_t seed)
+{
+    return randshuffle(array, size, workers, seed);
+}
+
+size_t randsample_reservoir(sfmt_t *sfmt, const uint64_t *src, size_t size,
+        uint64_t *sample, size_t k)
+{
+    if (k == 0)
+        return 0;
+    if (size <= k) {
+        memcpy(sample, src, size * sizeof(uint64_t));
+        return size;
+    }
+    memcpy(sample, src, k * sizeof(uint64_t));
+
+    shuffle_rng_t rng = { sfmt, NULL, NULL };
+    double w = exp(log(rng_unit(&rng)) / (double)k);
+    size_t i = k - 1;
+
+    for (;;) {
+        // elements skipped before the next replacement, geometric of w
+        double skip = floor(log(rng_unit(&rng)) / log1p(-w));
+        if (skip >= (double)(size - 1 - i))
+            break;
+        i += (size_t)skip + 1;
+        sample[rng_bounded(&rng, k)] = src[i];
+        w *= exp(log(rng_unit(&rng)) / (double)k);
+    }
+
+    rng_release(&rng);
+    return k;
+}
+
+size_t randsample_floyd(sfmt_t *sfmt, uint64_t n, uint64_t *sample, size_t k)
+{
+    std::unordered_set<uint64_t> chosen;
+    shuffle_rng_t rng = { sfmt, NULL, NULL };
+    size_t cnt = 0;
+
+    if ((uint64_t)k > n)
+        k = (size_t)n;
+    chosen.reserve(k * 2);
+
+    for (uint64_t j = n - k; j < n; j++) {
+        uint64_t t = rng_bounded(&rng, j + 1);
+        if (!chosen.insert(t).second) {
+            t = j;                          // t was taken, j never was
+            chosen.insert(j);
+        }
+        sample[cnt++] = t;
+    }
+
+    // the set is uniform but not its order, j is always after the ones below it
+    fisher_yates(&rng, sample, cnt);
+
+    rng_release(&rng);
+    return cnt;
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDSHUFFLE_H_
+#define _RANDSHUFFLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SFMT.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDSHUFFLE_BLOCK
+ *    Elements per leaf block of the parallel shuffle. Each block is
+ *    shuffled by Fisher-Yates in the cache, then the blocks are merged
+ *    pairwise. The block layout depends on the size only, so the same
+ *    seed gives the same permutation for any number of workers.
+ */
+#ifndef RANDSHUFFLE_BLOCK
+#define RANDSHUFFLE_BLOCK   (1 << 16)
+#endif
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Uniform random permutation of \a array in place, MergeShuffle
+ *       of Bacher, Bodini, Hollender and Lumbroso (2015).
+ *       The leaf blocks are shuffled by Fisher-Yates, then each level of
+ *       pairwise merges is run by \a workers threads. Each leaf or merge
+ *       task draws from its own SFMT stream, keyed {seed, level, task},
+ *       pulled in bulk from the state array.
+ *
+ * \param array     : elements to shuffle
+ * \param size      : number of elements
+ * \param workers   : number of worker threads
+ * \param seed      : random seed
+ *
+ * \return int
+ *          - 0     : successful
+ *          - others: failure
+ */
+int randshuffle_u64(uint64_t *array, size_t size, int workers, uint32_t seed);
+int randshuffle_u32(uint32_t *array, size_t size, int workers, uint32_t seed);
+
+/*!
+ * \brief Sample \a k elements of \a src without replacement, reservoir
+ *        Algorithm L of Li (1994): the gaps between the replacements are
+ *        drawn directly, so only O(k log(size/k)) elements are read.
+ *        The order of the sample is not random.
+ *
+ * \return number of sampled elements, min(k, size)
+ */
+size_t randsample_reservoir(sfmt_t *sfmt, const uint64_t *src, size_t size,
+        uint64_t *sample, size_t k);
+
+/*!
+ * \brief Sample \a k distinct integers of [0, n) in random order, Floyd's
+ *        algorithm, k draws and a hash set of k entries, for k << n.
+ *
+ * \return number of sampled integers, min(k, n)
+ */
+size_t randsample_floyd(sfmt_t *sfmt, uint64_t n, uint64_t *sample, size_t k);
+
+#endif//_RANDSHUFFLE_H_
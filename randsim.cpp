@@ -0,0 +1,538 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+#include <random>
+#include <thread>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "SFMT.h"
+#include "SFMT-range.h"
+#include "SFMT-engine.h"
+#include "os_wrapper.h"
+#include "philox.h"
+#include "xoshiro.h"
+#include "pcg64.h"
+#include "aesctr.h"
+#include "mt64.h"
+#include "randmix.h"
+#include "randsim.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDSIM_BLOCK
+ *    Numbers a worker fills and scans at a time, 32KB.
+ */
+#define RANDSIM_BLOCK           4096
+#define RANDSIM_NAME_LEN        32
+
+struct randsim_gen {
+    int algo;
+    union {
+        sfmt_t          sfmt;
+        philox4x32_t    philox;
+        xoshiro256pp_t  xoshiro;
+        pcg64dxsm_t     pcg64;
+        aesctr_t        aesctr;
+        mt64_t          mt64;
+    } u;
+    std::mt19937   *mt;         //!< RANDSIM_ALGO_SYSTEM_RANDOM
+    sfmt19937_64   *engine;     //!< RANDSIM_ALGO_SFMT_ENGINE
+};
+
+/*!
+ *  \brief Events of one predicate in the numbers of one worker.
+ */
+typedef struct {
+    uint64_t    n;
+    double      mean;           //!< Welford's running mean
+    double      m2;             //!< and sum of squared deviations
+    uint64_t    min;
+    uint64_t    max;
+    uint64_t    last;           //!< position after the previous event
+} randsim_pred_stat_t;
+
+typedef struct {
+    alignas(64) randsim_gen_t *gen;
+    uint64_t   *buf;
+    uint64_t    pos;            //!< numbers scanned by this worker
+    randsim_pred_stat_t stat[RANDSIM_PREDICATES];
+} randsim_worker_t;
+
+typedef enum {
+    RANDSIM_JOB_fill,
+    RANDSIM_JOB_run,
+    RANDSIM_JOB_quit,
+} randsim_job_t;
+
+struct randsim {
+    randsim_config_t    cfg;
+    randsim_worker_t   *workers;
+    std::thread        *threads;        //!< workers 1 .. threads-1, 0 is the caller
+
+    uint32_t            jobSeq;         //!< futex word, bumped for each job
+    uint32_t            jobDone;        //!< futex word, workers done with the job
+    randsim_job_t       job;
+    uint64_t           *array;
+    size_t              n;
+    uint64_t            numbers;
+
+    int                 npred;
+    randsim_predicate_t fn[RANDSIM_PREDICATES];
+    void               *ctx[RANDSIM_PREDICATES];
+    char                name[RANDSIM_PREDICATES][RANDSIM_NAME_LEN];
+    bool                ready[RANDSIM_PREDICATES];  //!< randsim_pred_leading0/1 of 1 .. 64 bits
+    int                 readyBits;      //!< fewest bits of the ready ones, 0 if none
+    uint64_t            scanned;        //!< numbers of all randsim_run
+};
+
+/*------------------------------------------------------------------
+ * Module Variables Definitions
+ *------------------------------------------------------------------*/
+
+static const char *randsim_algo_str[RANDSIM_ALGO_MAX] = {
+        "SFMT Sequence Algorithm by SSE2"           ,
+        "SFMT Block Algorithm by SSE2"              ,
+        "System Random Algorithm by std::mt19937"   ,
+        "SFMT Buffered Algorithm by background producers",
+        "SFMT Range Algorithm by SSE2"              ,
+        "System Random Algorithm by sfmt19937_64"   ,
+        "SFMT Binomial Tick Simulation"             ,
+        "Philox4x32-10 Block Algorithm"             ,
+        "xoshiro256++ 8 Lanes Block Algorithm"      ,
+        "PCG64-DXSM 4 Lanes Block Algorithm"        ,
+        "AES-128 CTR Block Algorithm"               ,
+        "MT19937-64 Block Algorithm"                ,
+        "Per Node xoroshiro128++ SoA Algorithm"     ,
+};
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief an event of predicate \a p, the number \a i of the buffer of
+ *        worker \a w, out of the scan loop
+ */
+static void __attribute__((noinline)) randsim_event(randsim_t *rs, int w, int p, size_t i)
+{
+    randsim_worker_t *wk = &rs->workers[w];
+    randsim_pred_stat_t *st = &wk->stat[p];
+    uint64_t at = wk->pos + i + 1;
+    uint64_t interval = at - st->last;
+    double delta = (double)interval - st->mean;
+
+    st->n++;
+    st->mean += delta / (double)st->n;
+    st->m2 += delta * ((double)interval - st->mean);
+    if ((st->n == 1) || (interval < st->min))
+        st->min = interval;
+    if (interval > st->max)
+        st->max = interval;
+    st->last = at;
+    if (rs->cfg.event != NULL) {
+        randsim_event_t ev = { p, w, wk->buf[i], at };
+        rs->cfg.event(&ev, rs->cfg.ctx);
+    }
+}
+
+/*!
+ * \brief a number which may be an event of the ready made predicates, the
+ *        number \a i of the buffer of worker \a w, tested by each of them
+ */
+static void __attribute__((noinline)) randsim_candidate(randsim_t *rs, int w, size_t i)
+{
+    uint64_t v = rs->workers[w].buf[i];
+
+    for (int p = 0; p < rs->npred; p++) {
+        if (rs->ready[p] && rs->fn[p](v, rs->ctx[p]))
+            randsim_event(rs, w, p, i);
+    }
+}
+
+/*!
+ * \brief \a hit for the numbers of the buffer which pass \a test
+ */
+template <class Test, class Hit>
+static inline void randsim_scan_buf(const uint64_t *buf, size_t n, Test test, Hit hit)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (__builtin_expect(test(buf[i]), 0))
+            hit(i);
+    }
+}
+
+/*!
+ * \brief the \a n numbers of worker \a w, tested by every predicate. The
+ *        ready made ones share one pass, a number is only tested by them if
+ *        its readyBits high bits are all 0 or all 1. The others cost a call
+ *        per number.
+ */
+static void randsim_scan(randsim_t *rs, int w, uint64_t numbers)
+{
+    randsim_worker_t *wk = &rs->workers[w];
+
+    while (numbers > 0) {
+        size_t n = (numbers < RANDSIM_BLOCK) ? (size_t)numbers : RANDSIM_BLOCK;
+
+        randsim_gen_fill(wk->gen, wk->buf, n);
+        if (rs->readyBits > 0) {
+            int shift = 64 - rs->readyBits;
+            randsim_scan_buf(wk->buf, n,
+                    [=](uint64_t v) { return (uint64_t)(((int64_t)v >> shift) + 1) <= 1; },
+                    [=](size_t i) { randsim_candidate(rs, w, i); });
+        }
+        for (int p = 0; p < rs->npred; p++) {
+            if (rs->ready[p])
+                continue;
+            randsim_predicate_t fn = rs->fn[p];
+            void *ctx = rs->ctx[p];
+            randsim_scan_buf(wk->buf, n,
+                    [=](uint64_t v) { return fn(v, ctx) != 0; },
+                    [=](size_t i) { randsim_event(rs, w, p, i); });
+        }
+        wk->pos += n;
+        numbers -= n;
+    }
+}
+
+/*!
+ * \brief worker \a w's part of the current job
+ */
+static void randsim_do_job(randsim_t *rs, int w)
+{
+    int threads = rs->cfg.threads;
+
+    if (rs->job == RANDSIM_JOB_fill) {
+        size_t part = (rs->n / threads) & ~(size_t)7;
+        size_t begin = part * w;
+        size_t n = (w == threads - 1) ? (rs->n - begin) : part;
+        if (n > 0)
+            randsim_gen_fill(rs->workers[w].gen, rs->array + begin, n);
+    }
+    else if (rs->job == RANDSIM_JOB_run) {
+        uint64_t part = rs->numbers / threads;
+        randsim_scan(rs, w, (w == 0) ? (rs->numbers - part * (threads - 1)) : part);
+    }
+}
+
+static void randsim_worker_entry(randsim_t *rs, int w)
+{
+    uint32_t seq = 0;
+
+    if (rs->cfg.start != NULL)
+        rs->cfg.start(w, rs->cfg.ctx);
+    for (;;) {
+        uint32_t now;
+        while ((now = __atomic_load_n(&rs->jobSeq, __ATOMIC_ACQUIRE)) == seq)
+            futex_wait(&rs->jobSeq, seq, false, 0);
+        seq = now;
+        if (rs->job == RANDSIM_JOB_quit)
+            return;
+        randsim_do_job(rs, w);
+        if (__atomic_add_fetch(&rs->jobDone, 1, __ATOMIC_ACQ_REL) == (uint32_t)(rs->cfg.threads - 1))
+            futex_wake(&rs->jobDone, 1, false);
+    }
+}
+
+/*!
+ * \brief hand the job to the pool, do the part of worker 0, and wait for
+ *        the others
+ */
+static void randsim_dispatch(randsim_t *rs, randsim_job_t job)
+{
+    uint32_t others = (uint32_t)(rs->cfg.threads - 1), done;
+
+    rs->job = job;
+    __atomic_store_n(&rs->jobDone, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&rs->jobSeq, 1, __ATOMIC_RELEASE);
+    if (others > 0)
+        futex_wake(&rs->jobSeq, 0, false);
+    if (job == RANDSIM_JOB_quit)
+        return;
+
+    randsim_do_job(rs, 0);
+    while ((done = __atomic_load_n(&rs->jobDone, __ATOMIC_ACQUIRE)) != others)
+        futex_wait(&rs->jobDone, done, false, 0);
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+int randsim_api_version(void)
+{
+    return RANDSIM_API_VERSION;
+}
+
+const char *randsim_algo_name(int algo)
+{
+    if ((algo < 0) || (algo >= RANDSIM_ALGO_MAX))
+        return "unknown";
+    return randsim_algo_str[algo];
+}
+
+randsim_gen_t *randsim_gen_create(int algo, uint64_t seed, uint64_t stream)
+{
+    uint32_t key[4] = { (uint32_t)seed, (uint32_t)(seed >> 32), (uint32_t)stream, (uint32_t)(stream >> 32) };
+    void *p = NULL;
+
+    if ((algo < 0) || (algo >= RANDSIM_ALGO_MAX) || (algo == RANDSIM_ALGO_BINOMIAL_TICK)
+            || (algo == RANDSIM_ALGO_NODES_SOA)) {
+        syslog(LM_RAND, LOG_ERROR, "randsim: [%s] is not a number generator\n", randsim_algo_name(algo));
+        return NULL;
+    }
+    if (0 != posix_memalign(&p, 64, sizeof(randsim_gen_t)))
+        return NULL;
+
+    randsim_gen_t *gen = (randsim_gen_t *)p;
+    memset(gen, 0, sizeof(*gen));
+    gen->algo = algo;
+    switch (algo) {
+        case RANDSIM_ALGO_SYSTEM_RANDOM: {
+            std::seed_seq seq(key, key + 4);
+            gen->mt = new (std::nothrow) std::mt19937(seq);
+            break;
+        }
+        case RANDSIM_ALGO_SFMT_ENGINE: {
+            std::seed_seq seq(key, key + 4);
+            gen->engine = new (std::nothrow) sfmt19937_64(seq);
+            break;
+        }
+        case RANDSIM_ALGO_PHILOX:   philox4x32_init(&gen->u.philox, seed, stream); break;
+        case RANDSIM_ALGO_XOSHIRO:  xoshiro256pp_init(&gen->u.xoshiro, seed, stream); break;
+        case RANDSIM_ALGO_PCG64:    pcg64dxsm_init(&gen->u.pcg64, seed, stream); break;
+        case RANDSIM_ALGO_AESCTR:   aesctr_init(&gen->u.aesctr, seed, stream); break;
+        case RANDSIM_ALGO_MT64: {   // stream 0 is std::mt19937_64(seed)
+            uint64_t s = stream;
+            uint64_t x = seed ^ randmix_splitmix64(&s);
+            mt64_init(&gen->u.mt64, (stream == 0) ? seed : randmix_splitmix64(&x));
+            break;
+        }
+        default:                    // the SFMT algos, as the deterministic streams of randsim-sse
+            sfmt_init_by_array(&gen->u.sfmt, key, 4);
+            break;
+    }
+    if (((algo == RANDSIM_ALGO_SYSTEM_RANDOM) && (gen->mt == NULL))
+            || ((algo == RANDSIM_ALGO_SFMT_ENGINE) && (gen->engine == NULL))) {
+        free(gen);
+        return NULL;
+    }
+    return gen;
+}
+
+void randsim_gen_destroy(randsim_gen_t *gen)
+{
+    if (gen == NULL)
+        return;
+    delete gen->mt;
+    delete gen->engine;
+    free(gen);
+}
+
+void randsim_gen_fill(randsim_gen_t *gen, uint64_t *array, size_t n)
+{
+    switch (gen->algo) {
+        case RANDSIM_ALGO_SYSTEM_RANDOM: {
+            std::uniform_int_distribution<uint64_t> dist;
+            for (size_t i = 0; i < n; i++)
+                array[i] = dist(*gen->mt);
+            break;
+        }
+        case RANDSIM_ALGO_SFMT_ENGINE: {
+            std::uniform_int_distribution<uint64_t> dist;
+            for (size_t i = 0; i < n; i++)
+                array[i] = dist(*gen->engine);
+            break;
+        }
+        case RANDSIM_ALGO_PHILOX:   philox4x32_fill_array64(&gen->u.philox, array, n); break;
+        case RANDSIM_ALGO_XOSHIRO:  xoshiro256pp_fill_array64(&gen->u.xoshiro, array, n); break;
+        case RANDSIM_ALGO_PCG64:    pcg64dxsm_fill_array64(&gen->u.pcg64, array, n); break;
+        case RANDSIM_ALGO_AESCTR:   aesctr_fill_array64(&gen->u.aesctr, array, n); break;
+        case RANDSIM_ALGO_MT64:     mt64_fill_array64(&gen->u.mt64, array, n); break;
+        default:
+            // whole blocks straight into the array from a block boundary, the
+            // rest copied from the state, so any n and alignment
+            while (n > 0) {
+                if ((gen->u.sfmt.idx == SFMT_N32) && (n >= (size_t)SFMT_N64) && (((uintptr_t)array & 15) == 0)) {
+                    size_t bulk = n & ~(size_t)1;
+                    sfmt_fill_array64(&gen->u.sfmt, array, (int)bulk);
+                    array += bulk;
+                    n -= bulk;
+                    continue;
+                }
+                sfmt_range64_t range = sfmt_block64(&gen->u.sfmt, (n < (size_t)SFMT_N64) ? (int)n : SFMT_N64);
+                memcpy(array, range.begin(), range.size() * sizeof(uint64_t));
+                array += range.size();
+                n -= range.size();
+            }
+            break;
+    }
+}
+
+void randsim_config_init(randsim_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->size = sizeof(*cfg);
+    cfg->algo = RANDSIM_ALGO_SFMT_BLOCK;
+    cfg->threads = 1;
+    cfg->seed = 5489u;
+}
+
+randsim_t *randsim_create(const randsim_config_t *cfg)
+{
+    randsim_config_t c;
+    void *p = NULL;
+
+    randsim_config_init(&c);
+    if ((cfg == NULL) || (cfg->size < offsetof(randsim_config_t, seed) + sizeof(cfg->seed))) {
+        syslog(LM_RAND, LOG_ERROR, "randsim: config of an unknown version\n");
+        return NULL;
+    }
+    // an older caller's struct is shorter, its missing fields keep the
+    // defaults, the fields of later versions are ignored
+    memcpy(&c, cfg, (cfg->size < sizeof(c)) ? cfg->size : sizeof(c));
+    c.size = sizeof(c);
+    if ((c.threads < 1) || (c.threads > 256)) {
+        syslog(LM_RAND, LOG_ERROR, "randsim: %d threads out of range\n", c.threads);
+        return NULL;
+    }
+
+    randsim_t *rs = new (std::nothrow) randsim_t();
+    if (rs == NULL)
+        return NULL;
+    rs->cfg = c;
+    if (0 != posix_memalign(&p, 64, c.threads * sizeof(randsim_worker_t))) {
+        delete rs;
+        return NULL;
+    }
+    rs->workers = (randsim_worker_t *)p;
+    memset(rs->workers, 0, c.threads * sizeof(randsim_worker_t));
+    for (int w = 0; w < c.threads; w++) {
+        rs->workers[w].gen = randsim_gen_create(c.algo, c.seed, (uint64_t)w);
+        rs->workers[w].buf = new (std::nothrow) uint64_t[RANDSIM_BLOCK];
+        if ((rs->workers[w].gen == NULL) || (rs->workers[w].buf == NULL)) {
+            randsim_destroy(rs);
+            return NULL;
+        }
+    }
+
+    rs->threads = new std::thread[c.threads];
+    for (int w = 1; w < c.threads; w++)
+        rs->threads[w] = std::thread(randsim_worker_entry, rs, w);
+    return rs;
+}
+
+void randsim_destroy(randsim_t *rs)
+{
+    if (rs == NULL)
+        return;
+    if (rs->threads != NULL) {
+        randsim_dispatch(rs, RANDSIM_JOB_quit);
+        for (int w = 1; w < rs->cfg.threads; w++) {
+            if (rs->threads[w].joinable())
+                rs->threads[w].join();
+        }
+        delete[] rs->threads;
+    }
+    for (int w = 0; w < rs->cfg.threads; w++) {
+        randsim_gen_destroy(rs->workers[w].gen);
+        delete[] rs->workers[w].buf;
+    }
+    free(rs->workers);
+    delete rs;
+}
+
+int randsim_fill(randsim_t *rs, uint64_t *array, size_t n)
+{
+    if ((rs == NULL) || ((array == NULL) && (n > 0)))
+        return -1;
+    rs->array = array;
+    rs->n = n;
+    randsim_dispatch(rs, RANDSIM_JOB_fill);
+    return 0;
+}
+
+int randsim_add_predicate(randsim_t *rs, const char *name,
+                          randsim_predicate_t fn, void *ctx)
+{
+    if ((rs == NULL) || (fn == NULL) || (rs->npred >= RANDSIM_PREDICATES))
+        return -1;
+
+    int p = rs->npred;
+    rs->fn[p] = fn;
+    rs->ctx[p] = ctx;
+    strncpy(rs->name[p], (name != NULL) ? name : "", RANDSIM_NAME_LEN - 1);
+    int bits = (int)(intptr_t)ctx;
+    rs->ready[p] = ((fn == randsim_pred_leading0) || (fn == randsim_pred_leading1)) && (bits > 0) && (bits <= 64);
+    if (rs->ready[p] && ((rs->readyBits == 0) || (bits < rs->readyBits)))
+        rs->readyBits = bits;
+    for (int w = 0; w < rs->cfg.threads; w++) {
+        memset(&rs->workers[w].stat[p], 0, sizeof(randsim_pred_stat_t));
+        rs->workers[w].stat[p].last = rs->workers[w].pos;
+    }
+    rs->npred++;
+    return p;
+}
+
+int randsim_run(randsim_t *rs, uint64_t numbers)
+{
+    if (rs == NULL)
+        return -1;
+    rs->numbers = numbers;
+    randsim_dispatch(rs, RANDSIM_JOB_run);
+    rs->scanned += numbers;
+    return 0;
+}
+
+int randsim_get_stats(randsim_t *rs, int pred, randsim_stats_t *st)
+{
+    double m2 = 0;
+
+    if ((rs == NULL) || (st == NULL) || (pred < 0) || (pred >= rs->npred))
+        return -1;
+
+    // Chan's pairwise merge of the workers' Welford sums
+    memset(st, 0, sizeof(*st));
+    st->numbers = rs->scanned;
+    for (int w = 0; w < rs->cfg.threads; w++) {
+        const randsim_pred_stat_t *s = &rs->workers[w].stat[pred];
+        if (s->n == 0)
+            continue;
+        uint64_t n = st->events + s->n;
+        double delta = s->mean - st->mean;
+        m2 += s->m2 + delta * delta * (double)st->events * (double)s->n / (double)n;
+        st->mean += delta * (double)s->n / (double)n;
+        if ((st->events == 0) || (s->min < st->min))
+            st->min = s->min;
+        if (s->max > st->max)
+            st->max = s->max;
+        st->events = n;
+    }
+    st->variance = (st->events > 1) ? m2 / (double)(st->events - 1) : 0;
+    return 0;
+}
+
+int randsim_pred_leading0(uint64_t number, void *ctx)
+{
+    int bits = (int)(intptr_t)ctx;
+    return (bits <= 0) || ((bits <= 64) && ((number >> (64 - bits)) == 0));
+}
+
+int randsim_pred_leading1(uint64_t number, void *ctx)
+{
+    return randsim_pred_leading0(~number, ctx);
+}
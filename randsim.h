@@ -0,0 +1,232 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDSIM_H_
+#define _RANDSIM_H_
+
+/*!
+ *  \file randsim.h
+ *  \brief The API of librandsim.a / librandsim.so, for the programs which
+ *         embed the generators instead of running randsim-sse.
+ *
+ *  C and C++, the types are opaque or plain structures, the algorithm
+ *  numbers are the ones of the randsim-sse command line. A new version
+ *  only adds: functions, algorithms, and fields at the end of
+ *  randsim_config_t, whose \a size tells the library the caller's version.
+ *
+ *  @verbatim
+    randsim_config_t cfg;
+    randsim_config_init(&cfg);
+    cfg.algo = RANDSIM_ALGO_XOSHIRO;
+    cfg.threads = 4;
+    randsim_t *rs = randsim_create(&cfg);
+
+    randsim_fill(rs, array, n);                         // bulk numbers
+
+    int pred = randsim_add_predicate(rs, "32bits leading 0",
+                                     randsim_pred_leading0, (void *)32);
+    randsim_run(rs, 1ULL << 36);                        // scan 2^36 numbers
+    randsim_stats_t st;
+    randsim_get_stats(rs, pred, &st);                   // st.events, st.mean ...
+    randsim_destroy(rs);
+    @endverbatim
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDSIM_API_VERSION
+ *    Version of this header, randsim_api_version() is the one of the
+ *    library linked.
+ */
+#define RANDSIM_API_VERSION     1
+
+/*!
+ * \def RANDSIM_API
+ *    The library is built with -fvisibility=hidden, only the functions
+ *    marked with this are exported by librandsim.so.
+ */
+#if defined(__GNUC__)
+#define RANDSIM_API             __attribute__((visibility("default")))
+#else
+#define RANDSIM_API
+#endif
+
+/*!
+ * \def RANDSIM_PREDICATES
+ *    Predicates one randsim_t can scan for.
+ */
+#define RANDSIM_PREDICATES      16
+
+/*!
+ * \enum randsim_algo_t
+ *    The algorithms of randsim-sse, by their command line number.
+ */
+typedef enum {
+    RANDSIM_ALGO_SFMT_SEQUE         = 0,    //!< SFMT, one number per call
+    RANDSIM_ALGO_SFMT_BLOCK         = 1,    //!< SFMT, block fill by SSE2
+    RANDSIM_ALGO_SYSTEM_RANDOM      = 2,    //!< std::uniform_int_distribution on std::mt19937
+    RANDSIM_ALGO_SFMT_BUFFERED      = 3,    //!< SFMT on buffers of background producers
+    RANDSIM_ALGO_SFMT_RANGE         = 4,    //!< SFMT blocks consumed in place
+    RANDSIM_ALGO_SFMT_ENGINE        = 5,    //!< std::uniform_int_distribution on sfmt19937_64
+    RANDSIM_ALGO_BINOMIAL_TICK      = 6,    //!< binomial draws of the finds of a tick, simulation only
+    RANDSIM_ALGO_PHILOX             = 7,    //!< Philox4x32-10
+    RANDSIM_ALGO_XOSHIRO            = 8,    //!< xoshiro256++ in 8 lanes
+    RANDSIM_ALGO_PCG64              = 9,    //!< PCG64-DXSM in 4 lanes
+    RANDSIM_ALGO_AESCTR             = 10,   //!< AES-128 counter mode
+    RANDSIM_ALGO_MT64               = 11,   //!< MT19937-64, the std::mt19937_64 numbers
+    RANDSIM_ALGO_NODES_SOA          = 12,   //!< one xoroshiro128++ per network node, simulation only
+    RANDSIM_ALGO_MAX
+} randsim_algo_t;
+
+/*!
+ *  \brief One generator, one stream of 64-bit numbers. Not thread safe,
+ *         one per thread.
+ */
+typedef struct randsim_gen randsim_gen_t;
+
+/*!
+ *  \brief A pool of worker threads, each with a generator of its own
+ *         stream, and the predicates they scan the numbers for. Used by
+ *         one thread at a time.
+ */
+typedef struct randsim randsim_t;
+
+/*!
+ *  \brief An event of a predicate, as the worker which found it scans.
+ */
+typedef struct {
+    int         pred;           //!< id of randsim_add_predicate()
+    int         worker;
+    uint64_t    number;
+    uint64_t    at;             //!< position in the numbers of the worker, from 1
+} randsim_event_t;
+
+/*!
+ * \brief Called by a worker for each event, in the order of its numbers
+ *        for each predicate, so it has to be quick.
+ */
+typedef void (*randsim_event_fn)(const randsim_event_t *ev, void *ctx);
+
+/*!
+ * \brief Called first by each worker thread the pool starts, 1 .. threads-1,
+ *        to pin or schedule it.
+ */
+typedef void (*randsim_start_fn)(int worker, void *ctx);
+
+/*!
+ *  \brief Settings of randsim_create(), randsim_config_init() first.
+ */
+typedef struct {
+    uint32_t    size;           //!< sizeof(randsim_config_t) of the caller
+    int         algo;           //!< randsim_algo_t
+    int         threads;        //!< workers, the calling thread is one of them
+    uint64_t    seed;           //!< worker w draws stream w of the seed
+    randsim_event_fn event;     //!< NULL for the statistics only
+    randsim_start_fn start;     //!< NULL for none
+    void       *ctx;            //!< of event and start
+} randsim_config_t;
+
+/*!
+ * \brief A predicate on a number, non 0 if it's an event.
+ */
+typedef int (*randsim_predicate_t)(uint64_t number, void *ctx);
+
+/*!
+ *  \brief Events of a predicate in the numbers scanned so far. An
+ *         interval is the count of numbers from the previous event of the
+ *         same worker (or from its start) to this one.
+ */
+typedef struct {
+    uint64_t    numbers;        //!< numbers scanned
+    uint64_t    events;
+    double      mean;           //!< mean interval
+    double      variance;       //!< variance of the intervals
+    uint64_t    min;            //!< shortest interval, 0 if no event
+    uint64_t    max;            //!< longest interval
+} randsim_stats_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+RANDSIM_API int         randsim_api_version(void);
+
+/*!
+ * \brief Name of an algorithm, "unknown" if out of range.
+ */
+RANDSIM_API const char *randsim_algo_name(int algo);
+
+/*!
+ * \brief A generator of \a algo on stream \a stream of \a seed: the
+ *       jumpable and counter engines take the stream as a substream of
+ *       the seed, the others are seeded by {seed, stream}.
+ * \return NULL if \a algo isn't a generator (6 and 12), or no memory
+ */
+RANDSIM_API randsim_gen_t *randsim_gen_create(int algo, uint64_t seed, uint64_t stream);
+RANDSIM_API void        randsim_gen_destroy(randsim_gen_t *gen);
+
+/*!
+ * \brief Fill \a array with the next \a n numbers, any \a n.
+ */
+RANDSIM_API void        randsim_gen_fill(randsim_gen_t *gen, uint64_t *array, size_t n);
+
+RANDSIM_API void        randsim_config_init(randsim_config_t *cfg);
+
+/*!
+ * \brief Start the \a threads - 1 worker threads of the pool.
+ * \return NULL if the settings are wrong or out of resources
+ */
+RANDSIM_API randsim_t  *randsim_create(const randsim_config_t *cfg);
+RANDSIM_API void        randsim_destroy(randsim_t *rs);
+
+/*!
+ * \brief Fill \a array with \a n numbers, cut in one part per worker, so
+ *       the numbers depend on the threads as well as the seed.
+ * \return int - 0 : successful
+ */
+RANDSIM_API int         randsim_fill(randsim_t *rs, uint64_t *array, size_t n);
+
+/*!
+ * \brief Add a predicate for the next randsim_run().
+ * \return int - id of the predicate for randsim_get_stats, -1 if full
+ */
+RANDSIM_API int         randsim_add_predicate(randsim_t *rs, const char *name,
+                                              randsim_predicate_t fn, void *ctx);
+
+/*!
+ * \brief Scan \a numbers more numbers, shared by the workers, for all the
+ *       predicates.
+ * \return int - 0 : successful
+ */
+RANDSIM_API int         randsim_run(randsim_t *rs, uint64_t numbers);
+
+/*!
+ * \brief Statistics of predicate \a pred, merged over the workers.
+ * \return int - 0 : successful
+ */
+RANDSIM_API int         randsim_get_stats(randsim_t *rs, int pred, randsim_stats_t *st);
+
+/*!
+ * \brief Ready made predicates: the (intptr_t)\a ctx high bits of the
+ *       number are all 0, or all 1, like the finds of randsim-sse for 32.
+ */
+RANDSIM_API int         randsim_pred_leading0(uint64_t number, void *ctx);
+RANDSIM_API int         randsim_pred_leading1(uint64_t number, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//_RANDSIM_H_
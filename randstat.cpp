@@ -0,0 +1,189 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "randstat.h"
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief model probability of an interval above \a x
+ */
+static double randstat_survival(const randstat_t *st, int64_t x)
+{
+    if (x < (int64_t)st->offset)
+        return 1.0;
+    return exp((double)(x - (int64_t)st->offset + 1) * log1p(-st->q));
+}
+
+/*!
+ * \brief regularized upper incomplete gamma Q(a, x), by the series of P
+ *        below a+1 and by the continued fraction (Lentz) above
+ */
+static double randstat_gamma_q(double a, double x)
+{
+    const double eps = 1e-15;
+    const double tiny = 1e-300;
+
+    if (x <= 0)
+        return 1.0;
+    double lnpre = a * log(x) - x - lgamma(a);
+
+    if (x < a + 1) {
+        double ap = a, del = 1.0 / a, sum = del;
+        for (int i = 0; i < 1000; i++) {
+            ap += 1;
+            del *= x / ap;
+            sum += del;
+            if (fabs(del) < fabs(sum) * eps)
+                break;
+        }
+        return 1.0 - sum * exp(lnpre);
+    }
+
+    double b = x + 1 - a, c = 1.0 / tiny, d = 1.0 / b, h = d;
+    for (int i = 1; i < 1000; i++) {
+        double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        if (fabs(d) < tiny) d = tiny;
+        c = b + an / c;
+        if (fabs(c) < tiny) c = tiny;
+        d = 1.0 / d;
+        double del = d * c;
+        h *= del;
+        if (fabs(del - 1.0) < eps)
+            break;
+    }
+    return exp(lnpre) * h;
+}
+
+/*!
+ * \brief Kolmogorov distribution, P(K > lambda)
+ */
+static double randstat_kolmogorov_q(double lambda)
+{
+    if (lambda < 0.2)
+        return 1.0;
+
+    double sum = 0, sign = 1;
+    for (int j = 1; j <= 100; j++) {
+        double term = exp(-2.0 * j * j * lambda * lambda);
+        sum += sign * term;
+        if (term < 1e-16)
+            break;
+        sign = -sign;
+    }
+    return std::min(1.0, std::max(0.0, 2 * sum));
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+double randstat_tick_probability(double p, uint64_t numbers)
+{
+    return -expm1((double)numbers * log1p(-p));
+}
+
+void randstat_init(randstat_t *st, double q, uint64_t offset)
+{
+    memset(st, 0, sizeof(randstat_t));
+    st->q = q;
+    st->offset = offset;
+
+    // edge j is the smallest interval x of F(x) >= j / RANDSTAT_BINS
+    double lq = log1p(-q);
+    st->edge[0] = 0;
+    for (int j = 1; j < RANDSTAT_BINS; j++) {
+        double k = ceil(log(1.0 - (double)j / RANDSTAT_BINS) / lq);
+        uint64_t x = offset + (uint64_t)std::max(k, 1.0) - 1;
+        st->edge[j] = std::max(x, st->edge[j - 1]);
+    }
+    st->edge[RANDSTAT_BINS] = (uint64_t)-1;
+
+    for (int j = 0; j < RANDSTAT_BINS; j++) {
+        double lo = randstat_survival(st, (int64_t)st->edge[j] - 1);
+        double hi = (j == RANDSTAT_BINS - 1) ? 0 : randstat_survival(st, (int64_t)st->edge[j + 1] - 1);
+        st->prob[j] = lo - hi;
+    }
+}
+
+void randstat_add(randstat_t *st, uint64_t interval)
+{
+    int j = (int)(std::upper_bound(st->edge + 1, st->edge + RANDSTAT_BINS, interval) - (st->edge + 1));
+    st->count[j]++;
+
+    st->n++;
+    double delta = (double)interval - st->mean;
+    st->mean += delta / (double)st->n;
+    st->m2 += delta * ((double)interval - st->mean);
+}
+
+void randstat_result(const randstat_t *st, randstat_result_t *result)
+{
+    memset(result, 0, sizeof(randstat_result_t));
+    result->n = st->n;
+    result->modelMean = (double)st->offset + (1 - st->q) / st->q;
+    result->modelVariance = (1 - st->q) / (st->q * st->q);
+    result->chi2p = 1.0;
+    result->ksp = 1.0;
+    if (st->n == 0)
+        return;
+
+    double n = (double)st->n;
+    result->mean = st->mean;
+    result->variance = (st->n > 1) ? st->m2 / (n - 1) : 0;
+    result->ciHalf = 1.96 * sqrt(result->variance / n);
+
+    // chi-square on merged bins, the empty ones of a coarse model are skipped
+    const int merge = RANDSTAT_BINS / RANDSTAT_CHI2_BINS;
+    int bins = 0;
+    for (int k = 0; k < RANDSTAT_CHI2_BINS; k++) {
+        double prob = 0, observed = 0;
+        for (int j = k * merge; j < (k + 1) * merge; j++) {
+            prob += st->prob[j];
+            observed += (double)st->count[j];
+        }
+        if (prob <= 0)
+            continue;
+        double expected = n * prob;
+        result->chi2 += (observed - expected) * (observed - expected) / expected;
+        bins++;
+    }
+    result->chi2df = bins - 1;
+    if (result->chi2df > 0)
+        result->chi2p = randstat_gamma_q(result->chi2df / 2.0, result->chi2 / 2.0);
+
+    // KS distance of the empirical and model CDF at the bin edges
+    double cum = 0;
+    for (int j = 1; j < RANDSTAT_BINS; j++) {
+        cum += (double)st->count[j - 1];
+        double model = 1.0 - randstat_survival(st, (int64_t)st->edge[j] - 1);
+        result->ks = std::max(result->ks, fabs(cum / n - model));
+    }
+    double sn = sqrt(n);
+    result->ksp = randstat_kolmogorov_q((sn + 0.12 + 0.11 / sn) * result->ks);
+}
+
+bool randstat_settled(const randstat_t *st, double precision)
+{
+    if (st->n < RANDSTAT_MIN_EVENTS)
+        return false;
+    double variance = st->m2 / (double)(st->n - 1);
+    return 1.96 * sqrt(variance / (double)st->n) <= precision * st->mean;
+}
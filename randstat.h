@@ -0,0 +1,99 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _RANDSTAT_H_
+#define _RANDSTAT_H_
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def RANDSTAT_BINS
+ *    Equiprobable bins of the model, the KS distance is taken at their
+ *    edges. RANDSTAT_CHI2_BINS of them are merged for the chi-square.
+ */
+#define RANDSTAT_BINS           1024
+#define RANDSTAT_CHI2_BINS      32
+
+/*!
+ * \def RANDSTAT_MIN_EVENTS
+ *    Events needed before a result is settled, so the normal CI and the
+ *    chi-square (5 expected per bin) hold.
+ */
+#define RANDSTAT_MIN_EVENTS     (5 * RANDSTAT_CHI2_BINS)
+
+/*!
+ *  \brief Streaming statistics of the intervals of one kind of event,
+ *         against the geometric waiting time of a success probability q
+ *         per tick, on {offset, offset+1, ...}. The cost of one interval
+ *         is O(log RANDSTAT_BINS), the memory doesn't grow.
+ */
+typedef struct
+{
+    double      q;                          //!< success probability per tick
+    uint64_t    offset;                     //!< smallest interval of the model
+    uint64_t    edge[RANDSTAT_BINS + 1];    //!< bin j is [edge[j], edge[j+1])
+    double      prob[RANDSTAT_BINS];        //!< model probability of each bin
+    uint64_t    count[RANDSTAT_BINS];
+    uint64_t    n;                          //!< intervals
+    double      mean;                       //!< Welford's running mean
+    double      m2;                         //!< and sum of squared deviations
+} randstat_t;
+
+/*!
+ *  \brief Statistics of the intervals so far.
+ */
+typedef struct
+{
+    uint64_t    n;
+    double      mean;
+    double      variance;
+    double      ciHalf;         //!< half width of the 95% confidence interval of the mean
+    double      modelMean;      //!< mean of the model
+    double      modelVariance;  //!< variance of the model
+    double      chi2;           //!< chi-square of RANDSTAT_CHI2_BINS bins
+    int         chi2df;
+    double      chi2p;          //!< p-value, the model is rejected if it's small
+    double      ks;             //!< Kolmogorov-Smirnov distance at the bin edges
+    double      ksp;            //!< p-value, asymptotic Kolmogorov distribution
+} randstat_result_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Set up the model, geometric of success probability \a q per
+ *       tick, shifted by \a offset, and clear the statistics.
+ */
+void randstat_init(randstat_t *st, double q, uint64_t offset);
+
+/*!
+ * \brief Success probability of one tick of \a numbers trials of
+ *       probability \a p each.
+ */
+double randstat_tick_probability(double p, uint64_t numbers);
+
+/*!
+ * \brief Add one interval.
+ */
+void randstat_add(randstat_t *st, uint64_t interval);
+
+/*!
+ * \brief Compute the statistics, O(RANDSTAT_BINS).
+ */
+void randstat_result(const randstat_t *st, randstat_result_t *result);
+
+/*!
+ * \brief Early stop rule: true when there are RANDSTAT_MIN_EVENTS
+ *       intervals and the 95% CI of the mean is within \a precision
+ *       (relative) of the mean. O(1), can be checked on each interval.
+ */
+bool randstat_settled(const randstat_t *st, double precision);
+
+#endif//_RANDSTAT_H_
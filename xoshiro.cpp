@@ -0,0 +1,251 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*------------------------------------------------------------------
+ * System includes
+ *------------------------------------------------------------------*/
+#include <string.h>
+
+#if defined(HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define XOSHIRO_X86     1
+#endif
+
+/*------------------------------------------------------------------
+ * Module includes
+ *------------------------------------------------------------------*/
+
+#include "randmix.h"
+#include "xoshiro.h"
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+typedef void (*xoshiro_fill_t)(xoshiro256pp_t *x, uint64_t *array, size_t steps);
+
+static const uint64_t XOSHIRO_JUMP[4] = {
+    0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+static const uint64_t XOSHIRO_LONG_JUMP[4] = {
+    0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL };
+
+/*------------------------------------------------------------------
+ * Module Internal functions Definitions
+ *------------------------------------------------------------------*/
+
+static inline uint64_t xoshiro_next(uint64_t s[4])
+{
+    uint64_t result = randmix_rotl(s[0] + s[3], 23) + s[0];
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = randmix_rotl(s[3], 45);
+    return result;
+}
+
+/*!
+ * \brief one lane jump, the polynomial of the jump applied to the state
+ */
+static void xoshiro_jump_state(uint64_t s[4], const uint64_t poly[4])
+{
+    uint64_t j[4] = { 0, 0, 0, 0 };
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (poly[i] & (1ULL << b)) {
+                j[0] ^= s[0];
+                j[1] ^= s[1];
+                j[2] ^= s[2];
+                j[3] ^= s[3];
+            }
+            xoshiro_next(s);
+        }
+    }
+    memcpy(s, j, sizeof(j));
+}
+
+static void xoshiro_jump_lanes(xoshiro256pp_t *x, const uint64_t poly[4])
+{
+    for (int l = 0; l < XOSHIRO_LANES; l++) {
+        uint64_t s[4] = { x->s[0][l], x->s[1][l], x->s[2][l], x->s[3][l] };
+        xoshiro_jump_state(s, poly);
+        for (int w = 0; w < 4; w++)
+            x->s[w][l] = s[w];
+    }
+}
+
+static void xoshiro_fill_scalar(xoshiro256pp_t *x, uint64_t *array, size_t steps)
+{
+    for (int l = 0; l < XOSHIRO_LANES; l++) {
+        uint64_t s[4] = { x->s[0][l], x->s[1][l], x->s[2][l], x->s[3][l] };
+        for (size_t i = 0; i < steps; i++)
+            array[i * XOSHIRO_LANES + l] = xoshiro_next(s);
+        for (int w = 0; w < 4; w++)
+            x->s[w][l] = s[w];
+    }
+}
+
+#if defined(XOSHIRO_X86)
+/*!
+ * \brief 4 lanes per register, two registers per state word. No 64-bit
+ *        rotate in AVX2, it's two shifts and an or.
+ */
+__attribute__((target("avx2")))
+static void xoshiro_fill_avx2(xoshiro256pp_t *x, uint64_t *array, size_t steps)
+{
+#define XOSHIRO_ROTL_AVX2(v, k) _mm256_or_si256(_mm256_slli_epi64(v, k), _mm256_srli_epi64(v, 64 - (k)))
+    __m256i s0[2], s1[2], s2[2], s3[2];
+
+    for (int h = 0; h < 2; h++) {
+        s0[h] = _mm256_load_si256((const __m256i *)&x->s[0][4 * h]);
+        s1[h] = _mm256_load_si256((const __m256i *)&x->s[1][4 * h]);
+        s2[h] = _mm256_load_si256((const __m256i *)&x->s[2][4 * h]);
+        s3[h] = _mm256_load_si256((const __m256i *)&x->s[3][4 * h]);
+    }
+    for (size_t i = 0; i < steps; i++) {
+        for (int h = 0; h < 2; h++) {
+            __m256i sum = _mm256_add_epi64(s0[h], s3[h]);
+            __m256i result = _mm256_add_epi64(XOSHIRO_ROTL_AVX2(sum, 23), s0[h]);
+            __m256i t = _mm256_slli_epi64(s1[h], 17);
+
+            s2[h] = _mm256_xor_si256(s2[h], s0[h]);
+            s3[h] = _mm256_xor_si256(s3[h], s1[h]);
+            s1[h] = _mm256_xor_si256(s1[h], s2[h]);
+            s0[h] = _mm256_xor_si256(s0[h], s3[h]);
+            s2[h] = _mm256_xor_si256(s2[h], t);
+            s3[h] = XOSHIRO_ROTL_AVX2(s3[h], 45);
+            _mm256_storeu_si256((__m256i *)(array + i * XOSHIRO_LANES + 4 * h), result);
+        }
+    }
+    for (int h = 0; h < 2; h++) {
+        _mm256_store_si256((__m256i *)&x->s[0][4 * h], s0[h]);
+        _mm256_store_si256((__m256i *)&x->s[1][4 * h], s1[h]);
+        _mm256_store_si256((__m256i *)&x->s[2][4 * h], s2[h]);
+        _mm256_store_si256((__m256i *)&x->s[3][4 * h], s3[h]);
+    }
+#undef XOSHIRO_ROTL_AVX2
+}
+
+/*!
+ * \brief all 8 lanes in one register per state word, native rotate
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"     // _mm512_undefined_epi32() of the shift intrinsics
+__attribute__((target("avx512f")))
+static void xoshiro_fill_avx512(xoshiro256pp_t *x, uint64_t *array, size_t steps)
+{
+    __m512i s0 = _mm512_load_si512(x->s[0]);
+    __m512i s1 = _mm512_load_si512(x->s[1]);
+    __m512i s2 = _mm512_load_si512(x->s[2]);
+    __m512i s3 = _mm512_load_si512(x->s[3]);
+
+    for (size_t i = 0; i < steps; i++) {
+        __m512i result = _mm512_add_epi64(_mm512_rol_epi64(_mm512_add_epi64(s0, s3), 23), s0);
+        __m512i t = _mm512_slli_epi64(s1, 17);
+
+        s2 = _mm512_xor_si512(s2, s0);
+        s3 = _mm512_xor_si512(s3, s1);
+        s1 = _mm512_xor_si512(s1, s2);
+        s0 = _mm512_xor_si512(s0, s3);
+        s2 = _mm512_xor_si512(s2, t);
+        s3 = _mm512_rol_epi64(s3, 45);
+        _mm512_storeu_si512(array + i * XOSHIRO_LANES, result);
+    }
+    _mm512_store_si512(x->s[0], s0);
+    _mm512_store_si512(x->s[1], s1);
+    _mm512_store_si512(x->s[2], s2);
+    _mm512_store_si512(x->s[3], s3);
+}
+#pragma GCC diagnostic pop
+#endif
+
+static xoshiro_fill_t xoshiro_fill = NULL;
+static const char    *xoshiro_isa_name = "scalar";
+
+static xoshiro_fill_t xoshiro_select(void)
+{
+    xoshiro_fill_t fill = xoshiro_fill_scalar;
+    const char    *isa = "scalar";
+
+#if defined(XOSHIRO_X86)
+    if (__builtin_cpu_supports("avx512f")) {
+        fill = xoshiro_fill_avx512;
+        isa = "AVX-512";
+    }
+    else if (__builtin_cpu_supports("avx2")) {
+        fill = xoshiro_fill_avx2;
+        isa = "AVX2";
+    }
+#endif
+    xoshiro_isa_name = isa;
+    __atomic_store_n(&xoshiro_fill, fill, __ATOMIC_RELEASE);
+    return fill;
+}
+
+static void xoshiro_fill_array64(xoshiro256pp_t *x, uint64_t *array, size_t size, xoshiro_fill_t fill)
+{
+    size_t steps = size / XOSHIRO_LANES;
+
+    fill(x, array, steps);
+    if (size % XOSHIRO_LANES) {
+        uint64_t last[XOSHIRO_LANES];
+        fill(x, last, 1);
+        memcpy(array + steps * XOSHIRO_LANES, last, (size % XOSHIRO_LANES) * sizeof(uint64_t));
+    }
+}
+
+/*------------------------------------------------------------------
+ * Module External functions Definitions
+ *------------------------------------------------------------------*/
+
+void xoshiro256pp_init(xoshiro256pp_t *x, uint64_t seed, uint64_t stream)
+{
+    uint64_t s[4];
+
+    for (int w = 0; w < 4; w++)
+        s[w] = randmix_splitmix64(&seed);
+    for (uint64_t k = 0; k < stream; k++)
+        xoshiro_jump_state(s, XOSHIRO_LONG_JUMP);
+    for (int l = 0; l < XOSHIRO_LANES; l++) {
+        for (int w = 0; w < 4; w++)
+            x->s[w][l] = s[w];
+        xoshiro_jump_state(s, XOSHIRO_JUMP);
+    }
+}
+
+void xoshiro256pp_jump(xoshiro256pp_t *x)
+{
+    // the lanes are 2^128 apart, a single 2^128 jump lands on the next one
+    for (int k = 0; k < XOSHIRO_LANES; k++)
+        xoshiro_jump_lanes(x, XOSHIRO_JUMP);
+}
+
+void xoshiro256pp_long_jump(xoshiro256pp_t *x)
+{
+    xoshiro_jump_lanes(x, XOSHIRO_LONG_JUMP);
+}
+
+void xoshiro256pp_fill_array64(xoshiro256pp_t *x, uint64_t *array, size_t size)
+{
+    xoshiro_fill_t fill = __atomic_load_n(&xoshiro_fill, __ATOMIC_ACQUIRE);
+    if (fill == NULL)
+        fill = xoshiro_select();
+    xoshiro_fill_array64(x, array, size, fill);
+}
+
+void xoshiro256pp_fill_array64_scalar(xoshiro256pp_t *x, uint64_t *array, size_t size)
+{
+    xoshiro_fill_array64(x, array, size, xoshiro_fill_scalar);
+}
+
+const char *xoshiro256pp_isa(void)
+{
+    if (__atomic_load_n(&xoshiro_fill, __ATOMIC_ACQUIRE) == NULL)
+        xoshiro_select();
+    return xoshiro_isa_name;
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2017 Gary Yu
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+
+#ifndef _XOSHIRO_H_
+#define _XOSHIRO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------
+ * Module Macro and Type definitions
+ *------------------------------------------------------------------*/
+
+/*!
+ * \def XOSHIRO_LANES
+ *    Independent generators stepped together, one AVX-512 register or
+ *    two AVX2 registers per state word.
+ */
+#define XOSHIRO_LANES       8
+
+/*!
+ *  \brief xoshiro256++ (Blackman and Vigna, 2018) in XOSHIRO_LANES lanes,
+ *         the state words of all the lanes side by side, 256 bytes in
+ *         all. Lane j is lane 0 jumped j * 2^128 steps ahead, so the lanes
+ *         never overlap.
+ */
+typedef struct
+{
+    alignas(64) uint64_t s[4][XOSHIRO_LANES];
+} xoshiro256pp_t;
+
+/*------------------------------------------------------------------
+ * Module External functions Declaration
+ *------------------------------------------------------------------*/
+
+/*!
+ * \brief Seed lane 0 by splitmix64 of \a seed, long jump it \a stream
+ *       times (2^192 steps each), then jump each next lane 2^128 steps.
+ *       Streams of the same seed don't overlap, the cost is O(stream).
+ */
+void xoshiro256pp_init(xoshiro256pp_t *x, uint64_t seed, uint64_t stream);
+
+/*!
+ * \brief Jump every lane XOSHIRO_LANES * 2^128 steps, past the start of
+ *       the last lane, so the lanes still never overlap; or 2^192 steps
+ *       for the long jump, the next stream.
+ */
+void xoshiro256pp_jump(xoshiro256pp_t *x);
+void xoshiro256pp_long_jump(xoshiro256pp_t *x);
+
+/*!
+ * \brief Fill \a array with the lanes' outputs interleaved, number
+ *       i * XOSHIRO_LANES + j is the i-th output of lane j. All the lanes
+ *       are stepped per XOSHIRO_LANES numbers, the extra outputs of the
+ *       last step are dropped if \a size is not a multiple of it.
+ *       AVX-512, AVX2 or scalar code, the best the CPU has.
+ */
+void xoshiro256pp_fill_array64(xoshiro256pp_t *x, uint64_t *array, size_t size);
+
+/*!
+ * \brief Same numbers as xoshiro256pp_fill_array64, the reference.
+ */
+void xoshiro256pp_fill_array64_scalar(xoshiro256pp_t *x, uint64_t *array, size_t size);
+
+/*!
+ * \brief Name of the instruction set xoshiro256pp_fill_array64 uses.
+ */
+const char *xoshiro256pp_isa(void);
+
+#endif//_XOSHIRO_H_